@@ -4,19 +4,25 @@ from fastapi.responses import RedirectResponse
 from fastapi.staticfiles import StaticFiles
 
 from .core.db import init_db
-from .core.config import FRONTEND_DIR, UPLOAD_DIR
+from .core.retention import retention
+from .core.config import FRONTEND_DIR, UPLOAD_DIR, HTTP_HOST, HTTP_PORT, HTTP_KEEPALIVE_SEC
 from .routes.device import router as device_router
 from .routes.upload import router as upload_router
 from .routes.admin import router as admin_router
+from .routes.media import router as media_router
+from .routes.metrics import router as metrics_router
 
 def create_app():
     init_db()
+    retention.start()
     app = FastAPI(title="HomeDog Backend", version="1.0.0")
 
     # API router'ları
     app.include_router(device_router)
     app.include_router(upload_router)
     app.include_router(admin_router)
+    app.include_router(media_router)
+    app.include_router(metrics_router)
 
     # Statik dosyalar
     app.mount("/admin", StaticFiles(directory=str(FRONTEND_DIR), html=True), name="admin")
@@ -30,3 +36,8 @@ def create_app():
 
 # <— Uvicorn backend.app:app ararken bunu bulmalı
 app = create_app()
+
+# python -m backend.app: keep-alive suresi cihazlarin soket yeniden kullanimiyla uyumlu baslar
+if __name__ == "__main__":
+    import uvicorn
+    uvicorn.run(app, host=HTTP_HOST, port=HTTP_PORT, timeout_keep_alive=HTTP_KEEPALIVE_SEC)
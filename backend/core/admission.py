@@ -0,0 +1,59 @@
+# backend/core/admission.py
+import math
+import threading
+import time
+
+
+class AdmissionController:
+    """Upload kabul kontrolu: ayni anda islenen upload sayisini sinirlar.
+
+    Limit asildiginda cagiran tarafa Retry-After (saniye) doner; cihazlar bu
+    sureyi bekleyip ustel geri cekilme uygular.
+    """
+
+    def __init__(self, max_inflight: int, retry_after_sec: int, max_retry_after_sec: int = 60):
+        self.max_inflight = max(1, max_inflight)
+        self.retry_after_sec = max(1, retry_after_sec)
+        self.max_retry_after_sec = max(self.retry_after_sec, max_retry_after_sec)
+        self._lock = threading.Lock()
+        self._inflight = 0
+        self._per_device: dict[str, int] = {}
+        self._service_ewma = 0.0
+        self.rejected = 0
+
+    @property
+    def inflight(self) -> int:
+        return self._inflight
+
+    def _retry_after(self) -> int:
+        # Kuyruktaki fazlalik, ortalama islem suresi kadar bekletilir.
+        overflow = self._inflight - self.max_inflight + 1
+        estimate = self._service_ewma * overflow / self.max_inflight
+        return int(min(self.max_retry_after_sec, max(self.retry_after_sec, math.ceil(estimate))))
+
+    def try_enter(self, device_id: str) -> tuple[int, int] | None:
+        """Kabul edilirse None, edilmezse (HTTP durum kodu, Retry-After) doner."""
+        with self._lock:
+            if self._per_device.get(device_id, 0) > 0:
+                self.rejected += 1
+                return 429, self._retry_after()
+            if self._inflight >= self.max_inflight:
+                self.rejected += 1
+                return 503, self._retry_after()
+            self._inflight += 1
+            self._per_device[device_id] = self._per_device.get(device_id, 0) + 1
+            return None
+
+    def leave(self, device_id: str, started: float):
+        elapsed = time.monotonic() - started
+        with self._lock:
+            self._inflight = max(0, self._inflight - 1)
+            left = self._per_device.get(device_id, 0) - 1
+            if left > 0:
+                self._per_device[device_id] = left
+            else:
+                self._per_device.pop(device_id, None)
+            if self._service_ewma <= 0:
+                self._service_ewma = elapsed
+            else:
+                self._service_ewma = 0.8 * self._service_ewma + 0.2 * elapsed
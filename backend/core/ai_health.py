@@ -0,0 +1,96 @@
+# backend/core/ai_health.py
+import threading
+import time
+from urllib.parse import urlparse, urlunparse
+
+import requests
+
+from .config import AI_HEALTH_INTERVAL_SEC, AI_HEALTH_TTL_SEC
+
+
+def build_ai_health_url(host: str) -> str | None:
+    if not host:
+        return None
+    host = host.strip()
+    if not host:
+        return None
+    if not host.startswith('http://') and not host.startswith('https://'):
+        host = 'http://' + host
+    parsed = urlparse(host)
+    if not parsed.netloc:
+        return None
+    path = (parsed.path or '').rstrip('/')
+    if path.endswith('/api'):
+        health_path = f'{path}/tags'
+    elif path.endswith('/api/generate'):
+        health_path = path[: -len('/generate')] + '/tags'
+    elif '/api/generate' in path:
+        base = path.split('/api/generate')[0] + '/api'
+        health_path = base + '/tags'
+    else:
+        health_path = f'{path}/api/tags' if path else '/api/tags'
+    parsed = parsed._replace(path=health_path, params='', query='', fragment='')
+    return urlunparse(parsed)
+
+
+def probe_ai_host(url: str, timeout: float = 2) -> bool:
+    try:
+        resp = requests.get(url, timeout=timeout)
+    except Exception:
+        return False
+    return resp.ok
+
+
+class AiHealthMonitor:
+    """AI host erisilebilirligini arka planda yoklar; okumalar O(1) ve bloklamaz.
+
+    Her farkli health URL'si icin tek bir thread calisir. Uzun sure okunmayan
+    hostlarin thread'i kendiliginden durur, bir sonraki okumada yeniden baslar.
+    """
+
+    def __init__(self, interval_sec: int, ttl_sec: int, idle_sec: int = 600):
+        self.interval_sec = max(1, interval_sec)
+        self.ttl_sec = max(self.interval_sec, ttl_sec)
+        self.idle_sec = max(self.ttl_sec, idle_sec)
+        self._lock = threading.Lock()
+        # url -> {"ok": bool | None, "checked": float, "read": float, "thread": Thread}
+        self._hosts: dict[str, dict] = {}
+
+    def is_reachable(self, host: str) -> bool | None:
+        url = build_ai_health_url(host)
+        if not url:
+            return False
+        now = time.monotonic()
+        with self._lock:
+            entry = self._hosts.get(url)
+            if entry is None or not entry["thread"].is_alive():
+                entry = self._start(url, entry)
+            entry["read"] = now
+            if entry["ok"] is None or now - entry["checked"] > self.ttl_sec:
+                return None
+            return entry["ok"]
+
+    def _start(self, url: str, previous: dict | None) -> dict:
+        entry = {
+            "ok": previous["ok"] if previous else None,
+            "checked": previous["checked"] if previous else 0.0,
+            "read": time.monotonic(),
+        }
+        thread = threading.Thread(target=self._run, args=(url, entry), name=f"ai-health {url}", daemon=True)
+        entry["thread"] = thread
+        self._hosts[url] = entry
+        thread.start()
+        return entry
+
+    def _run(self, url: str, entry: dict):
+        while True:
+            ok = probe_ai_host(url)
+            with self._lock:
+                entry["ok"] = ok
+                entry["checked"] = time.monotonic()
+                if entry["checked"] - entry["read"] > self.idle_sec:
+                    return
+            time.sleep(self.interval_sec)
+
+
+ai_health = AiHealthMonitor(AI_HEALTH_INTERVAL_SEC, AI_HEALTH_TTL_SEC)
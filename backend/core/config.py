@@ -5,15 +5,19 @@ PROJECT_ROOT = Path(__file__).resolve().parents[2]
 DATA_DIR = PROJECT_ROOT / "data"
 UPLOAD_DIR = PROJECT_ROOT / "uploads"
 FRONTEND_DIR = PROJECT_ROOT / "frontend"
+FIRMWARE_DIR = DATA_DIR / "firmware"
 
 DATA_DIR.mkdir(parents=True, exist_ok=True)
 UPLOAD_DIR.mkdir(parents=True, exist_ok=True)
+FIRMWARE_DIR.mkdir(parents=True, exist_ok=True)
 
 DB_PATH = DATA_DIR / "devices.sqlite3"
 
 # Varsayilan tokenlar (gerekirse degistir)
 BACKEND_TOKEN = os.getenv("BACKEND_TOKEN", "1234567890")
 UPLOAD_TOKEN = os.getenv("UPLOAD_TOKEN", "0987654321")
+# Firmware imaji yukleme/silme; bos birakilirsa bu islemler kapali
+ADMIN_TOKEN = os.getenv("ADMIN_TOKEN", "")
 
 def _env_int(name: str, default: int) -> int:
     value = os.getenv(name)
@@ -32,3 +36,54 @@ DEFAULT_AI_MODEL = os.getenv("DEFAULT_AI_MODEL", "gemma3:12b")
 DEFAULT_AI_PROMPT = os.getenv("DEFAULT_AI_PROMPT", "Bu resimde ne goruyorsun, kisaca tanimla? {path}")
 DEFAULT_AI_NUM_CTX = _env_int("DEFAULT_AI_NUM_CTX", 1024)
 DEFAULT_AI_NUM_PREDICT = _env_int("DEFAULT_AI_NUM_PREDICT", 64)
+
+TELEMETRY_INTERVAL_SEC = _env_int("TELEMETRY_INTERVAL_SEC", 60)
+TELEMETRY_RETENTION_SEC = _env_int("TELEMETRY_RETENTION_SEC", 7 * 24 * 3600)
+
+# Cihazlarin config yoklama periyodu ve faz dagitimi (thundering herd onlemi)
+CONFIG_POLL_SEC = _env_int("CONFIG_POLL_SEC", 5)
+SCHEDULE_JITTER_MS = _env_int("SCHEDULE_JITTER_MS", 250)
+
+# Bos keep-alive soketinin sunucuda kapatilma suresi (uvicorn --timeout-keep-alive).
+# Cihaz 65 sn'den uzun bos kalan soketi kendisi birakir (HttpTransport kKeepAliveIdleMs);
+# bu deger ondan ve CONFIG_POLL_SEC'ten belirgin sekilde buyuk kalmali, yoksa yeniden
+# kullanim sunucunun kapatmasiyla yarisir. uvicorn varsayilani 5 sn'dir.
+HTTP_KEEPALIVE_SEC = _env_int("HTTP_KEEPALIVE_SEC", 75)
+HTTP_HOST = os.getenv("HTTP_HOST", "0.0.0.0")
+HTTP_PORT = _env_int("HTTP_PORT", 8000)
+
+# Upload kabul kontrolu (asiri yukte 503/429 + Retry-After)
+UPLOAD_MAX_INFLIGHT = _env_int("UPLOAD_MAX_INFLIGHT", 8)
+UPLOAD_RETRY_AFTER_SEC = _env_int("UPLOAD_RETRY_AFTER_SEC", 5)
+
+# AI host saglik kontrolu (arka plan yoklama + TTL onbellek)
+AI_HEALTH_INTERVAL_SEC = _env_int("AI_HEALTH_INTERVAL_SEC", 15)
+AI_HEALTH_TTL_SEC = _env_int("AI_HEALTH_TTL_SEC", 45)
+
+# Kare depolama: cihaz basina zaman kovali segment dosyalari
+SEGMENT_SPAN_SEC = _env_int("SEGMENT_SPAN_SEC", 3600)
+FRAME_RETENTION_SEC = _env_int("FRAME_RETENTION_SEC", 30 * 24 * 3600)  # 0 = sinirsiz
+ARCHIVE_RETENTION_SEC = _env_int("ARCHIVE_RETENTION_SEC", 90 * 24 * 3600)  # tam cozunurluk arsiv akisi
+RECOMPRESS_AFTER_SEC = _env_int("RECOMPRESS_AFTER_SEC", 0)  # 0 = kapali
+RECOMPRESS_QUALITY = _env_int("RECOMPRESS_QUALITY", 50)
+RETENTION_SWEEP_SEC = _env_int("RETENTION_SWEEP_SEC", 600)
+
+# Kare on-kontrolu: dHash Hamming esigi (<0 kapali), karanlik esigi (0..255 luma)
+FRAME_DUP_DISTANCE = _env_int("FRAME_DUP_DISTANCE", 4)
+FRAME_DARK_LUMA = _env_int("FRAME_DARK_LUMA", 8)
+FRAME_KEEP_SEC = _env_int("FRAME_KEEP_SEC", 300)
+
+# Ollama analiz kuyrugu: host basina eszamanlilik, bayat kare esigi, model bellekte tutma
+AI_HOST_CONCURRENCY = _env_int("AI_HOST_CONCURRENCY", 1)
+AI_MAX_QUEUE_AGE_SEC = _env_int("AI_MAX_QUEUE_AGE_SEC", 60)
+AI_KEEP_ALIVE = os.getenv("AI_KEEP_ALIVE", "30m")
+AI_IMAGE_MAX_SIDE = _env_int("AI_IMAGE_MAX_SIDE", 0)  # 0 = orijinal boyut
+AI_REQUEST_TIMEOUT_SEC = _env_int("AI_REQUEST_TIMEOUT_SEC", 60)
+
+# Admin paneli canli olay akisi (SSE): sekme basina kuyruk boyu, keepalive araligi
+EVENTS_QUEUE_SIZE = _env_int("EVENTS_QUEUE_SIZE", 256)
+EVENTS_PING_SEC = _env_int("EVENTS_PING_SEC", 15)
+
+# Cihaz saati: SNTP sunucusu ve cihaza ayri tz girilmemisse kullanilan POSIX TZ (Istanbul)
+NTP_SERVER = os.getenv("NTP_SERVER", "pool.ntp.org")
+DEFAULT_TZ = os.getenv("DEFAULT_TZ", "<+03>-3")
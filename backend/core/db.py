@@ -1,7 +1,8 @@
 # backend/core/db.py
+import os
 import sqlite3
 from typing import Optional, Dict, Any, List
-from .config import DB_PATH
+from .config import DB_PATH, UPLOAD_DIR
 
 def get_conn():
     conn = sqlite3.connect(DB_PATH, check_same_thread=False)
@@ -57,12 +58,38 @@ def init_db():
         ("colorbar", "INTEGER DEFAULT 0"),
         ("special_effect", "INTEGER DEFAULT 0"),
         ("low_light_boost", "INTEGER DEFAULT 1"),
+        ("scene_profiles", "TEXT"),
+        # Ikinci akis: periyodik tam cozunurluk arsiv karesi ("OFF" = kapali)
+        ("archive_framesize", "TEXT DEFAULT 'OFF'"),
+        ("archive_quality", "INTEGER DEFAULT 10"),
+        ("archive_interval_sec", "INTEGER DEFAULT 300"),
+        # GPIO tetik girisi (PIR / kapi kontagi); -1 = kapali
+        ("trigger_gpio", "INTEGER DEFAULT -1"),
+        ("trigger_active_high", "INTEGER DEFAULT 1"),
+        ("trigger_cooldown_ms", "INTEGER DEFAULT 2000"),
+        ("trigger_light_sleep", "INTEGER DEFAULT 0"),
+        # OTA: yayinlanan hedef surum ve cihazin geri aldigi (reddettigi) son surum
+        ("fw_target", "TEXT"),
+        ("fw_rejected", "TEXT"),
+        # Cekim takvimi (JSON pencere listesi) ve cihazin yerel saat dilimi (POSIX TZ)
+        ("schedule", "TEXT"),
+        ("tz", "TEXT"),
+        # Cihazin son yoklamada aldigi config_rev; config_rev'den kucukse degisiklik bekliyor
+        ("config_seen_rev", "INTEGER DEFAULT 0"),
+        # Sensor ROI penceresi, tam goruntunun binde biri cinsinden
+        ("roi_x", "INTEGER DEFAULT 0"),
+        ("roi_y", "INTEGER DEFAULT 0"),
+        ("roi_w", "INTEGER DEFAULT 1000"),
+        ("roi_h", "INTEGER DEFAULT 1000"),
+        ("roi_zoom", "INTEGER DEFAULT 0"),
         # >>> son resim alanları
         ("last_img_url", "TEXT"),
         ("last_img_time", "INTEGER"),
         ("last_img_urls", "TEXT"),
         ("last_analysis", "TEXT"),
         ("last_analysis_time", "INTEGER"),
+        # last_analysis'in ait oldugu karenin zamani; eski kareler yenisinin ustune yazmaz
+        ("last_analysis_frame_ts", "INTEGER"),
         ("ai_host", "TEXT"),
         ("ai_model", "TEXT"),
         ("ai_prompt", "TEXT"),
@@ -73,9 +100,92 @@ def init_db():
         if not _has_col(cur, "devices", name):
             cur.execute(f"ALTER TABLE devices ADD COLUMN {name} {decl}")
 
+    # Cihaz telemetrisi (histogram pencereleri, JSON olarak)
+    cur.execute("""
+    CREATE TABLE IF NOT EXISTS telemetry (
+        id INTEGER PRIMARY KEY AUTOINCREMENT,
+        device_id TEXT NOT NULL,
+        ts INTEGER NOT NULL,
+        payload TEXT NOT NULL
+    );
+    """)
+    cur.execute("CREATE INDEX IF NOT EXISTS idx_telemetry_device_ts ON telemetry(device_id, ts)")
+
+    # Kare indeksi: cihaz basina zaman sirali gecmis
+    cur.execute("SELECT name FROM sqlite_master WHERE type='table' AND name='frames'")
+    frames_existed = cur.fetchone() is not None
+    cur.execute("""
+    CREATE TABLE IF NOT EXISTS frames (
+        id INTEGER PRIMARY KEY AUTOINCREMENT,
+        device_id TEXT NOT NULL,
+        ts INTEGER NOT NULL,
+        path TEXT NOT NULL,
+        url TEXT NOT NULL,
+        size INTEGER,
+        framesize TEXT,
+        quality INTEGER,
+        analysis TEXT,
+        analysis_time INTEGER
+    );
+    """)
+    cur.execute("CREATE INDEX IF NOT EXISTS idx_frames_device_ts ON frames(device_id, ts)")
+    # Segment deposu: kare (seg, seg_offset) adresinde; eski tekil dosyalarda seg NULL
+    for col, decl in (
+        ("seg", "TEXT"),
+        ("seg_offset", "INTEGER"),
+        ("thumb_offset", "INTEGER"),
+        ("thumb_size", "INTEGER"),
+        ("luma", "REAL"),
+        ("change_score", "REAL"),
+        ("roi", "TEXT"),  # "x,y,w,h" (binde); tam kare icin NULL
+        ("stream", "TEXT"),  # "analysis" | "archive"; eski kayitlarda NULL = analysis
+        ("trigger", "TEXT"),  # "gpio" = PIR/kapi tetigi; zamanlanmis karelerde NULL
+        ("trigger_ms", "INTEGER"),  # tetikten istegin baslamasina kadar gecen sure
+    ):
+        if not _has_col(cur, "frames", col):
+            cur.execute(f"ALTER TABLE frames ADD COLUMN {col} {decl}")
+    cur.execute("CREATE INDEX IF NOT EXISTS idx_frames_device_seg ON frames(device_id, seg)")
+    if not frames_existed:
+        _backfill_frames(cur)
+
     conn.commit()
     conn.close()
 
+def _backfill_frames(cur):
+    """frames tablosu ilk olusturuldugunda uploads/ altindaki mevcut JPEG'leri indeksler."""
+    if not UPLOAD_DIR.is_dir():
+        return
+    rows = []
+    for dev_entry in os.scandir(UPLOAD_DIR):
+        if not dev_entry.is_dir():
+            continue
+        for entry in os.scandir(dev_entry.path):
+            if not entry.is_file() or not entry.name.lower().endswith(".jpg"):
+                continue
+            st = entry.stat()
+            rows.append((
+                dev_entry.name,
+                int(st.st_mtime),
+                entry.path,
+                f"/uploads/{dev_entry.name}/{entry.name}",
+                st.st_size,
+            ))
+    rows.sort(key=lambda r: (r[0], r[1]))
+    cur.executemany(
+        "INSERT INTO frames(device_id, ts, path, url, size) VALUES (?, ?, ?, ?, ?)",
+        rows,
+    )
+    # Son analiz yalnizca cihaz satirinda tutuluyordu; ilgili kareye tasinir.
+    cur.execute("""
+        UPDATE frames SET
+            analysis = (SELECT d.last_analysis FROM devices d
+                        WHERE d.device_id = frames.device_id AND d.last_img_url = frames.url),
+            analysis_time = (SELECT d.last_analysis_time FROM devices d
+                             WHERE d.device_id = frames.device_id AND d.last_img_url = frames.url)
+        WHERE url IN (SELECT last_img_url FROM devices WHERE last_img_url IS NOT NULL)
+    """)
+
+
 def upsert_device(info: Dict[str, Any]):
     conn = get_conn()
     cur = conn.cursor()
@@ -106,14 +216,18 @@ def list_devices() -> List[sqlite3.Row]:
     conn = get_conn()
     cur = conn.cursor()
     cur.execute("""
-        SELECT device_id, fw, ip, rssi, model, last_seen, config_rev,
+        SELECT device_id, fw, fw_target, fw_rejected, ip, rssi, model, last_seen, config_rev, config_seen_rev,
                framesize, jpeg_quality, upload_interval_sec, auto_upload,
                upload_url,
                whitebal, wb_mode, hmirror, vflip, brightness, contrast, saturation,
                sharpness, awb_gain, gain_ctrl, exposure_ctrl, gainceiling, ae_level,
                lens_corr, raw_gma, bpc, wpc, dcw, colorbar, special_effect, low_light_boost,
+               scene_profiles, roi_x, roi_y, roi_w, roi_h, roi_zoom,
+               archive_framesize, archive_quality, archive_interval_sec,
+               trigger_gpio, trigger_active_high, trigger_cooldown_ms, trigger_light_sleep,
+               schedule, tz,
                last_img_url, last_img_time,
-               last_img_urls, last_analysis, last_analysis_time,
+               last_analysis, last_analysis_time,
                ai_host, ai_model, ai_prompt, ai_num_ctx, ai_num_predict
         FROM devices
         ORDER BY (last_seen IS NULL) ASC, last_seen DESC
@@ -136,4 +250,174 @@ def update_config(device_id: str, cfg: Dict[str, Any]):
     conn.close()
 
 
+def insert_telemetry(device_id: str, ts: int, payload: str, retention_sec: int):
+    conn = get_conn()
+    cur = conn.cursor()
+    cur.execute(
+        "INSERT INTO telemetry(device_id, ts, payload) VALUES (?, ?, ?)",
+        (device_id, ts, payload),
+    )
+    if retention_sec > 0:
+        cur.execute(
+            "DELETE FROM telemetry WHERE device_id = ? AND ts < ?",
+            (device_id, ts - retention_sec),
+        )
+    conn.commit()
+    conn.close()
+
 
+def list_telemetry(device_id: str, limit: int = 60) -> List[sqlite3.Row]:
+    conn = get_conn()
+    cur = conn.cursor()
+    cur.execute(
+        "SELECT ts, payload FROM telemetry WHERE device_id = ? ORDER BY ts DESC LIMIT ?",
+        (device_id, limit),
+    )
+    rows = cur.fetchall()
+    conn.close()
+    return rows
+
+
+def device_slot(device_id: str) -> tuple[int, int]:
+    """Cihazin device_id sirasindaki yeri ve toplam cihaz sayisi."""
+    conn = get_conn()
+    cur = conn.cursor()
+    cur.execute("SELECT COUNT(*) FROM devices WHERE device_id < ?", (device_id,))
+    index = cur.fetchone()[0]
+    cur.execute("SELECT COUNT(*) FROM devices")
+    total = cur.fetchone()[0]
+    conn.close()
+    return int(index), max(1, int(total))
+
+
+FRAME_COLUMNS = (
+    "device_id", "ts", "path", "url", "size", "framesize", "quality",
+    "seg", "seg_offset", "thumb_offset", "thumb_size", "luma", "change_score",
+    "roi", "stream", "trigger", "trigger_ms",
+)
+
+
+def insert_frame(info: Dict[str, Any]) -> int:
+    params = {k: info.get(k) for k in FRAME_COLUMNS}
+    conn = get_conn()
+    cur = conn.cursor()
+    cur.execute(f"""
+        INSERT INTO frames({", ".join(FRAME_COLUMNS)})
+        VALUES ({", ".join(":" + k for k in FRAME_COLUMNS)})
+    """, params)
+    frame_id = cur.lastrowid
+    conn.commit()
+    conn.close()
+    return frame_id
+
+
+def set_frame_analysis(frame_id: int, analysis: str, ts: int):
+    conn = get_conn()
+    cur = conn.cursor()
+    cur.execute(
+        "UPDATE frames SET analysis = ?, analysis_time = ? WHERE id = ?",
+        (analysis, ts, frame_id),
+    )
+    conn.commit()
+    conn.close()
+
+
+def set_last_analysis(device_id: str, analysis: str, ts: int, frame_ts: int) -> bool:
+    """Cihazin son analizini, yalnizca kare zamani kayitlidakinden eski degilse yazar."""
+    conn = get_conn()
+    cur = conn.cursor()
+    cur.execute(
+        """
+        UPDATE devices SET last_analysis = ?, last_analysis_time = ?, last_analysis_frame_ts = ?
+        WHERE device_id = ? AND COALESCE(last_analysis_frame_ts, 0) <= ?
+        """,
+        (analysis, ts, frame_ts, device_id, frame_ts),
+    )
+    stored = cur.rowcount > 0
+    conn.commit()
+    conn.close()
+    return stored
+
+
+def list_frames(
+    device_id: str,
+    start: Optional[int] = None,
+    end: Optional[int] = None,
+    before: Optional[tuple[int, int]] = None,
+    limit: int = 50,
+    stream: Optional[str] = None,
+) -> List[sqlite3.Row]:
+    """Yeni->eski sirali sayfa. before=(ts, id) bir onceki sayfanin son karesi."""
+    sql = ["SELECT * FROM frames WHERE device_id = ?"]
+    params: List[Any] = [device_id]
+    if stream is not None:
+        sql.append("AND COALESCE(stream, 'analysis') = ?")
+        params.append(stream)
+    if start is not None:
+        sql.append("AND ts >= ?")
+        params.append(start)
+    if end is not None:
+        sql.append("AND ts <= ?")
+        params.append(end)
+    if before is not None:
+        sql.append("AND (ts < ? OR (ts = ? AND id < ?))")
+        params.extend([before[0], before[0], before[1]])
+    sql.append("ORDER BY ts DESC, id DESC LIMIT ?")
+    params.append(limit)
+
+    conn = get_conn()
+    cur = conn.cursor()
+    cur.execute(" ".join(sql), params)
+    rows = cur.fetchall()
+    conn.close()
+    return rows
+
+
+def list_segment_frames(device_id: str, seg: str) -> List[sqlite3.Row]:
+    conn = get_conn()
+    cur = conn.cursor()
+    cur.execute(
+        "SELECT * FROM frames WHERE device_id = ? AND seg = ? ORDER BY seg_offset",
+        (device_id, seg),
+    )
+    rows = cur.fetchall()
+    conn.close()
+    return rows
+
+
+def delete_segment_frames(device_id: str, seg: str) -> int:
+    conn = get_conn()
+    cur = conn.cursor()
+    cur.execute("DELETE FROM frames WHERE device_id = ? AND seg = ?", (device_id, seg))
+    deleted = cur.rowcount
+    conn.commit()
+    conn.close()
+    return deleted
+
+
+def relocate_frames(updates: List[Dict[str, Any]]):
+    """Yeniden yazilan segmentteki karelerin adreslerini tek islemde gunceller."""
+    conn = get_conn()
+    cur = conn.cursor()
+    cur.executemany("""
+        UPDATE frames SET seg = :seg, seg_offset = :seg_offset, size = :size,
+               path = :path, url = :url, thumb_offset = :thumb_offset
+        WHERE id = :id
+    """, updates)
+    conn.commit()
+    conn.close()
+
+
+def pop_expired_file_frames(device_id: str, cutoff: int) -> List[str]:
+    """Segment oncesi tekil dosya karelerinden suresi dolanlari siler, yollarini doner."""
+    conn = get_conn()
+    cur = conn.cursor()
+    cur.execute(
+        "SELECT id, path FROM frames WHERE device_id = ? AND seg IS NULL AND ts < ?",
+        (device_id, cutoff),
+    )
+    rows = cur.fetchall()
+    cur.executemany("DELETE FROM frames WHERE id = ?", [(r["id"],) for r in rows])
+    conn.commit()
+    conn.close()
+    return [r["path"] for r in rows]
@@ -0,0 +1,202 @@
+# backend/core/delta.py
+"""Firmware imajlari icin ikili fark (delta) yamasi.
+
+Bicim (firmware DeltaPatch ile ayni, tum tamsayilar little-endian):
+    "HDP1" | u32 eski boyut | u32 yeni boyut | sha256(eski) | sha256(yeni)
+    sonra islemler, her biri tek bayt kodla baslar:
+      0x01 DIFF  : varint eski_offset, varint uzunluk, sonra uzunluk dolana kadar
+                   [varint sifir_sayisi][varint literal_sayisi][literal baytlar]
+                   yeni[k] = eski[offset + k] + fark[k]  (mod 256)
+      0x02 INSERT: varint uzunluk, baytlar
+      0x00 END
+bsdiff'teki gibi, yeniden konumlanan kodda adresler degisse de eski bolgeyi
+"fark" olarak kopyalariz; fark cogunlukla sifir oldugu icin sifir kosulari
+birkac bayta iner. Firmware yamayi akis halinde uygular: yama yalnizca
+ileri dogru okunur, eski imaj ise calisan flash bolumunden rastgele erisimle
+okunur (her DIFF eski imajin herhangi bir yerinden, oncekinin gerisinden de
+baslayabilir; yalnizca kendi icinde ileri gider).
+"""
+import hashlib
+import re
+import struct
+
+MAGIC = b"HDP1"
+HEADER = struct.Struct("<4sII32s32s")
+OP_END, OP_DIFF, OP_INSERT = 0, 1, 2
+
+BLOCK = 16  # eslesme tohumu
+STRIDE = 8  # eski imajdan her STRIDE baytta bir tohum indekslenir
+MIN_ZERO_RUN = 3  # daha kisa sifir kosulari literal icinde kalir
+MAX_MISS = 32  # yaklasik uzatma: en iyi skorun bu kadar gerisine dusunce dur
+
+_ZERO_RUN = re.compile(b"\x00{%d,}" % MIN_ZERO_RUN)
+
+
+class DeltaError(ValueError):
+    pass
+
+
+def _varint(value: int) -> bytes:
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def _read_varint(data: bytes, pos: int) -> tuple[int, int]:
+    value = shift = 0
+    while True:
+        if pos >= len(data) or shift > 28:
+            raise DeltaError("truncated varint")
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+        shift += 7
+
+
+def _match_len(a: bytes, ai: int, b: bytes, bi: int) -> int:
+    """a[ai:] ile b[bi:] ortak on ekinin uzunlugu; once 64'luk bloklar karsilastirilir."""
+    limit = min(len(a) - ai, len(b) - bi)
+    n = 0
+    while n + 64 <= limit and a[ai + n:ai + n + 64] == b[bi + n:bi + n + 64]:
+        n += 64
+    while n < limit and a[ai + n] == b[bi + n]:
+        n += 1
+    return n
+
+
+def _extend_approx(old: bytes, oi: int, new: bytes, ni: int) -> int:
+    """Kesin eslesmenin ardindan, eslesen baytlar farklilardan coksa devam eder.
+    Yeniden konumlanan koddaki adres/offset degisiklikleri boylece DIFF icinde kalir."""
+    limit = min(len(old) - oi, len(new) - ni)
+    score = best_score = best_len = 0
+    n = 0
+    while n < limit:
+        run = _match_len(new, ni + n, old, oi + n)
+        if run:
+            n += run
+            score += run
+            if score > best_score:
+                best_score, best_len = score, n
+            continue
+        n += 1
+        score -= 1
+        if score < best_score - MAX_MISS:
+            break
+    return best_len
+
+
+def _encode_diff(old_part: bytes, new_part: bytes) -> bytes:
+    diff = bytes((n - o) & 0xFF for n, o in zip(new_part, old_part))
+    # [sifir][literal] ciftleri; sifir kosusu acgozlu oldugundan ardindaki literal bos kalmaz
+    out = bytearray()
+    pos = 0
+    while pos < len(diff):
+        m = _ZERO_RUN.match(diff, pos)
+        zeros = (m.end() - pos) if m else 0
+        pos += zeros
+        nxt = _ZERO_RUN.search(diff, pos)
+        lit_end = nxt.start() if nxt else len(diff)
+        out += _varint(zeros) + _varint(lit_end - pos) + diff[pos:lit_end]
+        pos = lit_end
+    return bytes(out)
+
+
+def make_patch(old: bytes, new: bytes) -> bytes:
+    index: dict[bytes, int] = {}
+    for i in range(0, len(old) - BLOCK + 1, STRIDE):
+        index.setdefault(old[i:i + BLOCK], i)
+
+    out = bytearray(HEADER.pack(MAGIC, len(old), len(new), hashlib.sha256(old).digest(), hashlib.sha256(new).digest()))
+
+    def insert(start: int, end: int):
+        if end > start:
+            out.append(OP_INSERT)
+            out.extend(_varint(end - start))
+            out.extend(new[start:end])
+
+    lit_start = i = 0
+    n = len(new)
+    while i + BLOCK <= n:
+        j = index.get(new[i:i + BLOCK])
+        if j is None:
+            i += 1
+            continue
+        # Literal bolgeye dogru geri uzat
+        back = 0
+        while i - back > lit_start and j - back > 0 and new[i - back - 1] == old[j - back - 1]:
+            back += 1
+        length = back + _extend_approx(old, j, new, i)
+        start_new, start_old = i - back, j - back
+        insert(lit_start, start_new)
+        out.append(OP_DIFF)
+        out.extend(_varint(start_old))
+        out.extend(_varint(length))
+        out.extend(_encode_diff(old[start_old:start_old + length], new[start_new:start_new + length]))
+        i = lit_start = start_new + length
+    insert(lit_start, n)
+    out.append(OP_END)
+    return bytes(out)
+
+
+def patch_info(patch: bytes) -> tuple[int, int, bytes, bytes]:
+    if len(patch) < HEADER.size:
+        raise DeltaError("short patch")
+    magic, old_size, new_size, old_sha, new_sha = HEADER.unpack_from(patch)
+    if magic != MAGIC:
+        raise DeltaError("bad magic")
+    return old_size, new_size, old_sha, new_sha
+
+
+def apply_patch(old: bytes, patch: bytes) -> bytes:
+    old_size, new_size, old_sha, new_sha = patch_info(patch)
+    if len(old) != old_size or hashlib.sha256(old).digest() != old_sha:
+        raise DeltaError("base image mismatch")
+    out = bytearray()
+    pos = HEADER.size
+    while True:
+        if pos >= len(patch):
+            raise DeltaError("missing END")
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_INSERT:
+            length, pos = _read_varint(patch, pos)
+            if pos + length > len(patch):
+                raise DeltaError("truncated insert")
+            out += patch[pos:pos + length]
+            pos += length
+        elif op == OP_DIFF:
+            offset, pos = _read_varint(patch, pos)
+            length, pos = _read_varint(patch, pos)
+            if offset + length > old_size:
+                raise DeltaError("diff outside base image")
+            done = 0
+            while done < length:
+                zeros, pos = _read_varint(patch, pos)
+                lits, pos = _read_varint(patch, pos)
+                if not zeros and not lits:
+                    raise DeltaError("empty diff run")
+                if done + zeros + lits > length or pos + lits > len(patch):
+                    raise DeltaError("diff run overflow")
+                out += old[offset + done:offset + done + zeros]
+                done += zeros
+                base = offset + done
+                out += bytes((old[base + k] + patch[pos + k]) & 0xFF for k in range(lits))
+                pos += lits
+                done += lits
+        else:
+            raise DeltaError(f"unknown op {op}")
+        if len(out) > new_size:
+            raise DeltaError("output overflow")
+    if len(out) != new_size or hashlib.sha256(out).digest() != new_sha:
+        raise DeltaError("result mismatch")
+    return bytes(out)
@@ -0,0 +1,109 @@
+# backend/core/events.py
+"""Admin paneli icin canli cihaz degisiklikleri (server-sent events).
+
+Ingest yolu (upload, config yoklamasi, analiz sonucu) yalnizca degisen alanlari
+yayinlar; panel tam /devices listesini tekrar cekmeden kartlari yamalar.
+publish() threadpool ve Ollama worker thread'lerinden de cagrilir; her abonenin
+kuyrugu kendi event loop'unda doldurulur. Kisa kopmalarda EventSource'un
+gonderdigi Last-Event-ID ile son olaylar tekrar oynatilir; aradaki bosluk
+halkadan tasmissa ya da abone yetisemiyorsa panele "resync" gider.
+"""
+import asyncio
+import itertools
+import json
+import threading
+import time
+from collections import deque
+
+from .config import EVENTS_QUEUE_SIZE
+
+RESYNC = "resync"
+# Yalnizca "hala burada" anlamindaki lastSeen guncellemeleri cihaz basina en fazla
+# bu aralikla yayinlanir; panel 60 sn sessizligi offline sayar.
+SEEN_INTERVAL_SEC = 20
+
+
+class _Subscriber:
+    def __init__(self, loop: asyncio.AbstractEventLoop, queue_size: int):
+        self.loop = loop
+        self.queue: asyncio.Queue = asyncio.Queue(maxsize=queue_size)
+
+    def push(self, message: str):
+        # Yalnizca abonenin loop'unda calisir
+        try:
+            self.queue.put_nowait(message)
+        except asyncio.QueueFull:
+            # Yavas sekme: biriken deltalar anlamsiz, tam liste yeniden cekilsin
+            while not self.queue.empty():
+                self.queue.get_nowait()
+            self.queue.put_nowait(_format(None, RESYNC, {}))
+
+
+def _format(seq: int | None, kind: str, data: dict) -> str:
+    head = f"id: {seq}\n" if seq is not None else ""
+    return f"{head}event: {kind}\ndata: {json.dumps(data, separators=(',', ':'))}\n\n"
+
+
+class EventBus:
+    def __init__(self, queue_size: int = 256, history: int = 512):
+        self.queue_size = max(8, queue_size)
+        self._lock = threading.Lock()
+        self._subscribers: set[_Subscriber] = set()
+        self._seq = itertools.count(1)
+        self._last = 0
+        self._history: deque[tuple[int, str]] = deque(maxlen=max(1, history))
+        self._seen_at: dict[str, float] = {}
+
+    def publish(self, kind: str, data: dict):
+        with self._lock:
+            seq = next(self._seq)
+            self._last = seq
+            message = _format(seq, kind, data)
+            self._history.append((seq, message))
+            subscribers = list(self._subscribers)
+        for sub in subscribers:
+            try:
+                sub.loop.call_soon_threadsafe(sub.push, message)
+            except RuntimeError:
+                # Loop kapanmis; abone zaten gidiyor
+                pass
+
+    def device(self, device_id: str, **fields):
+        """Cihaz kartina uygulanacak kismi guncelleme (admin API alan adlariyla)."""
+        if "lastSeen" in fields:
+            self._seen_at[device_id] = time.monotonic()
+        self.publish("device", {"deviceId": device_id, **fields})
+
+    def seen(self, device_id: str, last_seen: int, **fields):
+        """Config yoklamasi gibi sik gelen isteklerden: degisen alan yoksa seyreltilir."""
+        if not fields and time.monotonic() - self._seen_at.get(device_id, 0.0) < SEEN_INTERVAL_SEC:
+            return
+        self.device(device_id, lastSeen=last_seen, **fields)
+
+    def subscribe(self, last_event_id: str | None = None) -> tuple[_Subscriber, list[str]]:
+        """Aboneyi kaydeder; kacirilan olaylari (ya da resync) ilk mesajlar olarak doner."""
+        sub = _Subscriber(asyncio.get_running_loop(), self.queue_size)
+        try:
+            since = int(last_event_id) if last_event_id else None
+        except ValueError:
+            since = None
+        with self._lock:
+            self._subscribers.add(sub)
+            if since is None or since == self._last:
+                backlog = []
+            elif self._history and self._history[0][0] <= since + 1 and since < self._last:
+                backlog = [message for seq, message in self._history if seq > since]
+            else:
+                backlog = [_format(None, RESYNC, {})]
+        return sub, backlog
+
+    def unsubscribe(self, sub: _Subscriber):
+        with self._lock:
+            self._subscribers.discard(sub)
+
+    @property
+    def subscribers(self) -> int:
+        return len(self._subscribers)
+
+
+events = EventBus(EVENTS_QUEUE_SIZE)
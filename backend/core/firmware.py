@@ -0,0 +1,170 @@
+# backend/core/firmware.py
+"""Firmware imaj deposu ve OTA paket onbellegi.
+
+Imajlar data/firmware/<surum>.bin olarak durur. Cihaza giden govde her zaman
+zlib ile sikistirilir (firmware ROM'daki inflate ile acar): ya cihazin calisan
+surumune karsi HDP1 delta yamasi ya da tam imaj. Paketler bir kez uretilip
+data/firmware/cache altinda saklanir; ayni cift icin es zamanli istekler
+tek bir uretimi bekler.
+
+Her imajin yaninda <surum>.sig durur: imajin SHA-256'si uzerinde ECDSA P-256 (DER)
+imza. Imzayi yayin anahtarinin sahibi backend disinda atar; cihaz X-Fw-Signature
+basligini firmware'e gomulu acik anahtarla dogrular. Imzasiz imaj hedeflenemez.
+"""
+import base64
+import hashlib
+import re
+import threading
+import zlib
+from dataclasses import dataclass
+from pathlib import Path
+
+from .config import FIRMWARE_DIR
+from .delta import apply_patch, make_patch
+
+VERSION = re.compile(r"^[0-9A-Za-z][0-9A-Za-z._-]{0,31}$")
+ESP_IMAGE_MAGIC = 0xE9
+MAX_SIGNATURE_LEN = 72  # DER ECDSA P-256
+CACHE_DIR = FIRMWARE_DIR / "cache"
+CACHE_DIR.mkdir(parents=True, exist_ok=True)
+
+_locks: dict[str, threading.Lock] = {}
+_locks_guard = threading.Lock()
+_sha_cache: dict[str, tuple[float, str]] = {}
+
+
+@dataclass
+class Package:
+    path: Path
+    kind: str  # "delta" | "full"
+    image_size: int
+    image_sha256: str
+
+
+def valid_version(version: str) -> bool:
+    return bool(VERSION.match(version or ""))
+
+
+def image_path(version: str) -> Path:
+    if not valid_version(version):
+        raise ValueError(f"invalid firmware version: {version!r}")
+    return FIRMWARE_DIR / f"{version}.bin"
+
+
+def signature_path(version: str) -> Path:
+    return image_path(version).with_suffix(".sig")
+
+
+def has_image(version: str | None) -> bool:
+    """Cihaza verilebilir imaj: dosya ve imzasi birlikte."""
+    return (bool(version) and valid_version(version) and image_path(version).is_file()
+            and signature_path(version).is_file())
+
+
+def image_signature(version: str) -> str:
+    return base64.b64encode(signature_path(version).read_bytes()).decode("ascii")
+
+
+def image_sha256(version: str) -> str:
+    path = image_path(version)
+    mtime = path.stat().st_mtime
+    cached = _sha_cache.get(version)
+    if cached and cached[0] == mtime:
+        return cached[1]
+    digest = hashlib.sha256(path.read_bytes()).hexdigest()
+    _sha_cache[version] = (mtime, digest)
+    return digest
+
+
+def list_images() -> list[dict]:
+    items = []
+    for path in sorted(FIRMWARE_DIR.glob("*.bin")):
+        version = path.stem
+        if not valid_version(version):
+            continue
+        stat = path.stat()
+        items.append({
+            "version": version,
+            "size": stat.st_size,
+            "sha256": image_sha256(version),
+            "signed": signature_path(version).is_file(),
+            "uploaded": int(stat.st_mtime),
+        })
+    return items
+
+
+def _drop_cache(version: str):
+    for path in CACHE_DIR.glob("*"):
+        # "<surum>.bin.z" ya da "<eski>__<yeni>.hdp.z"; surumler nokta icerebilir
+        name = path.name.removesuffix(".bin.z").removesuffix(".hdp.z")
+        if version in name.split("__"):
+            path.unlink(missing_ok=True)
+
+
+def save_image(version: str, data: bytes, signature: bytes) -> dict:
+    path = image_path(version)
+    if len(data) < 256 or data[0] != ESP_IMAGE_MAGIC:
+        raise ValueError("not an ESP32 app image")
+    # Dogrulama cihazda; burada yalnizca bicim kontrolu (DER SEQUENCE)
+    if not 8 <= len(signature) <= MAX_SIGNATURE_LEN or signature[0] != 0x30:
+        raise ValueError("signature is not a DER ECDSA signature")
+    # Eski imza yeni imajla bir an bile eslesmesin
+    signature_path(version).unlink(missing_ok=True)
+    _write_atomic(path, data)
+    _write_atomic(signature_path(version), signature)
+    _sha_cache.pop(version, None)
+    # Ayni isimle yeniden yuklenen imajin eski paketleri artik gecersiz
+    _drop_cache(version)
+    return {"version": version, "size": len(data), "sha256": image_sha256(version)}
+
+
+def delete_image(version: str) -> bool:
+    path = image_path(version)
+    if not path.is_file():
+        return False
+    path.unlink()
+    signature_path(version).unlink(missing_ok=True)
+    _sha_cache.pop(version, None)
+    _drop_cache(version)
+    return True
+
+
+def _lock_for(key: str) -> threading.Lock:
+    with _locks_guard:
+        return _locks.setdefault(key, threading.Lock())
+
+
+def _write_atomic(path: Path, data: bytes):
+    tmp = path.with_suffix(path.suffix + ".tmp")
+    tmp.write_bytes(data)
+    tmp.replace(path)
+
+
+def _full_package(version: str) -> Path:
+    path = CACHE_DIR / f"{version}.bin.z"
+    with _lock_for(path.name):
+        if not path.is_file():
+            _write_atomic(path, zlib.compress(image_path(version).read_bytes(), 9))
+    return path
+
+
+def package(from_version: str | None, to_version: str, full: bool = False) -> Package:
+    """Cihazin calisan surumunden hedefe en kucuk govdeyi dondurur (bloklayici)."""
+    target = image_path(to_version).read_bytes()
+    size, sha = len(target), image_sha256(to_version)
+    full_path = _full_package(to_version)
+    if full or from_version == to_version or not has_image(from_version):
+        return Package(full_path, "full", size, sha)
+
+    path = CACHE_DIR / f"{from_version}__{to_version}.hdp.z"
+    with _lock_for(path.name):
+        if not path.is_file():
+            base = image_path(from_version).read_bytes()
+            patch = make_patch(base, target)
+            # Uretici hatasi cihaza gitmeden yakalansin: yamayi burada bir kez uygula
+            if apply_patch(base, patch) != target:
+                raise RuntimeError("delta self-check failed")
+            _write_atomic(path, zlib.compress(patch, 9))
+    if path.stat().st_size >= full_path.stat().st_size:
+        return Package(full_path, "full", size, sha)
+    return Package(path, "delta", size, sha)
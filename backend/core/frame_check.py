@@ -0,0 +1,101 @@
+# backend/core/frame_check.py
+import io
+import threading
+from dataclasses import dataclass
+
+from .config import FRAME_DUP_DISTANCE, FRAME_DARK_LUMA, FRAME_KEEP_SEC
+
+try:
+    from ..native import _jpegscan
+except ImportError:  # derlenmemisse Pillow ile ayni ozet (yavas yol)
+    _jpegscan = None
+
+try:
+    from PIL import Image
+except ImportError:
+    Image = None
+
+
+@dataclass
+class FrameStats:
+    hash: int
+    luma: float
+    width: int
+    height: int
+
+
+@dataclass
+class FrameVerdict:
+    stats: FrameStats | None
+    change: float | None  # 0..1, onceki saklanan kareye gore dHash Hamming orani
+    duplicate: bool
+    dark: bool
+
+
+def _analyze_pillow(raw: bytes) -> FrameStats:
+    with Image.open(io.BytesIO(raw)) as img:
+        width, height = img.size
+        img.draft("L", (max(1, width // 8), max(1, height // 8)))
+        small = img.convert("L")
+    pixels = small.getdata()
+    luma = sum(pixels) / max(1, len(pixels))
+    grid = list(small.resize((9, 8), Image.BOX).getdata())
+    value = 0
+    for y in range(8):
+        for x in range(8):
+            value = (value << 1) | (1 if grid[y * 9 + x] < grid[y * 9 + x + 1] else 0)
+    return FrameStats(value, luma, width, height)
+
+
+def analyze(raw: bytes) -> FrameStats | None:
+    try:
+        if _jpegscan is not None:
+            return FrameStats(*_jpegscan.analyze(raw))
+        if Image is not None:
+            return _analyze_pillow(raw)
+    except Exception as exc:
+        print(f"[FRAME] analyze failed: {exc}")
+    return None
+
+
+class FrameGate:
+    """Cihaz basina son saklanan karenin ozetini tutar; kopya ve karanlik kareleri isaretler.
+
+    Kopya kareler yine de en az keep_sec'te bir saklanir ki zaman cizelgesi
+    sahne degismese de bosalmasin.
+    """
+
+    def __init__(self, dup_distance: int, dark_luma: int, keep_sec: int):
+        self.dup_distance = dup_distance
+        self.dark_luma = dark_luma
+        self.keep_sec = keep_sec
+        self._lock = threading.Lock()
+        # (device_id, akis) -> (hash, luma, ts)
+        self._last: dict[tuple[str, str], tuple[int, float, int]] = {}
+
+    def check(self, device_id: str, raw: bytes, ts: int, stream: str = "analysis") -> FrameVerdict:
+        stats = analyze(raw)
+        if stats is None:
+            return FrameVerdict(None, None, False, False)
+
+        dark = stats.luma <= self.dark_luma
+        with self._lock:
+            key = (device_id, stream)
+            prev = self._last.get(key)
+            change = None
+            duplicate = False
+            if prev is not None:
+                distance = (stats.hash ^ prev[0]).bit_count()
+                change = distance / 64.0
+                duplicate = (
+                    self.dup_distance >= 0
+                    and distance <= self.dup_distance
+                    and abs(stats.luma - prev[1]) < 4.0
+                    and ts - prev[2] < self.keep_sec
+                )
+            if not duplicate:
+                self._last[key] = (stats.hash, stats.luma, ts)
+        return FrameVerdict(stats, change, duplicate, dark)
+
+
+frame_gate = FrameGate(FRAME_DUP_DISTANCE, FRAME_DARK_LUMA, FRAME_KEEP_SEC)
@@ -0,0 +1,230 @@
+# backend/core/inference.py
+import base64
+import threading
+import time
+from collections import deque
+from dataclasses import dataclass, field
+from typing import Callable, Optional
+from urllib.parse import urlparse, urlunparse
+
+import requests
+
+from .config import (
+    AI_HOST_CONCURRENCY,
+    AI_MAX_QUEUE_AGE_SEC,
+    AI_KEEP_ALIVE,
+    AI_IMAGE_MAX_SIDE,
+    AI_REQUEST_TIMEOUT_SEC,
+)
+from .metrics import INFERENCE_WAIT, OLLAMA_REQUEST
+from .previews import downscale
+
+
+def build_generate_url(host: str) -> str:
+    parsed = urlparse(host.strip())
+    path = (parsed.path or "").rstrip("/")
+
+    if path.endswith("/api/generate"):
+        final_path = path
+    elif path.endswith("/api"):
+        final_path = f"{path}/generate"
+    elif path.endswith("/generate") and "/api" in path:
+        final_path = path
+    elif "/api/generate" in path:
+        final_path = path
+    else:
+        final_path = f"{path}/api/generate" if path else "/api/generate"
+
+    parsed = parsed._replace(path=final_path, params="", query="", fragment="")
+    return urlunparse(parsed)
+
+
+@dataclass
+class InferenceJob:
+    device_id: str
+    frame_id: int
+    endpoint: str
+    model: str
+    prompt: str
+    options: dict
+    image: bytes
+    captured: float  # kare zamani (epoch sn)
+    on_result: Callable[["InferenceJob", str], None]
+    priority: bool = False  # tetik (PIR/kapi) karesi; zamanlanmis karelerden once islenir
+    enqueued: float = field(default_factory=time.monotonic)
+
+
+class _HostQueue:
+    def __init__(self, endpoint: str):
+        self.endpoint = endpoint
+        self.cond = threading.Condition()
+        # device_id -> bekleyen en yeni is; eskisi geldiginde yenisiyle degisir
+        self.pending: dict[str, InferenceJob] = {}
+        self.workers: list[threading.Thread] = []
+        self.inflight = 0
+        self.completed = 0
+        self.failed = 0
+        self.superseded = 0
+        self.stale = 0
+        self.done_at: deque[float] = deque(maxlen=512)
+        self.latency: deque[float] = deque(maxlen=256)  # kare zamanindan sonuca (uctan uca), sn
+        self.service: deque[float] = deque(maxlen=256)  # yalnizca HTTP cagrisi, sn
+
+
+def _percentile(values, q: float) -> float | None:
+    if not values:
+        return None
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(q * len(ordered)))]
+
+
+class InferenceScheduler:
+    """AI host basina sinirli eszamanlilikla Ollama analiz kuyrugu.
+
+    Her cihaz icin yalnizca en yeni kare bekler; yenisi gelince eskisi
+    dusurulur. Bekleyen tetik karesini ise yalnizca yeni bir tetik karesi
+    degistirir. Kuyrukta max_age_sec'ten fazla bekleyen kareler islenmeden atilir.
+    Cihazlar arasinda once tetik kareleri, sonra ilk gelen ilk islenir.
+    """
+
+    def __init__(self, per_host: int, max_age_sec: int, keep_alive: str, image_max_side: int, timeout_sec: int):
+        self.per_host = max(1, per_host)
+        self.max_age_sec = max(1, max_age_sec)
+        self.keep_alive = keep_alive
+        self.image_max_side = image_max_side
+        self.timeout_sec = max(1, timeout_sec)
+        self._lock = threading.Lock()
+        self._hosts: dict[str, _HostQueue] = {}
+
+    def _host(self, endpoint: str) -> _HostQueue:
+        with self._lock:
+            host = self._hosts.get(endpoint)
+            if host is None:
+                host = self._hosts[endpoint] = _HostQueue(endpoint)
+                for idx in range(self.per_host):
+                    worker = threading.Thread(
+                        target=self._run, args=(host,), name=f"ollama {endpoint} #{idx}", daemon=True
+                    )
+                    host.workers.append(worker)
+                    worker.start()
+            return host
+
+    def submit(self, job: InferenceJob):
+        host = self._host(job.endpoint)
+        with host.cond:
+            prev = host.pending.get(job.device_id)
+            if prev is not None:
+                host.superseded += 1
+                if prev.priority and not job.priority:
+                    return
+            host.pending[job.device_id] = job
+            host.cond.notify()
+
+    def _next(self, host: _HostQueue) -> InferenceJob:
+        with host.cond:
+            while True:
+                while not host.pending:
+                    host.cond.wait()
+                device_id = min(
+                    host.pending, key=lambda d: (not host.pending[d].priority, host.pending[d].enqueued)
+                )
+                job = host.pending.pop(device_id)
+                if time.monotonic() - job.enqueued > self.max_age_sec:
+                    host.stale += 1
+                    continue
+                host.inflight += 1
+                return job
+
+    def _run(self, host: _HostQueue):
+        # requests.Session thread-safe degil: her isci kendi baglanti havuzunu tutar
+        session = requests.Session()
+        while True:
+            job = self._next(host)
+            started = time.monotonic()
+            text = None
+            try:
+                text = self._generate(session, job)
+            except Exception as exc:
+                print(f"[OLLAMA] request error for device={job.device_id}: {exc}")
+            finished = time.monotonic()
+            INFERENCE_WAIT.observe(started - job.enqueued, host=host.endpoint)
+            OLLAMA_REQUEST.observe(finished - started, host=host.endpoint, outcome="error" if text is None else "ok")
+            with host.cond:
+                host.inflight -= 1
+                host.service.append(finished - started)
+                if text is None:
+                    host.failed += 1
+                else:
+                    host.completed += 1
+                    host.done_at.append(finished)
+                    host.latency.append(max(0.0, time.time() - job.captured))
+            if text is not None:
+                try:
+                    job.on_result(job, text)
+                except Exception as exc:
+                    print(f"[OLLAMA] failed to store result for device={job.device_id}: {exc}")
+
+    def _generate(self, session: requests.Session, job: InferenceJob) -> Optional[str]:
+        image = job.image
+        if self.image_max_side > 0:
+            # Modelin girdi boyutundan buyuk kareyi base64 oncesi kucult
+            image = downscale(image, self.image_max_side) or image
+
+        payload = {
+            "model": job.model,
+            "prompt": job.prompt,
+            "stream": False,
+            "options": job.options,
+            "images": [base64.b64encode(image).decode("ascii")],
+        }
+        if self.keep_alive:
+            payload["keep_alive"] = self.keep_alive
+
+        response = session.post(job.endpoint, json=payload, timeout=self.timeout_sec)
+        if response.status_code != 200:
+            print(f"[OLLAMA] HTTP {response.status_code} for device={job.device_id} endpoint={job.endpoint} body={response.text[:200]}")
+            return None
+
+        try:
+            data = response.json()
+        except ValueError:
+            print(f"[OLLAMA] invalid JSON for device={job.device_id}")
+            return None
+
+        text = data.get("response") or data.get("output") or data.get("text")
+        if isinstance(text, list):
+            text = " ".join(str(part) for part in text if part)
+        if text:
+            return str(text).strip()
+        return None
+
+    def stats(self) -> list[dict]:
+        now = time.monotonic()
+        with self._lock:
+            hosts = list(self._hosts.values())
+        out = []
+        for host in hosts:
+            with host.cond:
+                latency = list(host.latency)
+                service = list(host.service)
+                out.append({
+                    "endpoint": host.endpoint,
+                    "concurrency": len(host.workers),
+                    "queued": len(host.pending),
+                    "inflight": host.inflight,
+                    "completed": host.completed,
+                    "failed": host.failed,
+                    "superseded": host.superseded,
+                    "stale": host.stale,
+                    "perMinute": sum(1 for t in host.done_at if now - t <= 60),
+                    "latencyP50Sec": _percentile(latency, 0.50),
+                    "latencyP95Sec": _percentile(latency, 0.95),
+                    "serviceP50Sec": _percentile(service, 0.50),
+                    "serviceP95Sec": _percentile(service, 0.95),
+                })
+        return out
+
+
+inference = InferenceScheduler(
+    AI_HOST_CONCURRENCY, AI_MAX_QUEUE_AGE_SEC, AI_KEEP_ALIVE, AI_IMAGE_MAX_SIDE, AI_REQUEST_TIMEOUT_SEC
+)
@@ -0,0 +1,181 @@
+# backend/core/metrics.py
+"""Prometheus metin bicimi (0.0.4) icin kucuk, bagimliliksiz metrik kaydi.
+
+Histogramlar ve sayaclar istek yolunda guncellenir; kuyruk derinligi gibi
+anlik degerler ise kazima (scrape) aninda fn ile okunur. Tum metrikler
+thread-safe; upload yolunun bir kismi threadpool'da calisiyor.
+"""
+import bisect
+import math
+import threading
+import time
+from contextlib import contextmanager
+from typing import Callable, Iterable
+
+# Saniye: 0.5 ms'lik sqlite okumasindan dakikalik Ollama cagrisina kadar
+DEFAULT_BUCKETS = (
+    0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0,
+)
+
+
+def _escape(value) -> str:
+    return str(value).replace("\\", "\\\\").replace("\n", "\\n").replace('"', '\\"')
+
+
+def _format_labels(pairs) -> str:
+    pairs = list(pairs)
+    if not pairs:
+        return ""
+    return "{" + ",".join(f'{name}="{_escape(value)}"' for name, value in pairs) + "}"
+
+
+def _format_value(value) -> str:
+    if value == math.inf:
+        return "+Inf"
+    if isinstance(value, int):
+        return str(value)
+    return repr(float(value))
+
+
+class _Metric:
+    kind = "untyped"
+
+    def __init__(self, name: str, help_text: str, labels: Iterable[str] = (), fn: Callable | None = None):
+        self.name = name
+        self.help = help_text
+        self.labelnames = tuple(labels)
+        # fn: kazima aninda [(etiket_degerleri, deger), ...] ya da etiketsiz tek deger doner
+        self.fn = fn
+        self._lock = threading.Lock()
+        self._values: dict[tuple, object] = {}
+
+    def _key(self, labels: dict) -> tuple:
+        if len(labels) != len(self.labelnames):
+            raise ValueError(f"{self.name}: expected labels {self.labelnames}, got {tuple(labels)}")
+        return tuple(str(labels[name]) for name in self.labelnames)
+
+    def _items(self):
+        if self.fn is None:
+            with self._lock:
+                return sorted(self._values.items())
+        result = self.fn()
+        if not self.labelnames:
+            return [((), result)]
+        return sorted((tuple(str(v) for v in key), value) for key, value in result)
+
+    def _samples(self):
+        for key, value in self._items():
+            yield f"{self.name}{_format_labels(zip(self.labelnames, key))} {_format_value(value)}"
+
+    def render(self) -> list[str]:
+        lines = [f"# HELP {self.name} {self.help}", f"# TYPE {self.name} {self.kind}"]
+        lines.extend(self._samples())
+        return lines
+
+
+class Counter(_Metric):
+    kind = "counter"
+
+    def inc(self, amount: float = 1, **labels):
+        key = self._key(labels)
+        with self._lock:
+            self._values[key] = self._values.get(key, 0) + amount
+
+
+class Gauge(_Metric):
+    kind = "gauge"
+
+    def set(self, value: float, **labels):
+        key = self._key(labels)
+        with self._lock:
+            self._values[key] = value
+
+
+class Histogram(_Metric):
+    kind = "histogram"
+
+    def __init__(self, name: str, help_text: str, labels: Iterable[str] = (), buckets=DEFAULT_BUCKETS):
+        super().__init__(name, help_text, labels)
+        self.buckets = tuple(sorted(buckets))
+
+    def observe(self, value: float, **labels):
+        key = self._key(labels)
+        index = bisect.bisect_left(self.buckets, value)
+        with self._lock:
+            state = self._values.get(key)
+            if state is None:
+                # [kova basina sayilar (+Inf dahil), toplam, adet]
+                state = self._values[key] = [[0] * (len(self.buckets) + 1), 0.0, 0]
+            state[0][index] += 1
+            state[1] += value
+            state[2] += 1
+
+    @contextmanager
+    def time(self, **labels):
+        started = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.observe(time.perf_counter() - started, **labels)
+
+    def _samples(self):
+        with self._lock:
+            items = sorted((key, (list(state[0]), state[1], state[2])) for key, state in self._values.items())
+        for key, (counts, total, count) in items:
+            base = list(zip(self.labelnames, key))
+            cumulative = 0
+            for bound, n in zip(self.buckets + (math.inf,), counts):
+                cumulative += n
+                le = _format_value(bound)
+                yield f"{self.name}_bucket{_format_labels(base + [('le', le)])} {cumulative}"
+            yield f"{self.name}_sum{_format_labels(base)} {_format_value(total)}"
+            yield f"{self.name}_count{_format_labels(base)} {count}"
+
+
+class Registry:
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._metrics: dict[str, _Metric] = {}
+
+    def _add(self, metric: _Metric) -> _Metric:
+        with self._lock:
+            if metric.name in self._metrics:
+                raise ValueError(f"duplicate metric {metric.name}")
+            self._metrics[metric.name] = metric
+        return metric
+
+    def counter(self, name: str, help_text: str, labels: Iterable[str] = (), fn: Callable | None = None) -> Counter:
+        return self._add(Counter(name, help_text, labels, fn))
+
+    def gauge(self, name: str, help_text: str, labels: Iterable[str] = (), fn: Callable | None = None) -> Gauge:
+        return self._add(Gauge(name, help_text, labels, fn))
+
+    def histogram(self, name: str, help_text: str, labels: Iterable[str] = (), buckets=DEFAULT_BUCKETS) -> Histogram:
+        return self._add(Histogram(name, help_text, labels, buckets))
+
+    def render(self) -> str:
+        with self._lock:
+            metrics = list(self._metrics.values())
+        lines = []
+        for metric in metrics:
+            lines.extend(metric.render())
+        return "\n".join(lines) + "\n"
+
+
+registry = Registry()
+
+# Upload ve config yollari: bearer kontrolu, get_device, govde okuma, kare kontrolu,
+# segment yazimi, update_config... her asama ayri etiketle ayni histogramda.
+UPLOAD_STAGE = registry.histogram("homedog_upload_stage_seconds", "Upload request time per stage", ["stage"])
+CONFIG_STAGE = registry.histogram("homedog_config_stage_seconds", "Device config poll time per stage", ["stage"])
+INGEST_BYTES = registry.counter("homedog_ingest_bytes_total", "JPEG bytes received", ["stream"])
+FRAMES = registry.counter("homedog_frames_total", "Frames received per device and outcome", ["device", "result"])
+UPLOAD_ERRORS = registry.counter("homedog_upload_errors_total", "Rejected uploads by status and cause", ["code", "cause"])
+
+# Ollama: kuyrukta bekleme ve HTTP cagrisi ayri; ikisinin toplami analiz gecikmesi
+OLLAMA_REQUEST = registry.histogram(
+    "homedog_ollama_request_seconds", "Ollama generate call time", ["host", "outcome"]
+)
+INFERENCE_WAIT = registry.histogram(
+    "homedog_inference_queue_wait_seconds", "Time an analysis job waited for a worker", ["host"]
+)
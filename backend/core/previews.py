@@ -0,0 +1,122 @@
+# backend/core/previews.py
+import io
+from pathlib import Path
+
+from .config import UPLOAD_DIR
+from .storage import safe_component
+
+try:
+    from PIL import Image
+except ImportError:  # Pillow yoksa onizleme yerine orijinal JPEG servis edilir
+    Image = None
+
+# Varyant -> uzun kenar (px)
+PREVIEW_SIZES = {
+    "thumb": 320,
+    "medium": 960,
+}
+PREVIEW_QUALITY = 70
+
+
+def preview_url(url_path: str | None, variant: str) -> str | None:
+    """/uploads/<dev>/<file> -> /previews/<dev>/<variant>/<file>
+    Segment kareleri (/frames/...) varyanti sorgu parametresiyle ister."""
+    if url_path and url_path.startswith("/frames/"):
+        return f"{url_path}?variant={variant}"
+    if not url_path or not url_path.startswith("/uploads/"):
+        return url_path
+    parts = url_path[len("/uploads/"):].split("/", 1)
+    if len(parts) != 2:
+        return url_path
+    return f"/previews/{parts[0]}/{variant}/{parts[1]}"
+
+
+def source_path(device_id: str, fname: str) -> Path:
+    return UPLOAD_DIR / safe_component(device_id) / safe_component(fname)
+
+
+def preview_path(device_id: str, fname: str, variant: str) -> Path:
+    return UPLOAD_DIR / safe_component(device_id) / "previews" / variant / safe_component(fname)
+
+
+def within_upload_dir(path: Path) -> bool:
+    """Servis edilecek dosya (symlink'ler cozulmus haliyle) UPLOAD_DIR altinda mi."""
+    try:
+        path.resolve().relative_to(UPLOAD_DIR.resolve())
+    except ValueError:
+        return False
+    return True
+
+
+def _encode(src, size: int | None, quality: int) -> bytes:
+    with Image.open(src) as img:
+        if size:
+            # JPEG icin DCT olceklemeli decode: tam cozunurluk hic acilmaz.
+            img.draft("RGB", (size, size))
+        img = img.convert("RGB")
+        if size:
+            img.thumbnail((size, size))
+        out = io.BytesIO()
+        img.save(out, "JPEG", quality=quality, optimize=True)
+        return out.getvalue()
+
+
+def render_variant(raw: bytes, variant: str) -> bytes | None:
+    """Bellekteki JPEG'den onizleme uretir (segment kareleri icin)."""
+    size = PREVIEW_SIZES.get(variant)
+    if size is None or Image is None:
+        return None
+    try:
+        return _encode(io.BytesIO(raw), size, PREVIEW_QUALITY)
+    except Exception as exc:
+        print(f"[PREVIEW] failed variant={variant}: {exc}")
+        return None
+
+
+def downscale(raw: bytes, max_side: int, quality: int = 85) -> bytes | None:
+    """Uzun kenari max_side'i asan kareyi kucultur; gerek yoksa None doner."""
+    if Image is None:
+        return None
+    try:
+        with Image.open(io.BytesIO(raw)) as img:
+            if max(img.size) <= max_side:
+                return None
+        return _encode(io.BytesIO(raw), max_side, quality)
+    except Exception as exc:
+        print(f"[PREVIEW] downscale failed: {exc}")
+        return None
+
+
+def recompress(raw: bytes, quality: int) -> bytes | None:
+    """Eski kareleri ayni cozunurlukte daha dusuk kaliteyle yeniden kodlar."""
+    if Image is None:
+        return None
+    try:
+        out = _encode(io.BytesIO(raw), None, quality)
+    except Exception as exc:
+        print(f"[PREVIEW] recompress failed: {exc}")
+        return None
+    return out if len(out) < len(raw) else raw
+
+
+def ensure_preview(device_id: str, fname: str, variant: str) -> Path | None:
+    """Onizlemeyi gerekirse uretir; uretilemiyorsa None doner."""
+    size = PREVIEW_SIZES.get(variant)
+    if size is None or Image is None:
+        return None
+    src = source_path(device_id, fname)
+    dst = preview_path(device_id, fname, variant)
+    if dst.exists():
+        return dst
+    if not src.is_file():
+        return None
+    try:
+        data = _encode(src, size, PREVIEW_QUALITY)
+        dst.parent.mkdir(parents=True, exist_ok=True)
+        tmp = dst.with_suffix(".tmp")
+        tmp.write_bytes(data)
+        tmp.replace(dst)
+    except Exception as exc:
+        print(f"[PREVIEW] failed dev={device_id} file={fname} variant={variant}: {exc}")
+        return None
+    return dst
@@ -0,0 +1,134 @@
+# backend/core/retention.py
+import os
+import threading
+import time
+from pathlib import Path
+
+from .config import (
+    UPLOAD_DIR,
+    FRAME_RETENTION_SEC,
+    ARCHIVE_RETENTION_SEC,
+    RECOMPRESS_AFTER_SEC,
+    RECOMPRESS_QUALITY,
+    RETENTION_SWEEP_SEC,
+)
+from .db import delete_segment_frames, list_segment_frames, pop_expired_file_frames, relocate_frames
+from .previews import PREVIEW_SIZES, Image, preview_path, recompress
+from .segments import STREAM_ANALYSIS, STREAM_ARCHIVE, frame_url, segment_path, segment_store
+
+
+class RetentionWorker:
+    """Suresi dolan kareleri cihaz bazinda siler, eski segmentleri yeniden sikistirir.
+
+    Segment kareleri kova kova (tek dosya silme) dusurulur; segment oncesi
+    tekil JPEG'ler ise tek tek silinir. Arsiv akisinin kendi saklama suresi
+    vardir ve delil niteligindeki bu kareler yeniden sikistirilmaz.
+    """
+
+    def __init__(
+        self,
+        interval_sec: int,
+        retention_sec: int,
+        recompress_after_sec: int,
+        quality: int,
+        archive_retention_sec: int = 0,
+    ):
+        self.interval_sec = max(10, interval_sec)
+        self.retention_sec = retention_sec
+        self.archive_retention_sec = archive_retention_sec
+        self.recompress_after_sec = recompress_after_sec
+        self.quality = quality
+        # Bozuk kayit yuzunden tam yeniden yazilamayan segmentler; her turda tekrar denenmez
+        self._keep_original: set[tuple[str, str]] = set()
+        self._thread: threading.Thread | None = None
+
+    def start(self):
+        if self._thread is not None and self._thread.is_alive():
+            return
+        if self.retention_sec <= 0 and self.archive_retention_sec <= 0 and self.recompress_after_sec <= 0:
+            return
+        self._thread = threading.Thread(target=self._run, name="frame-retention", daemon=True)
+        self._thread.start()
+
+    def _run(self):
+        while True:
+            try:
+                self.sweep()
+            except Exception as exc:
+                print(f"[RETENTION] sweep failed: {exc}")
+            time.sleep(self.interval_sec)
+
+    def sweep(self, now: int | None = None):
+        now = int(time.time()) if now is None else now
+        if not UPLOAD_DIR.is_dir():
+            return
+        for entry in os.scandir(UPLOAD_DIR):
+            if entry.is_dir():
+                self._sweep_device(entry.name, now)
+
+    def _sweep_device(self, device_id: str, now: int):
+        for stream, retention_sec in (
+            (STREAM_ANALYSIS, self.retention_sec),
+            (STREAM_ARCHIVE, self.archive_retention_sec),
+        ):
+            if retention_sec <= 0:
+                continue
+            # Kovanin tamami cutoff'tan eskiyse segment butunuyle silinir.
+            for seg in segment_store.sealed(device_id, now - retention_sec, stream):
+                dropped = delete_segment_frames(device_id, seg)
+                segment_store.drop(device_id, seg)
+                print(f"[RETENTION] dev={device_id} seg={seg} frames={dropped} dropped")
+
+        if self.retention_sec > 0:
+            cutoff = now - self.retention_sec
+            for path in pop_expired_file_frames(device_id, cutoff):
+                Path(path).unlink(missing_ok=True)
+                for variant in PREVIEW_SIZES:
+                    preview_path(device_id, Path(path).name, variant).unlink(missing_ok=True)
+
+        if self.recompress_after_sec > 0 and Image is not None:
+            for seg in segment_store.sealed(device_id, now - self.recompress_after_sec, STREAM_ANALYSIS):
+                if not seg.endswith("c") and (device_id, seg) not in self._keep_original:
+                    self._recompress(device_id, seg)
+
+    def _recompress(self, device_id: str, seg: str):
+        before = segment_path(device_id, seg).stat().st_size
+        new_seg, mapping = segment_store.rewrite(
+            device_id, seg, lambda raw: recompress(raw, self.quality) or raw
+        )
+        rows = list_segment_frames(device_id, seg)
+        # iter_records ilk bozuk kayitta durur; arkasindaki saglam kareler yeni segmente
+        # gecmemistir. Indeksli her kayit tasinmadiysa orijinal segment yerinde kalir.
+        lost = sum(
+            1 for row in rows
+            if row["seg_offset"] not in mapping
+            or (row["thumb_offset"] is not None and row["thumb_offset"] not in mapping)
+        )
+        if lost:
+            segment_store.drop(device_id, new_seg)
+            self._keep_original.add((device_id, seg))
+            print(f"[RETENTION] dev={device_id} seg={seg} unreadable record, {lost} frames not rewritten; kept original")
+            return
+        new_path = str(segment_path(device_id, new_seg))
+        updates = []
+        for row in rows:
+            offset, size = mapping[row["seg_offset"]]
+            thumb = mapping.get(row["thumb_offset"]) if row["thumb_offset"] is not None else None
+            updates.append({
+                "id": row["id"],
+                "seg": new_seg,
+                "seg_offset": offset,
+                "size": size,
+                "path": new_path,
+                "url": frame_url(device_id, new_seg, offset),
+                "thumb_offset": thumb[0] if thumb else None,
+            })
+        relocate_frames(updates)
+        segment_store.drop(device_id, seg)
+        after = segment_path(device_id, new_seg).stat().st_size
+        print(f"[RETENTION] dev={device_id} seg={seg} recompressed {before} -> {after} bytes")
+
+
+retention = RetentionWorker(
+    RETENTION_SWEEP_SEC, FRAME_RETENTION_SEC, RECOMPRESS_AFTER_SEC, RECOMPRESS_QUALITY, ARCHIVE_RETENTION_SEC
+)
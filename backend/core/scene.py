@@ -0,0 +1,62 @@
+# backend/core/scene.py
+"""Sahne profilleri: firmware'in gece/alacakaranlik modlari icin esik ve sensor ayarlari.
+
+Cihaza tek satirlik bir metin olarak gider (firmware SceneEngine ile ayni bicim):
+    mode:enter:exit:gainceiling:aeLevel:aec2:grayscale:irLight;...
+enter/exit, firmware'in pozlama indeksidir (AEC + 40 * AGC); listede olmayan mod kapalidir.
+Bos liste "none" olarak gonderilir.
+"""
+import json
+
+SCENE_MODES = ("dusk", "night", "ir")
+
+DEFAULT_SCENE_PROFILES = [
+    {"mode": "dusk", "enter": 650, "exit": 500, "gainceiling": 4, "aeLevel": 1,
+     "aec2": True, "grayscale": False, "irLight": False},
+    {"mode": "night", "enter": 1100, "exit": 900, "gainceiling": 5, "aeLevel": 2,
+     "aec2": True, "grayscale": False, "irLight": False},
+]
+
+
+def _clamp(value, lo, hi):
+    return max(lo, min(hi, int(value)))
+
+
+def normalize_profile(item: dict) -> dict:
+    mode = str(item.get("mode", "")).strip().lower()
+    if mode not in SCENE_MODES:
+        raise ValueError(f"unknown scene mode: {mode!r}")
+    enter = _clamp(item.get("enter", 0), 0, 4000)
+    return {
+        "mode": mode,
+        "enter": enter,
+        # Histerezis: cikis esigi giris esiginin ustune cikamaz
+        "exit": _clamp(item.get("exit", enter), 0, enter),
+        "gainceiling": _clamp(item.get("gainceiling", 4), 0, 5),
+        "aeLevel": _clamp(item.get("aeLevel", 0), -2, 2),
+        "aec2": bool(item.get("aec2", False)),
+        "grayscale": bool(item.get("grayscale", False)),
+        "irLight": bool(item.get("irLight", False)),
+    }
+
+
+def parse_scene_profiles(text: str | None) -> list[dict]:
+    """DB'deki JSON'u okur; bos ya da bozuksa varsayilan profilleri doner."""
+    if not text:
+        return [dict(p) for p in DEFAULT_SCENE_PROFILES]
+    try:
+        items = json.loads(text)
+        return [normalize_profile(item) for item in items]
+    except (TypeError, ValueError, AttributeError):
+        return [dict(p) for p in DEFAULT_SCENE_PROFILES]
+
+
+def scene_spec(profiles: list[dict]) -> str:
+    parts = []
+    for p in profiles:
+        parts.append(":".join(str(v) for v in (
+            p["mode"], p["enter"], p["exit"], p["gainceiling"], p["aeLevel"],
+            int(p["aec2"]), int(p["grayscale"]), int(p["irLight"]),
+        )))
+    # Bos metin firmware'de "degismedi" demek; tum modlari kapatmak icin "none"
+    return ";".join(parts) or "none"
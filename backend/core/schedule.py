@@ -0,0 +1,114 @@
+# backend/core/schedule.py
+"""Cekim takvimi: haftalik zaman pencereleri ve her birinin upload profili.
+
+Pencereler cihazda, SNTP ile ayarlanmis yerel saate (cihazin tz'si) gore
+degerlendirilir; backend'in saat basi config gondermesi gerekmez. Firmware'e
+tek satirlik metin olarak gider (CaptureSchedule ile ayni bicim):
+    gunMaskesi:baslangicDk:bitisDk:aralikSn:framesize:kalite:autoUpload;...
+Gun maskesinde bit n = tm_wday n (0 = pazar). "-" alani temel ayari korur.
+Ilk eslesen pencere gecerlidir; bitis <= baslangic gece yarisini asar.
+Bos liste "none" olarak gonderilir.
+"""
+import json
+import re
+
+DAYS = ("sun", "mon", "tue", "wed", "thu", "fri", "sat")
+FRAMESIZES = ("QQVGA", "QVGA", "CIF", "VGA", "SVGA", "XGA", "SXGA", "UXGA")
+MAX_WINDOWS = 8  # firmware kScheduleMaxWindows
+
+_HHMM = re.compile(r"^([01]?\d|2[0-4]):([0-5]\d)$")
+# POSIX TZ: "UTC0", "<+03>-3", "CET-1CEST,M3.5.0,M10.5.0/3"
+TZ_PATTERN = re.compile(r"^[A-Za-z<>+\-0-9,./:]{3,48}$")
+
+
+def _minutes(value) -> int:
+    match = _HHMM.match(str(value or "").strip())
+    if not match:
+        raise ValueError(f"invalid time {value!r} (HH:MM)")
+    minutes = int(match.group(1)) * 60 + int(match.group(2))
+    if minutes > 1440:
+        raise ValueError(f"invalid time {value!r}")
+    return minutes
+
+
+def _hhmm(minutes: int) -> str:
+    return f"{minutes // 60:02d}:{minutes % 60:02d}"
+
+
+def _days(value) -> list[str]:
+    items = value if isinstance(value, list) else str(value or "").replace(",", " ").split()
+    days = []
+    for item in items:
+        day = str(item).strip().lower()[:3]
+        if day not in DAYS:
+            raise ValueError(f"unknown day {item!r}")
+        if day not in days:
+            days.append(day)
+    if not days:
+        raise ValueError("window needs at least one day")
+    return sorted(days, key=DAYS.index)
+
+
+def normalize_window(item: dict) -> dict:
+    start = _minutes(item.get("start"))
+    end = _minutes(item.get("end"))
+    if start >= 1440:
+        raise ValueError("start must be before 24:00")
+    window = {
+        "days": _days(item.get("days", list(DAYS))),
+        "start": _hhmm(start),
+        "end": _hhmm(end),
+        "intervalSec": None,
+        "framesize": None,
+        "jpegQuality": None,
+        "autoUpload": None,
+    }
+    # None: pencere bu alani temel config'ten alir
+    if item.get("intervalSec") is not None:
+        window["intervalSec"] = max(1, min(3600, int(item["intervalSec"])))
+    if item.get("framesize"):
+        framesize = str(item["framesize"]).strip().upper()
+        if framesize not in FRAMESIZES:
+            raise ValueError(f"unknown framesize {item['framesize']!r}")
+        window["framesize"] = framesize
+    if item.get("jpegQuality") is not None:
+        window["jpegQuality"] = max(5, min(63, int(item["jpegQuality"])))
+    if item.get("autoUpload") is not None:
+        window["autoUpload"] = bool(item["autoUpload"])
+    return window
+
+
+def normalize_schedule(items) -> list[dict]:
+    if not isinstance(items, list):
+        raise ValueError("expected a list of windows")
+    if len(items) > MAX_WINDOWS:
+        raise ValueError(f"at most {MAX_WINDOWS} windows")
+    return [normalize_window(item) for item in items]
+
+
+def parse_schedule(text: str | None) -> list[dict]:
+    """DB'deki JSON'u okur; bos ya da bozuksa takvim yok."""
+    if not text:
+        return []
+    try:
+        return normalize_schedule(json.loads(text))
+    except (TypeError, ValueError, AttributeError):
+        return []
+
+
+def schedule_spec(windows: list[dict]) -> str:
+    parts = []
+    for w in windows:
+        mask = sum(1 << DAYS.index(day) for day in w["days"])
+        fields = (
+            mask,
+            _minutes(w["start"]),
+            _minutes(w["end"]),
+            w["intervalSec"],
+            w["framesize"],
+            w["jpegQuality"],
+            None if w["autoUpload"] is None else int(w["autoUpload"]),
+        )
+        parts.append(":".join("-" if v is None else str(v) for v in fields))
+    # Bos metin firmware'de "degismedi" demek; takvimi silmek icin "none"
+    return ";".join(parts) or "none"
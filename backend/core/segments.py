@@ -0,0 +1,228 @@
+# backend/core/segments.py
+"""Kare deposu: cihaz basina zaman kovali, yalnizca sona eklenen segment dosyalari.
+
+Dosya duzeni: uploads/<dev>/segments/<kova_baslangici>.seg
+Arsiv akisi (tam cozunurluk kareler) ayri kovalara yazilir: a<kova_baslangici>.seg
+Her kayit 16 baytlik bir baslik (magic, uzunluk, ts) ve ardindan JPEG'den olusur.
+Kareler (segment, offset) ikilisiyle adreslenir; zaman sorgulari icin indeks
+frames tablosunda tutulur ama segmentler kendi baslarina da taranabilir.
+
+Saklama suresi dolan kovalar dosya olarak tek seferde silinir. Yeniden
+sikistirilan segmentler yeni bir adla ("<seg>c") yazilir; boylece eski URL'ler
+(immutable cache) hicbir zaman baska bir karenin icerigini gostermez.
+"""
+import errno
+import os
+import re
+import struct
+import threading
+from pathlib import Path
+from typing import Callable, Iterator
+
+from .config import UPLOAD_DIR, SEGMENT_SPAN_SEC
+from .storage import safe_component
+
+HEADER = struct.Struct("<4sIQ")
+MAGIC_FRAME = b"FRM1"
+MAGIC_THUMB = b"THM1"
+SEGMENT_NAME = re.compile(r"^(a?)(\d+)(c?)$")
+STREAM_ANALYSIS = "analysis"
+STREAM_ARCHIVE = "archive"
+_STREAM_PREFIX = {STREAM_ANALYSIS: "", STREAM_ARCHIVE: "a"}
+
+
+def segment_dir(device_id: str) -> Path:
+    return UPLOAD_DIR / safe_component(device_id) / "segments"
+
+
+def segment_path(device_id: str, seg: str) -> Path:
+    return segment_dir(device_id) / f"{seg}.seg"
+
+
+def segment_start(seg: str) -> int | None:
+    m = SEGMENT_NAME.match(seg)
+    return int(m.group(2)) if m else None
+
+
+def segment_stream(seg: str) -> str:
+    return STREAM_ARCHIVE if seg.startswith(_STREAM_PREFIX[STREAM_ARCHIVE]) else STREAM_ANALYSIS
+
+
+def frame_url(device_id: str, seg: str, offset: int) -> str:
+    return f"/frames/{device_id}/{seg}/{offset}.jpg"
+
+
+def iter_records(path: Path) -> Iterator[tuple[bytes, int, int, bytes]]:
+    """(magic, offset, ts, payload) uretir; yarim yazilmis son kayit atlanir."""
+    with open(path, "rb") as f:
+        offset = 0
+        while True:
+            head = f.read(HEADER.size)
+            if len(head) < HEADER.size:
+                return
+            magic, length, ts = HEADER.unpack(head)
+            payload = f.read(length)
+            if magic not in (MAGIC_FRAME, MAGIC_THUMB) or len(payload) < length:
+                return
+            yield magic, offset, ts, payload
+            offset += HEADER.size + length
+
+
+class _Writer:
+    def __init__(self, path: Path, seg: str):
+        path.parent.mkdir(parents=True, exist_ok=True)
+        self.seg = seg
+        self.path = path
+        self.fd = os.open(path, os.O_WRONLY | os.O_CREAT | os.O_APPEND, 0o644)
+        self.size = os.fstat(self.fd).st_size
+
+    def append(self, magic: bytes, ts: int, payload: bytes) -> int:
+        offset = self.size
+        record = HEADER.size + len(payload)
+        # Baslik + veri tek sistem cagrisinda, kopyasiz
+        try:
+            written = os.writev(self.fd, [HEADER.pack(magic, len(payload), ts), payload])
+        except OSError:
+            self.truncate(offset)
+            raise
+        if written != record:
+            # Disk dolu: yarim kayit kalirsa sonraki tum offset'ler kayar
+            self.truncate(offset)
+            raise OSError(errno.ENOSPC, f"short write to {self.path}: {written}/{record} bytes")
+        self.size += record
+        return offset
+
+    def truncate(self, size: int):
+        """Dosyayi son saglam kaydin sonuna geri alir (O_APPEND sonraki yazimi oraya koyar)."""
+        os.ftruncate(self.fd, size)
+        self.size = size
+
+    def close(self):
+        os.close(self.fd)
+
+
+class SegmentStore:
+    def __init__(self, span_sec: int):
+        self.span_sec = max(60, span_sec)
+        self._lock = threading.Lock()
+        self._device_locks: dict[str, threading.Lock] = {}
+        # (device_id, akis) -> acik yazici (yalnizca guncel kova)
+        self._writers: dict[tuple[str, str], _Writer] = {}
+
+    def _device_lock(self, device_id: str) -> threading.Lock:
+        with self._lock:
+            lock = self._device_locks.get(device_id)
+            if lock is None:
+                lock = self._device_locks[device_id] = threading.Lock()
+            return lock
+
+    def bucket(self, ts: int, stream: str = STREAM_ANALYSIS) -> str:
+        return f"{_STREAM_PREFIX[stream]}{ts - ts % self.span_sec}"
+
+    def append(
+        self,
+        device_id: str,
+        ts: int,
+        frame: bytes,
+        thumb: bytes | None = None,
+        stream: str = STREAM_ANALYSIS,
+    ) -> dict:
+        seg = self.bucket(ts, stream)
+        key = (device_id, stream)
+        with self._device_lock(device_id):
+            writer = self._writers.get(key)
+            if writer is None or writer.seg != seg:
+                if writer is not None:
+                    writer.close()
+                writer = self._writers[key] = _Writer(segment_path(device_id, seg), seg)
+            offset = writer.append(MAGIC_FRAME, ts, frame)
+            try:
+                thumb_offset = writer.append(MAGIC_THUMB, ts, thumb) if thumb else None
+            except OSError:
+                # Indekslenmeyecek kareyi de geri al
+                writer.truncate(offset)
+                raise
+        return {
+            "seg": seg,
+            "path": str(writer.path),
+            "offset": offset,
+            "thumb_offset": thumb_offset,
+            "thumb_size": len(thumb) if thumb else None,
+        }
+
+    def read(self, device_id: str, seg: str, offset: int) -> bytes | None:
+        if segment_start(seg) is None or offset < 0:
+            return None
+        try:
+            fd = os.open(segment_path(device_id, seg), os.O_RDONLY)
+        except FileNotFoundError:
+            return None
+        try:
+            head = os.pread(fd, HEADER.size, offset)
+            if len(head) < HEADER.size:
+                return None
+            magic, length, _ = HEADER.unpack(head)
+            if magic not in (MAGIC_FRAME, MAGIC_THUMB):
+                return None
+            data = os.pread(fd, length, offset + HEADER.size)
+            return data if len(data) == length else None
+        finally:
+            os.close(fd)
+
+    def sealed(self, device_id: str, now: int, stream: str | None = None) -> list[str]:
+        """Kovasi kapanmis (artik yazilmayan) segmentler, eskiden yeniye."""
+        d = segment_dir(device_id)
+        if not d.is_dir():
+            return []
+        out = []
+        for entry in os.scandir(d):
+            if not entry.name.endswith(".seg"):
+                continue
+            seg = entry.name[:-4]
+            start = segment_start(seg)
+            if start is None or start + self.span_sec > now:
+                continue
+            if stream is None or segment_stream(seg) == stream:
+                out.append(seg)
+        out.sort(key=segment_start)
+        return out
+
+    def drop(self, device_id: str, seg: str):
+        key = (device_id, segment_stream(seg))
+        with self._device_lock(device_id):
+            writer = self._writers.get(key)
+            if writer is not None and writer.seg == seg:
+                writer.close()
+                del self._writers[key]
+            segment_path(device_id, seg).unlink(missing_ok=True)
+
+    def rewrite(
+        self,
+        device_id: str,
+        seg: str,
+        transform: Callable[[bytes], bytes],
+    ) -> tuple[str, dict[int, tuple[int, int]]]:
+        """Kapanmis bir segmenti kareleri donusturerek "<seg>c" olarak yeniden yazar.
+
+        {eski_offset: (yeni_offset, yeni_uzunluk)} eslemesini doner; eski dosya
+        indeks guncellendikten sonra drop() ile silinmelidir.
+        """
+        new_seg = f"{seg}c"
+        src = segment_path(device_id, seg)
+        dst = segment_path(device_id, new_seg)
+        tmp = dst.with_suffix(".tmp")
+        mapping: dict[int, tuple[int, int]] = {}
+        writer = _Writer(tmp, new_seg)
+        try:
+            for magic, offset, ts, payload in iter_records(src):
+                if magic == MAGIC_FRAME:
+                    payload = transform(payload)
+                mapping[offset] = (writer.append(magic, ts, payload), len(payload))
+            os.fsync(writer.fd)
+        finally:
+            writer.close()
+        tmp.replace(dst)
+        return new_seg, mapping
+
+
+segment_store = SegmentStore(SEGMENT_SPAN_SEC)
@@ -0,0 +1,74 @@
+# backend/native/bench.py
+# Gercek yakalamalar uzerinde kare ozeti olcumu:
+#   python -m backend.native.bench uploads/CAM1 --repeat 20
+# Dizindeki .jpg dosyalari ve .seg segmentlerindeki kareler okunur.
+import argparse
+import statistics
+import time
+from pathlib import Path
+
+from ..core import frame_check
+from ..core.frame_check import FrameGate, _analyze_pillow
+from ..core.segments import MAGIC_FRAME, iter_records
+
+
+def load_frames(folder: Path, limit: int) -> list[bytes]:
+    frames = []
+    for path in sorted(folder.rglob("*")):
+        if path.suffix.lower() == ".jpg" and "previews" not in path.parts:
+            frames.append(path.read_bytes())
+        elif path.suffix == ".seg":
+            frames.extend(p for m, _, _, p in iter_records(path) if m == MAGIC_FRAME)
+        if len(frames) >= limit:
+            break
+    return frames[:limit]
+
+
+def time_us(fn, frames: list[bytes], repeat: int) -> list[float]:
+    samples = []
+    for raw in frames:
+        start = time.perf_counter()
+        for _ in range(repeat):
+            fn(raw)
+        samples.append((time.perf_counter() - start) * 1e6 / repeat)
+    return samples
+
+
+def report(name: str, samples: list[float]):
+    samples = sorted(samples)
+    p = lambda q: samples[min(len(samples) - 1, int(q * len(samples)))]
+    print(f"{name:8s} n={len(samples):5d} mean={statistics.fmean(samples):8.1f}us "
+          f"p50={p(0.50):8.1f}us p99={p(0.99):8.1f}us max={samples[-1]:8.1f}us")
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Benchmark JPEG frame summaries over captured frames")
+    ap.add_argument("folder", type=Path)
+    ap.add_argument("--limit", type=int, default=2000)
+    ap.add_argument("--repeat", type=int, default=10)
+    args = ap.parse_args()
+
+    frames = load_frames(args.folder, args.limit)
+    if not frames:
+        raise SystemExit(f"no frames under {args.folder}")
+    print(f"{len(frames)} frames, mean size {statistics.fmean(len(f) for f in frames) / 1024:.1f} KiB")
+
+    if frame_check._jpegscan is not None:
+        report("native", time_us(frame_check._jpegscan.analyze, frames, args.repeat))
+    else:
+        print("native   not built (cd backend/native && python setup.py build_ext --inplace)")
+    if frame_check.Image is not None:
+        report("pillow", time_us(_analyze_pillow, frames, max(1, args.repeat // 5)))
+
+    # Ardisik kareler uzerinde upload yolundaki kararlar
+    gate = FrameGate(frame_check.FRAME_DUP_DISTANCE, frame_check.FRAME_DARK_LUMA, frame_check.FRAME_KEEP_SEC)
+    dup = dark = 0
+    for idx, raw in enumerate(frames):
+        verdict = gate.check("bench", raw, idx)
+        dup += verdict.duplicate
+        dark += verdict.dark
+    print(f"decisions: stored={len(frames) - dup} duplicate={dup} dark={dark}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,170 @@
+// backend/native/jpegscan.cpp
+// JPEG summary: 1/8-scale grayscale decode (libjpeg-turbo SIMD IDCT), 64-bit dHash
+// and mean luma. Full resolution is never decoded; the GIL is released while decoding.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <csetjmp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <jpeglib.h>
+#include <jerror.h>
+
+namespace {
+
+constexpr int kHashW = 9;  // dHash: 9x8 grid, horizontal neighbour differences -> 64 bits
+constexpr int kHashH = 8;
+
+struct ErrorMgr {
+  jpeg_error_mgr pub;
+  jmp_buf jump;
+  char msg[JMSG_LENGTH_MAX];
+};
+
+void onError(j_common_ptr cinfo) {
+  auto* err = reinterpret_cast<ErrorMgr*>(cinfo->err);
+  (*cinfo->err->format_message)(cinfo, err->msg);
+  longjmp(err->jump, 1);
+}
+
+void onMessage(j_common_ptr cinfo, int level) {
+  // Keep libjpeg warnings about damaged but readable frames off stderr.
+  // Premature end of data is an error, though: libjpeg fills the missing blocks
+  // with gray, and a half-frame summary cannot be compared with the previous frame.
+  if (level < 0 && cinfo->err->msg_code == JWRN_JPEG_EOF) {
+    (*cinfo->err->error_exit)(cinfo);
+  }
+}
+
+struct Summary {
+  uint64_t hash = 0;
+  double luma = 0.0;
+  int width = 0;
+  int height = 0;
+};
+
+void summarize(const uint8_t* pixels, int w, int h, Summary& out) {
+  const size_t n = static_cast<size_t>(w) * h;
+  uint64_t total = 0;
+  for (size_t i = 0; i < n; ++i) total += pixels[i];
+  out.luma = n ? static_cast<double>(total) / n : 0.0;
+
+  // Box-average down to 9x8
+  uint32_t cells[kHashH][kHashW] = {};
+  uint32_t counts[kHashH][kHashW] = {};
+  for (int y = 0; y < h; ++y) {
+    const int cy = y * kHashH / h;
+    const uint8_t* row = pixels + static_cast<size_t>(y) * w;
+    for (int x = 0; x < w; ++x) {
+      const int cx = x * kHashW / w;
+      cells[cy][cx] += row[x];
+      counts[cy][cx] += 1;
+    }
+  }
+
+  uint64_t hash = 0;
+  for (int y = 0; y < kHashH; ++y) {
+    for (int x = 0; x < kHashW - 1; ++x) {
+      // An empty cell (very small source) counts as 0; the comparison stays consistent.
+      // Widen before multiplying: sum * count passes 32 bits from about 4k px per side.
+      const uint64_t left = counts[y][x] ? static_cast<uint64_t>(cells[y][x]) * counts[y][x + 1] : 0;
+      const uint64_t right = counts[y][x + 1] ? static_cast<uint64_t>(cells[y][x + 1]) * counts[y][x] : 0;
+      hash = (hash << 1) | (left < right ? 1u : 0u);
+    }
+  }
+  out.hash = hash;
+}
+
+bool analyze(const unsigned char* data, size_t len, Summary& out, char* msg, size_t msgLen) {
+  // longjmp skips destructors: no local with a destructor lives past setjmp. The pixel
+  // buffer comes from libjpeg's pool and is released by jpeg_destroy_decompress.
+  jpeg_decompress_struct cinfo;
+  ErrorMgr err;
+
+  cinfo.err = jpeg_std_error(&err.pub);
+  err.pub.error_exit = onError;
+  err.pub.emit_message = onMessage;
+  if (setjmp(err.jump)) {
+    std::snprintf(msg, msgLen, "%s", err.msg);
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data), static_cast<unsigned long>(len));
+  jpeg_read_header(&cinfo, TRUE);
+  out.width = static_cast<int>(cinfo.image_width);
+  out.height = static_cast<int>(cinfo.image_height);
+
+  // Y channel only, one sample per 8x8 block: the IDCT reduces to little more than DC.
+  cinfo.out_color_space = JCS_GRAYSCALE;
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = 8;
+  cinfo.dct_method = JDCT_IFAST;
+  cinfo.do_fancy_upsampling = FALSE;
+  cinfo.do_block_smoothing = FALSE;
+  jpeg_start_decompress(&cinfo);
+
+  const int w = static_cast<int>(cinfo.output_width);
+  const int h = static_cast<int>(cinfo.output_height);
+  auto* pixels = static_cast<uint8_t*>((*cinfo.mem->alloc_large)(
+      reinterpret_cast<j_common_ptr>(&cinfo), JPOOL_PERMANENT, static_cast<size_t>(w) * h));
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = pixels + static_cast<size_t>(cinfo.output_scanline) * w;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+
+  summarize(pixels, w, h, out);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+PyObject* pyAnalyze(PyObject*, PyObject* args) {
+  Py_buffer buf;
+  if (!PyArg_ParseTuple(args, "y*:analyze", &buf)) {
+    return nullptr;
+  }
+
+  Summary summary;
+  char msg[JMSG_LENGTH_MAX] = {};
+  bool ok;
+  Py_BEGIN_ALLOW_THREADS
+  ok = analyze(static_cast<const unsigned char*>(buf.buf), static_cast<size_t>(buf.len),
+               summary, msg, sizeof(msg));
+  Py_END_ALLOW_THREADS
+  PyBuffer_Release(&buf);
+
+  if (!ok) {
+    PyErr_Format(PyExc_ValueError, "JPEG decode failed: %s", msg);
+    return nullptr;
+  }
+  return Py_BuildValue("(Kdii)", static_cast<unsigned long long>(summary.hash),
+                       summary.luma, summary.width, summary.height);
+}
+
+PyMethodDef kMethods[] = {
+  {"analyze", pyAnalyze, METH_VARARGS,
+   "analyze(jpeg: bytes) -> (dhash64, mean_luma, width, height)"},
+  {nullptr, nullptr, 0, nullptr},
+};
+
+PyModuleDef kModule = {
+  PyModuleDef_HEAD_INIT,
+  "_jpegscan",                      // m_name
+  "Reduced-scale JPEG summaries.",  // m_doc
+  -1,                               // m_size
+  kMethods,                         // m_methods
+  nullptr,                          // m_slots
+  nullptr,                          // m_traverse
+  nullptr,                          // m_clear
+  nullptr,                          // m_free
+};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit__jpegscan(void) {
+  return PyModule_Create(&kModule);
+}
@@ -0,0 +1,18 @@
+# backend/native/setup.py
+# Derleme (libjpeg-turbo gelistirme paketi gerekir, or. libjpeg-turbo8-dev / libjpeg62-turbo-dev):
+#   cd backend/native && python setup.py build_ext --inplace
+# Modul yoksa backend Pillow ile (daha yavas) ayni ozeti hesaplar.
+from setuptools import Extension, setup
+
+setup(
+    name="jpegscan",
+    ext_modules=[
+        Extension(
+            "_jpegscan",
+            sources=["jpegscan.cpp"],
+            libraries=["jpeg"],
+            extra_compile_args=["-O2", "-std=c++17", "-Wall", "-Wextra"],
+            language="c++",
+        )
+    ],
+)
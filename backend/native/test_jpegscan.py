@@ -0,0 +1,55 @@
+# backend/native/test_jpegscan.py
+# Derlenmis modul uzerinde calisir:
+#   cd backend/native && python setup.py build_ext --inplace
+#   python -m unittest backend.native.test_jpegscan
+# fixtures/gradient_320x240.jpg: soldan saga 16..240 gri rampa, 4:2:0, q85 (libjpeg ile uretildi).
+# fixtures/gradient_4800x4800.jpg: ayni rampa, gri, q5; hucre toplami x sayisi 32 biti asar.
+import unittest
+from pathlib import Path
+
+try:
+    from . import _jpegscan
+except ImportError:
+    _jpegscan = None
+
+FIXTURE = Path(__file__).parent / "fixtures" / "gradient_320x240.jpg"
+LARGE_FIXTURE = Path(__file__).parent / "fixtures" / "gradient_4800x4800.jpg"
+
+
+@unittest.skipIf(_jpegscan is None, "_jpegscan derlenmemis")
+class AnalyzeTest(unittest.TestCase):
+    def setUp(self):
+        self.raw = FIXTURE.read_bytes()
+
+    def test_gradient_stats(self):
+        hash64, luma, width, height = _jpegscan.analyze(self.raw)
+        self.assertEqual((width, height), (320, 240))
+        # Rampanin ortalamasi 128; 1/8 olcek ve kayipli sikistirma kucuk sapma verir
+        self.assertAlmostEqual(luma, 128.0, delta=2.0)
+        # Her hucre solundakinden parlak: dHash'in 64 biti de 1
+        self.assertEqual(hash64, (1 << 64) - 1)
+
+    def test_large_source_hash(self):
+        hash64, luma, width, height = _jpegscan.analyze(LARGE_FIXTURE.read_bytes())
+        self.assertEqual((width, height), (4800, 4800))
+        self.assertAlmostEqual(luma, 128.0, delta=2.0)
+        self.assertEqual(hash64, (1 << 64) - 1)
+
+    def test_stable_across_calls(self):
+        self.assertEqual(_jpegscan.analyze(self.raw), _jpegscan.analyze(bytearray(self.raw)))
+
+    def test_truncated_frame_fails(self):
+        for size in (len(self.raw) // 2, len(self.raw) - 2):
+            with self.subTest(size=size):
+                with self.assertRaisesRegex(ValueError, "Premature end"):
+                    _jpegscan.analyze(self.raw[:size])
+
+    def test_not_a_jpeg_fails(self):
+        with self.assertRaises(ValueError):
+            _jpegscan.analyze(b"\x00" * 64)
+        with self.assertRaises(ValueError):
+            _jpegscan.analyze(b"")
+
+
+if __name__ == "__main__":
+    unittest.main()
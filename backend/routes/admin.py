@@ -1,20 +1,39 @@
-from fastapi import APIRouter, HTTPException
-from fastapi.responses import JSONResponse
-import requests
-from urllib.parse import urlparse, urlunparse
+from fastapi import APIRouter, HTTPException, Request
+from fastapi.concurrency import run_in_threadpool
+from fastapi.responses import JSONResponse, StreamingResponse
+import asyncio
+import base64
+import binascii
+import json
 from pydantic import BaseModel, Field
 
-from ..core.db import list_devices, get_device, update_config
+from ..core import firmware
+from ..core.ai_health import ai_health
+from ..core.auth import require_bearer
+from ..core.events import events
+from ..core.inference import inference
+from ..core.previews import preview_url
+from ..core.scene import normalize_profile, parse_scene_profiles
+from ..core.schedule import TZ_PATTERN, normalize_schedule, parse_schedule
+from ..core.segments import frame_url
+from ..core.db import list_devices, get_device, update_config, list_telemetry, list_frames
 from ..core.config import (
+    ADMIN_TOKEN,
     DEFAULT_AI_HOST,
     DEFAULT_AI_MODEL,
     DEFAULT_AI_PROMPT,
     DEFAULT_AI_NUM_CTX,
     DEFAULT_AI_NUM_PREDICT,
+    DEFAULT_TZ,
+    EVENTS_PING_SEC,
 )
 
 router = APIRouter(prefix="/admin/api", tags=["admin"])
 
+FRAMESIZES = ("QQVGA", "QVGA", "CIF", "VGA", "SVGA", "XGA", "SXGA", "UXGA")
+# ESP32-CAM'de bos kalan pinler (SD kart hatlari); GPIO2/12/15 acilis strap'i oldugu icin yok
+TRIGGER_GPIOS = (-1, 13, 14)
+
 
 def _row_value(row, key, default=None):
     try:
@@ -59,42 +78,7 @@ def _bool_or_default(value, default):
 
 
 
-def _build_ai_health_url(host: str) -> str | None:
-    if not host:
-        return None
-    host = host.strip()
-    if not host:
-        return None
-    if not host.startswith('http://') and not host.startswith('https://'):
-        host = 'http://' + host
-    parsed = urlparse(host)
-    if not parsed.netloc:
-        return None
-    path = (parsed.path or '').rstrip('/')
-    if path.endswith('/api'):
-        health_path = f'{path}/tags'
-    elif path.endswith('/api/generate'):
-        health_path = path[: -len('/generate')] + '/tags'
-    elif '/api/generate' in path:
-        base = path.split('/api/generate')[0] + '/api'
-        health_path = base + '/tags'
-    else:
-        health_path = f'{path}/api/tags' if path else '/api/tags'
-    parsed = parsed._replace(path=health_path, params='', query='', fragment='')
-    return urlunparse(parsed)
-
-def _check_ai_status(host: str) -> bool:
-    url = _build_ai_health_url(host)
-    if not url:
-        return False
-    try:
-        resp = requests.get(url, timeout=2)
-    except Exception:
-        return False
-    return resp.ok
 def _device_row(row, include_ai_status: bool = False):
-    stored_urls = _row_value(row, "last_img_urls")
-    urls = [u for u in str(stored_urls).split("\n") if u] if stored_urls else []
     row_int = lambda key, default: _int_or_default(_row_value(row, key), default)
     row_bool = lambda key, default: _bool_or_default(_row_value(row, key), default)
 
@@ -139,10 +123,14 @@ def _device_row(row, include_ai_status: bool = False):
     return {
         "deviceId": row["device_id"],
         "fw": row["fw"],
+        "fwTarget": _row_value(row, "fw_target") or "",
+        "fwRejected": _row_value(row, "fw_rejected") or "",
         "ip": row["ip"],
         "rssi": row["rssi"],
         "model": row["model"],
         "lastSeen": row["last_seen"],
+        "configRev": row_int("config_rev", 1),
+        "configSeenRev": row_int("config_seen_rev", 0),
 
         "framesize": row["framesize"],
         "jpegQuality": row_int("jpeg_quality", 15),
@@ -151,7 +139,6 @@ def _device_row(row, include_ai_status: bool = False):
         "uploadUrl": row["upload_url"],
         "lastImgUrl": row["last_img_url"],
         "lastImgTime": row["last_img_time"],
-        "lastImgUrls": urls,
         "lastAnalysis": _row_value(row, "last_analysis"),
         "lastAnalysisTime": _row_value(row, "last_analysis_time"),
         "aiHost": ai_host,
@@ -180,14 +167,37 @@ def _device_row(row, include_ai_status: bool = False):
         "colorbar": colorbar,
         "specialEffect": special_effect,
         "lowLightBoost": low_light,
-        "aiReachable": _check_ai_status(ai_host) if include_ai_status else None,
+        "sceneProfiles": parse_scene_profiles(_row_value(row, "scene_profiles")),
+        "roi": _roi(row),
+        "archiveFramesize": _row_value(row, "archive_framesize") or "OFF",
+        "archiveQuality": max(5, min(63, _int_or_default(_row_value(row, "archive_quality"), 10))),
+        "archiveIntervalSec": max(0, _int_or_default(_row_value(row, "archive_interval_sec"), 300)),
+        "triggerGpio": _int_or_default(_row_value(row, "trigger_gpio"), -1),
+        "triggerActiveHigh": _bool_or_default(_row_value(row, "trigger_active_high"), True),
+        "triggerCooldownMs": _int_or_default(_row_value(row, "trigger_cooldown_ms"), 2000),
+        "triggerLightSleep": _bool_or_default(_row_value(row, "trigger_light_sleep"), False),
+        "schedule": parse_schedule(_row_value(row, "schedule")),
+        "tz": _str_or_default(_row_value(row, "tz"), DEFAULT_TZ),
+        "aiReachable": ai_health.is_reachable(ai_host) if include_ai_status else None,
+    }
+
+
+def _roi(row):
+    row_int = lambda key, default: _int_or_default(_row_value(row, key), default)
+    return {
+        "x": max(0, min(1000, row_int("roi_x", 0))),
+        "y": max(0, min(1000, row_int("roi_y", 0))),
+        "w": max(50, min(1000, row_int("roi_w", 1000))),
+        "h": max(50, min(1000, row_int("roi_h", 1000))),
+        "zoom": _bool_or_default(_row_value(row, "roi_zoom"), False),
     }
 
 
 @router.get("/devices")
 def devices():
     rows = list_devices()
-    return JSONResponse([_device_row(r) for r in rows])
+    # Saglik durumu arka planda onbellekleniyor; her satir icin okumak ucuz.
+    return JSONResponse([_device_row(r, include_ai_status=True) for r in rows])
 
 
 @router.get("/device/{device_id}")
@@ -197,7 +207,231 @@ def device(device_id: str):
         raise HTTPException(status_code=404, detail="Device not found")
     return _device_row(row, include_ai_status=True)
 
+@router.get("/events")
+async def device_events(req: Request):
+    """Panelin canli akisi: cihaz basina kismi guncellemeler (SSE)."""
+    sub, backlog = events.subscribe(req.headers.get("last-event-id"))
+
+    async def stream():
+        try:
+            # Kopan baglanti 3 sn sonra ayni Last-Event-ID ile geri gelir
+            yield "retry: 3000\n\n"
+            for message in backlog:
+                yield message
+            while not await req.is_disconnected():
+                try:
+                    yield await asyncio.wait_for(sub.queue.get(), timeout=EVENTS_PING_SEC)
+                except asyncio.TimeoutError:
+                    # Proxy'ler bos baglantiyi kapatmasin
+                    yield ": ping\n\n"
+        finally:
+            events.unsubscribe(sub)
+
+    return StreamingResponse(
+        stream(),
+        media_type="text/event-stream",
+        headers={"Cache-Control": "no-cache", "X-Accel-Buffering": "no"},
+    )
+
+
+@router.get("/firmware")
+def firmware_images():
+    return {"images": firmware.list_images()}
+
+
+@router.put("/firmware/{version}")
+async def upload_firmware(version: str, req: Request):
+    """Ham .bin govdesi (Arduino 'Export compiled binary' ciktisi).
+
+    X-Fw-Signature: `openssl dgst -sha256 -sign` ciktisinin base64 hali.
+    """
+    require_bearer(req, ADMIN_TOKEN)
+    if not firmware.valid_version(version):
+        raise HTTPException(status_code=400, detail="Invalid version")
+    try:
+        signature = base64.b64decode(req.headers.get("x-fw-signature", ""), validate=True)
+    except binascii.Error:
+        raise HTTPException(status_code=400, detail="Invalid signature encoding")
+    data = await req.body()
+    try:
+        return await run_in_threadpool(firmware.save_image, version, data, signature)
+    except ValueError as exc:
+        raise HTTPException(status_code=400, detail=str(exc))
+
+
+@router.delete("/firmware/{version}")
+def delete_firmware(version: str, req: Request):
+    require_bearer(req, ADMIN_TOKEN)
+    if not firmware.valid_version(version) or not firmware.delete_image(version):
+        raise HTTPException(status_code=404, detail="Firmware not found")
+    return {"status": "ok"}
+
+
+@router.get("/inference")
+def inference_stats():
+    return {"hosts": inference.stats()}
+
+
+def _frame_row(row):
+    url = row["url"]
+    thumb = preview_url(url, "thumb")
+    if row["seg"] and row["thumb_offset"] is not None:
+        # Kucuk resim ingest sirasinda ayni segmente yazildi
+        thumb = frame_url(row["device_id"], row["seg"], row["thumb_offset"])
+    return {
+        "id": row["id"],
+        "ts": row["ts"],
+        "url": url,
+        "thumb": thumb,
+        "medium": preview_url(url, "medium"),
+        "size": row["size"],
+        "framesize": row["framesize"],
+        "quality": row["quality"],
+        "luma": row["luma"],
+        "change": row["change_score"],
+        "roi": [int(v) for v in row["roi"].split(",")] if row["roi"] else None,
+        "stream": row["stream"] or "analysis",
+        "trigger": row["trigger"],
+        "triggerMs": row["trigger_ms"],
+        "analysis": row["analysis"],
+        "analysisTime": row["analysis_time"],
+    }
+
+
+def _parse_cursor(value: str | None):
+    # "ts:id" -> (ts, id); bir onceki sayfanin son karesi
+    if not value:
+        return None
+    try:
+        ts, frame_id = value.split(":", 1)
+        return int(ts), int(frame_id)
+    except ValueError:
+        raise HTTPException(status_code=400, detail="Invalid cursor")
+
+
+@router.get("/device/{device_id}/frames")
+def device_frames(
+    device_id: str,
+    start: int | None = None,
+    end: int | None = None,
+    before: str | None = None,
+    limit: int = 20,
+    stream: str | None = None,
+):
+    if not get_device(device_id):
+        raise HTTPException(status_code=404, detail="Device not found")
+    limit = max(1, min(200, int(limit)))
+    if stream not in (None, "", "analysis", "archive"):
+        raise HTTPException(status_code=400, detail="Invalid stream")
+
+    rows = list_frames(
+        device_id, start=start, end=end, before=_parse_cursor(before), limit=limit + 1, stream=stream or None
+    )
+    has_more = len(rows) > limit
+    rows = rows[:limit]
+    next_cursor = f"{rows[-1]['ts']}:{rows[-1]['id']}" if has_more and rows else None
+    return {
+        "deviceId": device_id,
+        "frames": [_frame_row(r) for r in rows],
+        "next": next_cursor,
+    }
+
+
+def _bucket_upper_us(index: int) -> int:
+    # Firmware: bucket 0 = 0us, bucket i = [2^(i-1), 2^i) us
+    return 0 if index <= 0 else (1 << index)
+
+
+def _percentile_us(buckets, total: int, q: float):
+    if total <= 0:
+        return None
+    rank = q * total
+    seen = 0
+    for idx, count in enumerate(buckets):
+        seen += count
+        if seen >= rank:
+            return _bucket_upper_us(idx)
+    return _bucket_upper_us(len(buckets) - 1)
+
+
+@router.get("/device/{device_id}/telemetry")
+def device_telemetry(device_id: str, limit: int = 60):
+    if not get_device(device_id):
+        raise HTTPException(status_code=404, detail="Device not found")
+    limit = max(1, min(1440, int(limit)))
+
+    samples = []
+    stages = {}
+    counters = {}
+    scene = None
+    for row in reversed(list_telemetry(device_id, limit)):
+        try:
+            payload = json.loads(row["payload"])
+        except (TypeError, ValueError):
+            continue
+        sample_counters = payload.get("counters") or {}
+        samples.append({
+            "ts": row["ts"],
+            "windowMs": payload.get("windowMs"),
+            "uptimeMs": payload.get("uptimeMs"),
+            "heap": payload.get("heap") or {},
+            "counters": sample_counters,
+        })
+        for name, value in sample_counters.items():
+            counters[name] = counters.get(name, 0) + _int_or_default(value, 0)
+        sample_scene = payload.get("scene")
+        if isinstance(sample_scene, dict):
+            if scene is None:
+                scene = {"mode": None, "transitions": 0, "ms": {}}
+            # Satirlar eskiden yeniye; son gorulen mod guncel moddur
+            scene["mode"] = sample_scene.get("mode")
+            scene["transitions"] += _int_or_default(sample_scene.get("transitions"), 0)
+            for mode, ms in (sample_scene.get("ms") or {}).items():
+                scene["ms"][mode] = scene["ms"].get(mode, 0) + _int_or_default(ms, 0)
+        for name, hist in (payload.get("stages") or {}).items():
+            agg = stages.setdefault(name, {"n": 0, "sumUs": 0, "maxUs": 0, "buckets": []})
+            agg["n"] += _int_or_default(hist.get("n"), 0)
+            agg["sumUs"] += _int_or_default(hist.get("sumUs"), 0)
+            agg["maxUs"] = max(agg["maxUs"], _int_or_default(hist.get("maxUs"), 0))
+            buckets = hist.get("b") or []
+            if len(agg["buckets"]) < len(buckets):
+                agg["buckets"].extend([0] * (len(buckets) - len(agg["buckets"])))
+            for idx, count in enumerate(buckets):
+                agg["buckets"][idx] += _int_or_default(count, 0)
+
+    summary = {}
+    for name, agg in stages.items():
+        total = agg["n"]
+        summary[name] = {
+            "n": total,
+            "meanUs": (agg["sumUs"] // total) if total else None,
+            "maxUs": agg["maxUs"],
+            "p50Us": _percentile_us(agg["buckets"], total, 0.50),
+            "p95Us": _percentile_us(agg["buckets"], total, 0.95),
+            "p99Us": _percentile_us(agg["buckets"], total, 0.99),
+            "buckets": agg["buckets"],
+        }
+
+    return {
+        "deviceId": device_id,
+        "samples": samples,
+        "stages": summary,
+        "counters": counters,
+        "scene": scene,
+    }
+
+
+class RoiBody(BaseModel):
+    # Tam goruntunun binde biri; her kenar en az %5
+    x: int = Field(0, ge=0, le=950)
+    y: int = Field(0, ge=0, le=950)
+    w: int = Field(1000, ge=50, le=1000)
+    h: int = Field(1000, ge=50, le=1000)
+    zoom: bool = False
+
+
 class UpdateConfigBody(BaseModel):
+    fwTarget: str | None = Field(None, description="OTA hedef surumu; bos = guncelleme yok")
     framesize: str | None = Field(None, description="QQVGA,QVGA,CIF,VGA,SVGA,XGA,SXGA,UXGA")
     jpegQuality: int | None = Field(None, ge=5, le=63)
     uploadIntervalSec: int | None = Field(None, ge=1, le=3600)
@@ -225,6 +459,17 @@ class UpdateConfigBody(BaseModel):
     colorbar: bool | None = None
     specialEffect: int | None = Field(None, ge=0, le=6)
     lowLightBoost: bool | None = None
+    sceneProfiles: list[dict] | None = None
+    roi: RoiBody | None = None
+    archiveFramesize: str | None = Field(None, description="OFF veya framesize anahtari")
+    archiveQuality: int | None = Field(None, ge=5, le=63)
+    archiveIntervalSec: int | None = Field(None, ge=0, le=86400)
+    triggerGpio: int | None = Field(None, ge=-1, le=39)
+    triggerActiveHigh: bool | None = None
+    triggerCooldownMs: int | None = Field(None, ge=0, le=600000)
+    triggerLightSleep: bool | None = None
+    schedule: list[dict] | None = None
+    tz: str | None = None
     aiHost: str | None = None
     aiModel: str | None = None
     aiPrompt: str | None = None
@@ -239,6 +484,11 @@ def update_device_config(device_id: str, body: UpdateConfigBody):
         raise HTTPException(status_code=404, detail="Device not found")
 
     patch = {}
+    if body.fwTarget is not None:
+        target = body.fwTarget.strip()
+        if target and not firmware.has_image(target):
+            raise HTTPException(status_code=400, detail="Unknown or unsigned firmware version")
+        patch["fw_target"] = target or None
     if body.framesize:
         patch["framesize"] = body.framesize
     if body.jpegQuality is not None:
@@ -293,6 +543,54 @@ def update_device_config(device_id: str, body: UpdateConfigBody):
         patch["special_effect"] = max(0, min(6, int(body.specialEffect)))
     if body.lowLightBoost is not None:
         patch["low_light_boost"] = 1 if body.lowLightBoost else 0
+    if body.sceneProfiles is not None:
+        try:
+            profiles = [normalize_profile(p) for p in body.sceneProfiles]
+        except (TypeError, ValueError, AttributeError) as exc:
+            raise HTTPException(status_code=400, detail=f"Invalid sceneProfiles: {exc}")
+        if len({p["mode"] for p in profiles}) != len(profiles):
+            raise HTTPException(status_code=400, detail="Invalid sceneProfiles: duplicate mode")
+        patch["scene_profiles"] = json.dumps(profiles)
+    if body.archiveFramesize is not None:
+        key = body.archiveFramesize.strip().upper()
+        if key != "OFF" and key not in FRAMESIZES:
+            raise HTTPException(status_code=400, detail="Invalid archiveFramesize")
+        patch["archive_framesize"] = key
+    if body.archiveQuality is not None:
+        patch["archive_quality"] = int(body.archiveQuality)
+    if body.archiveIntervalSec is not None:
+        patch["archive_interval_sec"] = int(body.archiveIntervalSec)
+    if body.triggerGpio is not None:
+        if body.triggerGpio not in TRIGGER_GPIOS:
+            raise HTTPException(status_code=400, detail=f"Invalid triggerGpio (allowed: {TRIGGER_GPIOS})")
+        patch["trigger_gpio"] = int(body.triggerGpio)
+    if body.triggerActiveHigh is not None:
+        patch["trigger_active_high"] = 1 if body.triggerActiveHigh else 0
+    if body.triggerCooldownMs is not None:
+        patch["trigger_cooldown_ms"] = int(body.triggerCooldownMs)
+    if body.triggerLightSleep is not None:
+        patch["trigger_light_sleep"] = 1 if body.triggerLightSleep else 0
+    if body.schedule is not None:
+        try:
+            patch["schedule"] = json.dumps(normalize_schedule(body.schedule))
+        except (TypeError, ValueError, AttributeError) as exc:
+            raise HTTPException(status_code=400, detail=f"Invalid schedule: {exc}")
+    if body.tz is not None:
+        tz = body.tz.strip()
+        if tz and not TZ_PATTERN.match(tz):
+            raise HTTPException(status_code=400, detail="Invalid tz (POSIX TZ, e.g. <+03>-3)")
+        patch["tz"] = tz or None
+    if body.roi is not None:
+        roi = body.roi
+        if roi.x + roi.w > 1000 or roi.y + roi.h > 1000:
+            raise HTTPException(status_code=400, detail="Invalid roi: window exceeds frame")
+        patch.update({
+            "roi_x": roi.x,
+            "roi_y": roi.y,
+            "roi_w": roi.w,
+            "roi_h": roi.h,
+            "roi_zoom": 1 if roi.zoom else 0,
+        })
     if body.aiHost is not None:
         patch["ai_host"] = body.aiHost
     if body.aiModel is not None:
@@ -305,7 +603,10 @@ def update_device_config(device_id: str, body: UpdateConfigBody):
         patch["ai_num_predict"] = int(body.aiNumPredict)
 
     if patch:
+        # Cihaz bir sonraki yoklamada bu revizyonu alinca panel "uygulandi" gosterir
+        patch["config_rev"] = _int_or_default(_row_value(row, "config_rev"), 1) + 1
         update_config(device_id, patch)
+        events.publish("device", _device_row(get_device(device_id), include_ai_status=True))
     return {"status": "ok"}
 
 
@@ -1,20 +1,32 @@
-from fastapi import APIRouter, Request
-from fastapi.responses import JSONResponse
+from fastapi import APIRouter, HTTPException, Request
+from fastapi.concurrency import run_in_threadpool
+from fastapi.responses import FileResponse, JSONResponse
 from pydantic import BaseModel
+import json
 import time
-import requests
-from urllib.parse import urlparse, urlunparse
 
 from ..core.config import (
     BACKEND_TOKEN,
+    CONFIG_POLL_SEC,
     DEFAULT_AI_HOST,
     DEFAULT_AI_MODEL,
     DEFAULT_AI_PROMPT,
     DEFAULT_AI_NUM_CTX,
     DEFAULT_AI_NUM_PREDICT,
+    DEFAULT_TZ,
+    NTP_SERVER,
+    SCHEDULE_JITTER_MS,
+    TELEMETRY_INTERVAL_SEC,
+    TELEMETRY_RETENTION_SEC,
     UPLOAD_TOKEN,
 )
-from ..core.db import upsert_device, get_device, update_config
+from ..core import firmware
+from ..core.ai_health import ai_health
+from ..core.db import upsert_device, get_device, update_config, insert_telemetry, device_slot
+from ..core.events import events
+from ..core.metrics import CONFIG_STAGE
+from ..core.scene import parse_scene_profiles, scene_spec
+from ..core.schedule import parse_schedule, schedule_spec
 from ..core.auth import require_bearer
 
 
@@ -65,39 +77,14 @@ def _bool_or_default(value, default):
         return default
 
 
-def _build_ai_health_url(host: str) -> str | None:
-    if not host:
-        return None
-    host = host.strip()
-    if not host:
-        return None
-    if not host.startswith('http://') and not host.startswith('https://'):
-        host = 'http://' + host
-    parsed = urlparse(host)
-    if not parsed.netloc:
-        return None
-    path = (parsed.path or '').rstrip('/')
-    if path.endswith('/api'):
-        health_path = f'{path}/tags'
-    elif path.endswith('/api/generate'):
-        health_path = path[: -len('/generate')] + '/tags'
-    elif '/api/generate' in path:
-        base = path.split('/api/generate')[0] + '/api'
-        health_path = base + '/tags'
-    else:
-        health_path = f'{path}/api/tags' if path else '/api/tags'
-    parsed = parsed._replace(path=health_path, params='', query='', fragment='')
-    return urlunparse(parsed)
-
-def _check_ai_status(host: str) -> bool:
-    url = _build_ai_health_url(host)
-    if not url:
-        return False
-    try:
-        resp = requests.get(url, timeout=2)
-    except Exception:
-        return False
-    return resp.ok
+
+def _phase_offsets(device_id: str, interval_sec: int) -> tuple[int, int]:
+    """Cihazlari upload ve config periyotlari boyunca esit aralikla dagit."""
+    index, total = device_slot(device_id)
+    upload_phase = (index * interval_sec * 1000) // total
+    poll_phase = (index * max(1, CONFIG_POLL_SEC) * 1000) // total
+    return upload_phase, poll_phase
+
 
 router = APIRouter(prefix="/api", tags=["device"])
 
@@ -132,13 +119,21 @@ async def register(req: Request, body: RegisterBody):
         "upload_token": "",
     }
     upsert_device(info)
+    events.device(
+        device_id, fw=info["fw"], ip=info["ip"], rssi=info["rssi"], model=info["model"], lastSeen=info["last_seen"]
+    )
     # İsteğe bağlı: burada body.uniqueId ve diğer tanıtıcılar loglanabilir
     return JSONResponse({"status":"ok"})
 
 @router.get("/config")
-@router.get("/config")
-async def get_config(req: Request, deviceId: str):
-    row = get_device(deviceId)
+async def get_config(req: Request, deviceId: str, fw: str | None = None, fwRejected: str | None = None):
+    with CONFIG_STAGE.time(stage="total"):
+        return _config_response(req, deviceId, fw, fwRejected)
+
+
+def _config_response(req: Request, deviceId: str, fw: str | None, fwRejected: str | None) -> JSONResponse:
+    with CONFIG_STAGE.time(stage="get_device"):
+        row = get_device(deviceId)
     base_url = str(req.base_url).rstrip("/")
 
     if not row:
@@ -173,14 +168,31 @@ async def get_config(req: Request, deviceId: str):
     ai_num_ctx = _clean_int(row["ai_num_ctx"], DEFAULT_AI_NUM_CTX)
     ai_num_predict = _clean_int(row["ai_num_predict"], DEFAULT_AI_NUM_PREDICT)
 
-    update_config(
-        deviceId,
-        {
-            "last_seen": int(time.time()),
-            "upload_url": upload_url,
-            "upload_token": upload_token,
-        },
-    )
+    seen = {
+        "last_seen": int(time.time()),
+        "upload_url": upload_url,
+        "upload_token": upload_token,
+    }
+    # Cihaz calisan surumunu her yoklamada bildirir; OTA sonrasi boylece guncellenir
+    if fw and firmware.valid_version(fw):
+        seen["fw"] = fw
+    if fwRejected is not None:
+        seen["fw_rejected"] = fwRejected if firmware.valid_version(fwRejected) else None
+    seen["config_seen_rev"] = _row_value(row, "config_rev") or 1
+    with CONFIG_STAGE.time(stage="update_config"):
+        update_config(deviceId, seen)
+    # Panele yalnizca degisen alanlar; degisiklik yoksa seyrek bir lastSeen
+    changed = {}
+    if seen.get("fw", row["fw"]) != row["fw"]:
+        changed["fw"] = seen["fw"]
+    if "fw_rejected" in seen and seen["fw_rejected"] != _row_value(row, "fw_rejected"):
+        changed["fwRejected"] = seen["fw_rejected"] or ""
+    if seen["config_seen_rev"] != _row_value(row, "config_seen_rev"):
+        changed["configSeenRev"] = seen["config_seen_rev"]
+    events.seen(deviceId, seen["last_seen"], **changed)
+    fw_target = _row_value(row, "fw_target")
+    if not firmware.has_image(fw_target) or fw_target == (fw or row["fw"]):
+        fw_target = ""
 
     row_int = lambda key, default: _int_or_default(_row_value(row, key), default)
     row_bool = lambda key, default: _bool_or_default(_row_value(row, key), default)
@@ -206,16 +218,24 @@ async def get_config(req: Request, deviceId: str):
     colorbar = row_bool("colorbar", False)
     special_effect = _clamp(row_int("special_effect", 0), 0, 6)
     low_light = row_bool("low_light_boost", True)
+    scene = scene_spec(parse_scene_profiles(_row_value(row, "scene_profiles")))
+    roi_w = _clamp(row_int("roi_w", 1000), 50, 1000)
+    roi_h = _clamp(row_int("roi_h", 1000), 50, 1000)
+    roi_x = _clamp(row_int("roi_x", 0), 0, 1000 - roi_w)
+    roi_y = _clamp(row_int("roi_y", 0), 0, 1000 - roi_h)
     whitebal_val = row_bool("whitebal", True)
     wb_mode_val = _clamp(row_int("wb_mode", 0), 0, 4)
     hmirror_val = row_bool("hmirror", False)
     vflip_val = row_bool("vflip", False)
     auto_upload = row_bool("auto_upload", True)
+    interval_sec = _clamp(row_int("upload_interval_sec", 10), 1, 3600)
+    with CONFIG_STAGE.time(stage="device_slot"):
+        upload_phase_ms, poll_phase_ms = _phase_offsets(deviceId, interval_sec)
 
     data = {
         "framesize": row["framesize"] or "VGA",
         "jpegQuality": row_int("jpeg_quality", 15),
-        "uploadIntervalSec": row_int("upload_interval_sec", 10),
+        "uploadIntervalSec": interval_sec,
         "uploadUrl": upload_url,
         "uploadToken": upload_token,
         "autoUpload": auto_upload,
@@ -240,16 +260,90 @@ async def get_config(req: Request, deviceId: str):
         "colorbar": colorbar,
         "specialEffect": special_effect,
         "lowLightBoost": low_light,
+        "sceneProfiles": scene,
+        "roiX": roi_x,
+        "roiY": roi_y,
+        "roiW": roi_w,
+        "roiH": roi_h,
+        "roiZoom": row_bool("roi_zoom", False),
+        "archiveFramesize": _row_value(row, "archive_framesize") or "OFF",
+        "archiveQuality": _clamp(row_int("archive_quality", 10), 5, 63),
+        "archiveIntervalSec": _clamp(row_int("archive_interval_sec", 300), 0, 86400),
+        "triggerGpio": row_int("trigger_gpio", -1),
+        "triggerActiveHigh": row_bool("trigger_active_high", True),
+        "triggerCooldownMs": _clamp(row_int("trigger_cooldown_ms", 2000), 0, 600000),
+        "triggerLightSleep": row_bool("trigger_light_sleep", False),
+        "fwTarget": fw_target,
+        # Takvim pencereleri cihazin yerel saatine gore; saat SNTP ile, o gelene kadar serverTimeMs ile
+        "schedule": schedule_spec(parse_schedule(_row_value(row, "schedule"))),
+        "tz": _clean_str(_row_value(row, "tz"), DEFAULT_TZ),
+        "ntpServer": NTP_SERVER,
         "aiHost": ai_host,
         "aiModel": ai_model,
         "aiPrompt": ai_prompt,
         "aiNumCtx": ai_num_ctx,
         "aiNumPredict": ai_num_predict,
-        "aiReachable": _check_ai_status(ai_host),
+        "aiReachable": ai_health.is_reachable(ai_host),
+        "telemetryIntervalSec": max(0, TELEMETRY_INTERVAL_SEC),
+        "pollIntervalSec": max(1, CONFIG_POLL_SEC),
+        "uploadPhaseMs": upload_phase_ms,
+        "pollPhaseMs": poll_phase_ms,
+        "scheduleJitterMs": max(0, SCHEDULE_JITTER_MS),
+        "serverTimeMs": int(time.time() * 1000),
     }
     return JSONResponse(data)
 
 
+@router.get("/firmware")
+async def get_firmware(req: Request, deviceId: str, to: str, full: int = 0):
+    """OTA govdesi: from= surumune karsi zlib'li delta, yoksa zlib'li tam imaj."""
+    require_bearer(req, BACKEND_TOKEN)
+    if not get_device(deviceId):
+        raise HTTPException(status_code=404, detail="unknown device")
+    if not firmware.has_image(to):
+        raise HTTPException(status_code=404, detail="unknown firmware version")
+    # "from" Python'da anahtar kelime; sorgudan dogrudan okunur
+    from_version = req.query_params.get("from")
+    # Delta uretimi saniyeler surebilir; sonuc diskte onbelleklenir
+    pkg = await run_in_threadpool(firmware.package, from_version, to, bool(full))
+    print(f"[OTA] dev={deviceId} {from_version or '?'} -> {to} {pkg.kind} {pkg.path.stat().st_size}/{pkg.image_size}")
+    return FileResponse(
+        pkg.path,
+        media_type="application/octet-stream",
+        headers={
+            "X-Fw-Format": pkg.kind,
+            "X-Fw-Version": to,
+            "X-Fw-Size": str(pkg.image_size),
+            "X-Fw-Sha256": pkg.image_sha256,
+            "X-Fw-Signature": firmware.image_signature(to),
+        },
+    )
+
+
+@router.post("/telemetry")
+async def telemetry(req: Request):
+    require_bearer(req, BACKEND_TOKEN)
+    try:
+        body = await req.json()
+    except ValueError:
+        return JSONResponse({"status": "error", "detail": "invalid JSON"}, status_code=400)
+    if not isinstance(body, dict):
+        return JSONResponse({"status": "error", "detail": "expected object"}, status_code=400)
+
+    device_id = str(body.get("deviceId") or "").strip()
+    if not device_id or not get_device(device_id):
+        return JSONResponse({"status": "error", "detail": "unknown device"}, status_code=404)
+
+    insert_telemetry(
+        device_id,
+        int(time.time()),
+        json.dumps(body, separators=(",", ":")),
+        TELEMETRY_RETENTION_SEC,
+    )
+    events.publish("telemetry", {"deviceId": device_id})
+    return JSONResponse({"status": "ok"})
+
+
 
 
 
@@ -0,0 +1,70 @@
+from fastapi import APIRouter, HTTPException, Request
+from fastapi.responses import FileResponse, Response
+from starlette.concurrency import run_in_threadpool
+
+from ..core.previews import PREVIEW_SIZES, ensure_preview, render_variant, source_path, within_upload_dir
+from ..core.segments import segment_store
+
+router = APIRouter(tags=["media"])
+
+# Dosya adlari her kare icin tekil; icerik degismez.
+IMMUTABLE = "public, max-age=31536000, immutable"
+
+
+@router.get("/previews/{device_id}/{variant}/{fname}")
+async def preview(req: Request, device_id: str, variant: str, fname: str):
+    if variant not in PREVIEW_SIZES:
+        raise HTTPException(status_code=404, detail="Unknown preview size")
+    try:
+        src = source_path(device_id, fname)
+    except ValueError:
+        # "." / ".." (ya da %2E%2E) upload dizininin disina cikar
+        raise HTTPException(status_code=404, detail="Frame not found")
+
+    path = await run_in_threadpool(ensure_preview, device_id, fname, variant)
+    if path is None:
+        # Pillow yok ya da decode edilemedi: orijinali ayni cache kurallariyla ver.
+        path = src
+        if not path.is_file():
+            raise HTTPException(status_code=404, detail="Frame not found")
+    if not within_upload_dir(path):
+        raise HTTPException(status_code=404, detail="Frame not found")
+
+    st = path.stat()
+    etag = f'"{variant}-{st.st_mtime_ns:x}-{st.st_size:x}"'
+    headers = {"ETag": etag, "Cache-Control": IMMUTABLE}
+    if req.headers.get("if-none-match") == etag:
+        return Response(status_code=304, headers=headers)
+    return FileResponse(path, media_type="image/jpeg", headers=headers)
+
+
+def _read_frame(device_id: str, seg: str, offset: int, variant: str | None) -> bytes | None:
+    try:
+        raw = segment_store.read(device_id, seg, offset)
+    except ValueError:
+        return None
+    if raw is None or variant is None:
+        return raw
+    # Kucuk varyantlar istek aninda uretilir; tarayici immutable cache'ler.
+    return render_variant(raw, variant) or raw
+
+
+@router.get("/frames/{device_id}/{seg}/{name}")
+async def frame(req: Request, device_id: str, seg: str, name: str, variant: str | None = None):
+    if variant is not None and variant not in PREVIEW_SIZES:
+        raise HTTPException(status_code=404, detail="Unknown preview size")
+    stem = name[:-4] if name.endswith(".jpg") else name
+    if not stem.isdigit():
+        raise HTTPException(status_code=404, detail="Frame not found")
+    offset = int(stem)
+
+    etag = f'"{seg}-{offset:x}-{variant or "full"}"'
+    headers = {"ETag": etag, "Cache-Control": IMMUTABLE}
+    if req.headers.get("if-none-match") == etag:
+        return Response(status_code=304, headers=headers)
+
+    # ASGI uzerinden sendfile yok; kayit tek bir pread ile okunur.
+    data = await run_in_threadpool(_read_frame, device_id, seg, offset, variant)
+    if data is None:
+        raise HTTPException(status_code=404, detail="Frame not found")
+    return Response(content=data, media_type="image/jpeg", headers=headers)
@@ -0,0 +1,31 @@
+from fastapi import APIRouter
+from fastapi.responses import PlainTextResponse
+
+from ..core.events import events
+from ..core.inference import inference
+from ..core.metrics import registry
+from .upload import admission
+
+router = APIRouter(tags=["metrics"])
+
+
+def _per_host(field: str):
+    # Kuyruk durumu zaten inference.stats() icinde; kazima aninda okunur
+    return lambda: [((host["endpoint"],), host[field]) for host in inference.stats()]
+
+
+registry.gauge("homedog_upload_inflight", "Uploads currently being processed", fn=lambda: admission.inflight)
+registry.counter("homedog_upload_admission_rejected_total", "Uploads turned away by admission control",
+                 fn=lambda: admission.rejected)
+registry.gauge("homedog_admin_event_streams", "Connected admin dashboard event streams",
+               fn=lambda: events.subscribers)
+registry.gauge("homedog_inference_queued", "Analysis jobs waiting per Ollama host", ["host"], fn=_per_host("queued"))
+registry.gauge("homedog_inference_inflight", "Analysis jobs running per Ollama host", ["host"], fn=_per_host("inflight"))
+registry.counter("homedog_inference_superseded_total", "Queued jobs replaced by a newer frame", ["host"],
+                 fn=_per_host("superseded"))
+registry.counter("homedog_inference_stale_total", "Queued jobs dropped as too old", ["host"], fn=_per_host("stale"))
+
+
+@router.get("/metrics")
+def metrics():
+    return PlainTextResponse(registry.render(), media_type="text/plain; version=0.0.4")
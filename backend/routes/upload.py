@@ -1,13 +1,15 @@
 from fastapi import APIRouter, Request, HTTPException, status
 from fastapi.responses import JSONResponse, HTMLResponse
-from typing import List, Optional
+from typing import Optional
 from pathlib import Path
-import base64
-import requests
-from urllib.parse import urlparse, urlunparse
+import time
+from starlette.concurrency import run_in_threadpool
 from starlette.requests import ClientDisconnect
 
+from ..core.admission import AdmissionController
 from ..core.config import (
+    UPLOAD_MAX_INFLIGHT,
+    UPLOAD_RETRY_AFTER_SEC,
     UPLOAD_TOKEN,
     DEFAULT_AI_HOST,
     DEFAULT_AI_MODEL,
@@ -15,11 +17,19 @@ from ..core.config import (
     DEFAULT_AI_NUM_CTX,
     DEFAULT_AI_NUM_PREDICT,
 )
-from ..core.storage import save_image
-from ..core.db import get_device, update_config
+from ..core.frame_check import FrameVerdict, frame_gate
+from ..core.inference import InferenceJob, build_generate_url, inference
+from ..core.metrics import FRAMES, INGEST_BYTES, UPLOAD_ERRORS, UPLOAD_STAGE
+from ..core.previews import render_variant
+from ..core.segments import STREAM_ANALYSIS, STREAM_ARCHIVE, frame_url, segment_store
+from ..core.storage import safe_component
+from ..core.db import get_device, update_config, insert_frame, set_frame_analysis, set_last_analysis
+from ..core.events import events
 
 router = APIRouter(tags=["upload"])
 
+admission = AdmissionController(UPLOAD_MAX_INFLIGHT, UPLOAD_RETRY_AFTER_SEC)
+
 
 def _get_bearer(req: Request) -> Optional[str]:
     auth = req.headers.get("authorization") or req.headers.get("Authorization")
@@ -91,56 +101,187 @@ async def upload_form():
     return HTMLResponse(html)
 
 
+def _reject(code: int, cause: str, detail: str) -> HTTPException:
+    UPLOAD_ERRORS.inc(code=code, cause=cause)
+    return HTTPException(status_code=code, detail=detail)
+
+
 @router.post("/upload")
 async def upload(req: Request):
     tok = _get_bearer(req)
     device_id = req.headers.get("X-Device-ID") or "UNKNOWN"
-    row = get_device(device_id)
+    with UPLOAD_STAGE.time(stage="get_device"):
+        row = get_device(device_id)
 
-    ok = tok == UPLOAD_TOKEN
-    if not ok:
-        dev_tok = row["upload_token"] if row else None
-        ok = tok is not None and dev_tok and tok == dev_tok
+    with UPLOAD_STAGE.time(stage="auth"):
+        ok = tok == UPLOAD_TOKEN
+        if not ok:
+            dev_tok = row["upload_token"] if row else None
+            ok = tok is not None and dev_tok and tok == dev_tok
 
     if not ok:
         bearer = "none" if not tok else tok[:8] + "..."
         print(f"[UPLOAD-401] from {req.client.host} dev={device_id} bearer={bearer}")
-        raise HTTPException(status_code=status.HTTP_401_UNAUTHORIZED, detail=f"Unauthorized for device {device_id}")
+        raise _reject(status.HTTP_401_UNAUTHORIZED, "unauthorized", f"Unauthorized for device {device_id}")
+
+    try:
+        safe_component(device_id)
+    except ValueError:
+        # Segment dizini cihaz kimliginden turetilir; "." / ".." disari yazar
+        raise _reject(status.HTTP_400_BAD_REQUEST, "device_id", "Invalid X-Device-ID")
 
     ctype = req.headers.get("content-type", "")
     if "image/jpeg" not in ctype:
         print(f"[UPLOAD-415] from {req.client.host} dev={device_id} ctype={ctype!r}")
-        raise HTTPException(status_code=status.HTTP_415_UNSUPPORTED_MEDIA_TYPE, detail="Expecting image/jpeg")
-
-    fname = req.headers.get("X-File-Name") or ""
+        raise _reject(status.HTTP_415_UNSUPPORTED_MEDIA_TYPE, "content_type", "Expecting image/jpeg")
+
+    rejected = admission.try_enter(device_id)
+    if rejected:
+        code, retry_after = rejected
+        UPLOAD_ERRORS.inc(code=code, cause="device_busy" if code == 429 else "overloaded")
+        print(f"[UPLOAD-{code}] from {req.client.host} dev={device_id} inflight={admission.inflight} retry_after={retry_after}")
+        return JSONResponse(
+            {"status": "busy", "retryAfter": retry_after},
+            status_code=code,
+            headers={"Retry-After": str(retry_after)},
+        )
+
+    started = time.monotonic()
     try:
-        raw = await req.body()
+        with UPLOAD_STAGE.time(stage="total"):
+            return await _handle_upload(req, row, device_id)
+    except HTTPException:
+        raise
+    except Exception:
+        UPLOAD_ERRORS.inc(code=500, cause="internal")
+        raise
+    finally:
+        admission.leave(device_id, started)
+
+
+def _parse_roi(value: str | None) -> str | None:
+    # X-ROI: "x,y,w,h", tam goruntunun binde biri cinsinden
+    if not value:
+        return None
+    try:
+        x, y, w, h = (int(part) for part in value.split(","))
+    except ValueError:
+        return None
+    if min(x, y) < 0 or w <= 0 or h <= 0 or x + w > 1000 or y + h > 1000:
+        return None
+    return f"{x},{y},{w},{h}"
+
+
+def _frame_luma(verdict: FrameVerdict) -> int | None:
+    return round(verdict.stats.luma) if verdict.stats else None
+
+
+def _store_frame(
+    device_id: str, raw: bytes, stream: str = STREAM_ANALYSIS, keep: bool = False
+) -> tuple[FrameVerdict, dict]:
+    """Kareyi (ve kucuk resmini) cihazin guncel segmentine sirali olarak ekler.
+    Onceki saklanan karenin kopyasiysa hic yazmaz; arsiv ve tetik kareleri (keep)
+    her zaman yazilir."""
+    ts = int(time.time())
+    with UPLOAD_STAGE.time(stage="frame_check"):
+        verdict = frame_gate.check(device_id, raw, ts, stream)
+    if verdict.duplicate and not keep:
+        return verdict, {"ts": ts}
+    with UPLOAD_STAGE.time(stage="thumbnail"):
+        thumb = render_variant(raw, "thumb")
+    with UPLOAD_STAGE.time(stage="segment_write"):
+        loc = segment_store.append(device_id, ts, raw, thumb, stream)
+    loc.update({
+        "device_id": device_id,
+        "ts": ts,
+        "url": frame_url(device_id, loc["seg"], loc["offset"]),
+        "size": len(raw),
+        "seg_offset": loc["offset"],
+        "luma": verdict.stats.luma if verdict.stats else None,
+        "change_score": verdict.change,
+        "stream": stream,
+    })
+    return verdict, loc
+
+
+async def _handle_upload(req: Request, row, device_id: str):
+    try:
+        with UPLOAD_STAGE.time(stage="body_read"):
+            raw = await req.body()
     except ClientDisconnect:
         print(f"[UPLOAD-DISCONNECT] from {req.client.host} dev={device_id}")
-        raise HTTPException(status_code=getattr(status, "HTTP_499_CLIENT_CLOSED_REQUEST", 400), detail="Client disconnected during upload")
+        raise _reject(getattr(status, "HTTP_499_CLIENT_CLOSED_REQUEST", 400), "disconnect", "Client disconnected during upload")
     if not raw:
         print(f"[UPLOAD-400] from {req.client.host} dev={device_id} empty body")
-        raise HTTPException(status_code=400, detail="Empty body")
+        raise _reject(400, "empty_body", "Empty body")
 
-    file_path, url_path, ts = save_image(device_id, raw, fname)
+    # Iki akis: sik, kucuk analiz kareleri ve seyrek, tam cozunurluk arsiv kareleri
+    stream = STREAM_ARCHIVE if (req.headers.get("X-Stream") or "").lower() == STREAM_ARCHIVE else STREAM_ANALYSIS
+    INGEST_BYTES.inc(len(raw), stream=stream)
+    trigger = (req.headers.get("X-Trigger") or "").strip().lower()[:16] or None
+    trigger_ms = req.headers.get("X-Trigger-Age-Ms")
 
-    image_urls = collect_last_images(device_id, url_path, row=row)
-    analysis_text = run_ollama_analysis(row, file_path, url_path)
+    # Disk ve Ollama cagrilari bloklayici; event loop'u tutmasinlar.
+    keep = stream == STREAM_ARCHIVE or trigger is not None
+    try:
+        verdict, frame = await run_in_threadpool(_store_frame, device_id, raw, stream, keep)
+    except OSError as exc:
+        # Segment yarim kayit birakmadan geri alindi; cihaz bunu sunucu hatasi olarak gorup bekler
+        print(f"[UPLOAD-507] from {req.client.host} dev={device_id} size={len(raw)}: {exc}")
+        raise _reject(status.HTTP_507_INSUFFICIENT_STORAGE, "storage", "Could not store frame")
+    if verdict.duplicate and not keep:
+        FRAMES.inc(device=device_id, result="duplicate")
+        await run_in_threadpool(_timed_update, device_id, {"last_seen": frame["ts"]})
+        events.seen(device_id, frame["ts"])
+        print(f"[UPLOAD] {req.client.host} dev={device_id} size={len(raw)} duplicate change={verdict.change:.3f}")
+        return JSONResponse({"status": "duplicate", "change": verdict.change, "luma": _frame_luma(verdict)})
+    ts, url_path = frame["ts"], frame["url"]
+
+    quality = req.headers.get("X-JPEG-Quality")
+    frame["framesize"] = req.headers.get("X-Frame-Size")
+    frame["quality"] = int(quality) if quality and quality.isdigit() else None
+    frame["roi"] = _parse_roi(req.headers.get("X-ROI"))
+    frame["trigger"] = trigger
+    frame["trigger_ms"] = int(trigger_ms) if trigger_ms and trigger_ms.isdigit() else None
+    frame["id"] = await run_in_threadpool(_timed_insert, frame)
+    FRAMES.inc(device=device_id, result=stream if not verdict.dark else "dark")
+
+    if stream == STREAM_ARCHIVE:
+        # Arsiv karesi yalnizca saklanir; canli onizleme ve analiz analiz akisindan gelir
+        await run_in_threadpool(_timed_update, device_id, {"last_seen": ts})
+        events.seen(device_id, ts)
+        print(f"[UPLOAD] {req.client.host} dev={device_id} size={len(raw)} archive seg={frame['seg']}@{frame['offset']}")
+        return JSONResponse({"status": "ok", "url": url_path, "stream": stream})
 
     patch = {
         "last_seen": ts,
         "last_img_url": url_path,
         "last_img_time": ts,
-        "last_img_urls": image_urls,
     }
-    if analysis_text is not None:
-        patch["last_analysis"] = analysis_text
-        patch["last_analysis_time"] = ts
+    await run_in_threadpool(_timed_update, device_id, patch)
+    events.device(device_id, lastSeen=ts, lastImgUrl=url_path, lastImgTime=ts)
+
+    # Analiz arka planda kuyruklanir; upload yaniti modeli beklemez.
+    # Tamamen karanlik kareyi modele gondermenin anlami yok.
+    job = None if verdict.dark else analysis_job(row, device_id, frame, raw)
+    if job is not None:
+        job.priority = trigger is not None
+        inference.submit(job)
 
-    update_config(device_id, patch)
+    event = f" trigger={trigger} age={frame['trigger_ms']}ms" if trigger else ""
+    print(f"[UPLOAD] {req.client.host} dev={device_id} size={len(raw)} seg={frame['seg']}@{frame['offset']}{event}")
+    # Firmware sahne motoru karanlik kareyi ipucu olarak kullanir
+    return JSONResponse({"status": "ok", "url": url_path, "luma": _frame_luma(verdict)})
 
-    print(f"[UPLOAD] {req.client.host} dev={device_id} size={len(raw)} saved={file_path}")
-    return JSONResponse({"status": "ok", "url": url_path})
+
+def _timed_insert(frame: dict) -> int:
+    with UPLOAD_STAGE.time(stage="insert_frame"):
+        return insert_frame(frame)
+
+
+def _timed_update(device_id: str, patch: dict):
+    with UPLOAD_STAGE.time(stage="update_config"):
+        update_config(device_id, patch)
 
 
 def _row_value(row, key, default=None):
@@ -152,107 +293,65 @@ def _row_value(row, key, default=None):
         return default
 
 
-def collect_last_images(device_id: str, new_url: str, limit: int = 20, row=None) -> str:
-    existing: List[str] = []
-    if row is None and device_id:
-        try:
-            row = get_device(device_id)
-        except Exception:
-            row = None
-    if row is not None:
-        stored = _row_value(row, "last_img_urls")
-        if stored:
-            existing = [u for u in str(stored).split("\n") if u]
-    existing.insert(0, new_url)
-    return "\n".join(existing[:limit])
-
-
-def run_ollama_analysis(row, file_path: str, url_path: str) -> Optional[str]:
+def _normalize_int(value, fallback):
+    if value is None:
+        return fallback
+    if isinstance(value, str):
+        value = value.strip()
+        if not value:
+            return fallback
+    try:
+        ivalue = int(value)
+    except (TypeError, ValueError):
+        return fallback
+    return ivalue if ivalue > 0 else fallback
+
+
+def _store_analysis(job: InferenceJob, text: str):
+    ts = int(time.time())
+    set_frame_analysis(job.frame_id, text, ts)
+    # Isciler paralel: daha yeni karenin sonucu once gelmis olabilir
+    latest = set_last_analysis(job.device_id, text, ts, int(job.captured))
+    events.publish("analysis", {
+        "deviceId": job.device_id,
+        "frameId": job.frame_id,
+        "analysis": text,
+        "analysisTime": ts,
+        "latest": latest,
+    })
+
+
+def analysis_job(row, device_id: str, frame: dict, image_bytes: bytes) -> Optional[InferenceJob]:
     host = str((_row_value(row, "ai_host") or DEFAULT_AI_HOST or "")).strip()
     model = str((_row_value(row, "ai_model") or DEFAULT_AI_MODEL or "")).strip()
     prompt_template = _row_value(row, "ai_prompt") or DEFAULT_AI_PROMPT
     if not host or not model or not prompt_template:
         return None
 
-    parsed = urlparse(host.strip())
-    path = (parsed.path or "").rstrip("/")
-
-    if path.endswith("/api/generate"):
-        final_path = path
-    elif path.endswith("/api"):
-        final_path = f"{path}/generate"
-    elif path.endswith("/generate") and "/api" in path:
-        final_path = path
-    elif "/api/generate" in path:
-        final_path = path
-    else:
-        final_path = f"{path}/api/generate" if path else "/api/generate"
-
-    parsed = parsed._replace(path=final_path, params="", query="", fragment="")
-    endpoint = urlunparse(parsed)
-
-    def _normalize_int(value, fallback):
-        if value is None:
-            return fallback
-        if isinstance(value, str):
-            value = value.strip()
-            if not value:
-                return fallback
-        try:
-            ivalue = int(value)
-        except (TypeError, ValueError):
-            return fallback
-        return ivalue if ivalue > 0 else fallback
-
     num_ctx = _normalize_int(_row_value(row, "ai_num_ctx"), DEFAULT_AI_NUM_CTX)
     num_predict = _normalize_int(_row_value(row, "ai_num_predict"), DEFAULT_AI_NUM_PREDICT)
 
+    url_path = frame["url"]
     prompt = str(prompt_template)
     prompt = prompt.replace("{url}", url_path)
-    prompt = prompt.replace("{path}", file_path)
-    prompt = prompt.replace("{filename}", Path(file_path).name)
-
-    payload = {
-        "model": model,
-        "prompt": prompt,
-        "stream": False,
-        "options": {}
-    }
-
-    try:
-        image_bytes = Path(file_path).read_bytes()
-        image_b64 = base64.b64encode(image_bytes).decode("ascii")
-        if image_b64:
-            payload["images"] = [image_b64]
-    except Exception as exc:
-        print(f"[OLLAMA] failed to encode image for device={_row_value(row, 'device_id')}: {exc}")
+    # frame["path"] artik bircok karenin paylastigi segment dosyasi; {path} kareye ozgu URL'ye acilir
+    prompt = prompt.replace("{path}", url_path)
+    prompt = prompt.replace("{filename}", Path(url_path).name)
 
+    options = {}
     if num_ctx:
-        payload["options"]["num_ctx"] = int(num_ctx)
+        options["num_ctx"] = int(num_ctx)
     if num_predict:
-        payload["options"]["num_predict"] = int(num_predict)
-
-    try:
-        response = requests.post(endpoint, json=payload, timeout=20)
-    except Exception as exc:
-        print(f"[OLLAMA] request error for device={_row_value(row, 'device_id')}: {exc}")
-        return None
-
-    if response.status_code != 200:
-        print(f"[OLLAMA] HTTP {response.status_code} for device={_row_value(row, 'device_id')} endpoint={endpoint} body={response.text[:200]}")
-        return None
-
-    try:
-        data = response.json()
-    except ValueError:
-        print(f"[OLLAMA] invalid JSON for device={_row_value(row, 'device_id')}")
-        return None
-
-    text = data.get("response") or data.get("output") or data.get("text")
-    if isinstance(text, list):
-        text = " ".join(str(part) for part in text if part)
-    if text:
-        return str(text).strip()
-    return None
-
-
+        options["num_predict"] = int(num_predict)
+
+    return InferenceJob(
+        device_id=device_id,
+        frame_id=frame["id"],
+        endpoint=build_generate_url(host),
+        model=model,
+        prompt=prompt,
+        options=options,
+        image=image_bytes,
+        captured=frame["ts"],
+        on_result=_store_analysis,
+    )
@@ -4,8 +4,16 @@
 #include <WebServer.h>
 #include <DNSServer.h>
 #include <Preferences.h>
+#include <HTTPClient.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
 #include "esp_camera.h"
 
+// Reported to the backend at register and on every config poll; OTA targets are compared against it.
+#ifndef FIRMWARE_VERSION
+#define FIRMWARE_VERSION "1.1.0"
+#endif
+
 struct SensorTuning {
   bool whitebal = true;
   int wbMode = 0;
@@ -29,6 +37,38 @@ struct SensorTuning {
   int specialEffect = 0;
 };
 
+// Sensor output window in per-mille of the full field of view; 0,0,1000,1000 is the whole frame.
+struct RoiWindow {
+  uint16_t x = 0;
+  uint16_t y = 0;
+  uint16_t w = 1000;
+  uint16_t h = 1000;
+  // false: keep the framesize's pixel density (fewer bytes); true: scale the ROI up to the framesize.
+  bool zoom = false;
+
+  bool full() const { return x == 0 && y == 0 && w >= 1000 && h >= 1000; }
+  bool operator==(const RoiWindow& o) const {
+    return x == o.x && y == o.y && w == o.w && h == o.h && zoom == o.zoom;
+  }
+  bool operator!=(const RoiWindow& o) const { return !(*this == o); }
+};
+
+enum class FrameStream : uint8_t {
+  Analysis,
+  Archive,
+};
+
+// Full-resolution frames taken between analysis frames; the camera is initialised for the larger
+// of the two sizes so switching is a set_framesize, not a reinit.
+struct ArchiveStreamState {
+  framesize_t frameSize = FRAMESIZE_INVALID;  // INVALID: single stream
+  String frameSizeKey = "OFF";
+  int jpegQuality = 10;
+  uint32_t intervalSec = 300;
+  unsigned long lastMs = 0;
+  bool requested = false;
+};
+
 struct CameraState {
   framesize_t frameSize = FRAMESIZE_VGA;
   framesize_t frameSizeTarget = FRAMESIZE_VGA;
@@ -37,10 +77,27 @@ struct CameraState {
   int jpegQuality = 12;
   int jpegQualityTarget = 12;
   String lastUsedFrameSizeKey = "VGA";
+  int lastFrameQuality = 12;
+  FrameStream lastFrameStream = FrameStream::Analysis;
+  framesize_t bufferFrameSize = FRAMESIZE_VGA;
+  // Set after a framesize/window switch; the next grab checks the JPEG size before using it.
+  bool verifyNextFrame = false;
+  // Frames whose capture started before this esp_timer time are dropped (event capture).
+  int64_t freshAfterUs = 0;
+  ArchiveStreamState archive{};
   bool inited = false;
+  // Shut down for light sleep (inited is false meanwhile); the next capture brings it back.
+  bool poweredDown = false;
   int currentXclkHz = 20000000;
   uint8_t failedGrabStreak = 0;
   unsigned long lastReinitMs = 0;
+  bool discardNextFrame = false;
+  RoiWindow roi{};
+  RoiWindow roiTarget{};
+  bool roiActive = false;
+  bool lastFrameRoi = false;
+  uint16_t roiOutW = 0;
+  uint16_t roiOutH = 0;
   SensorTuning tuning{};
   SensorTuning target{};
 };
@@ -54,9 +111,25 @@ struct NetworkState {
 struct BackendState {
   String baseUrl;
   String token;
+  String caCert;
   uint32_t revision = 0;
   unsigned long lastConfigPollMs = 0;
+  unsigned long nextConfigPollMs = 0;
   uint32_t pollIntervalSec = 5;
+  uint32_t pollPhaseMs = 0;
+};
+
+// Backend wall clock as seen at syncMillis; used to put every device on its assigned phase.
+struct ClockState {
+  bool synced = false;
+  uint64_t serverEpochMs = 0;
+  unsigned long syncMillis = 0;
+  uint32_t jitterMs = 0;
+  // Wall clock for X-Device-Time and the capture schedule: SNTP, seeded from the backend until
+  // the first SNTP answer. tz is a POSIX TZ string ("<+03>-3", "CET-1CEST,M3.5.0,M10.5.0/3").
+  String tz = "UTC0";
+  String ntpServer = "pool.ntp.org";
+  bool sntpStarted = false;
 };
 
 struct UploadState {
@@ -64,19 +137,189 @@ struct UploadState {
   String apiToken;
   bool autoUpload = false;
   uint32_t intervalSec = 10;
+  uint32_t phaseMs = 0;
   unsigned long lastUploadMs = 0;
+  unsigned long nextUploadMs = 0;
+  uint8_t failStreak = 0;
+  // esp_timer time of the trigger behind the frame being uploaded; 0 for scheduled frames.
+  int64_t eventFiredUs = 0;
+};
+
+// One weekly window of the backend-pushed capture schedule, in device-local time. Fields left
+// at their "keep" value fall through to the base config.
+struct ScheduleWindow {
+  uint8_t days = 0x7F;       // bit n = tm_wday n (0 = Sunday)
+  uint16_t startMin = 0;     // minutes since local midnight
+  uint16_t endMin = 1440;    // exclusive; end <= start runs past midnight into the next day
+  uint32_t intervalSec = 0;  // 0: keep
+  framesize_t frameSize = FRAMESIZE_INVALID;  // INVALID: keep
+  int8_t jpegQuality = -1;   // -1: keep
+  int8_t autoUpload = -1;    // -1: keep, 0: off, 1: on
+};
+
+constexpr size_t kScheduleMaxWindows = 8;
+
+// Capture settings as the backend sent them; the active window is laid over these to get the
+// interval and camera targets actually in use.
+struct CaptureProfile {
+  uint32_t intervalSec = 10;
+  framesize_t frameSize = FRAMESIZE_VGA;
+  int jpegQuality = 12;
+  bool autoUpload = false;
+};
+
+struct ScheduleState {
+  String spec;  // as received; "none" = no windows
+  ScheduleWindow windows[kScheduleMaxWindows];
+  uint8_t count = 0;
+  int8_t active = -1;  // window in force, -1: base profile
+  CaptureProfile base;
+  unsigned long lastEvalMs = 0;
+};
+
+// PIR / door-contact input. The ISR only touches EventTrigger.cpp's DRAM state; this is the
+// loop-side configuration and bookkeeping.
+struct TriggerState {
+  int gpio = -1;  // -1: no trigger input
+  bool activeHigh = true;
+  uint32_t cooldownMs = 2000;
+  bool lightSleep = false;
+  int64_t lastEventUs = 0;
 };
 
-struct LowLightState {
-  bool boostEnabled = true;
-  bool active = false;
-  uint8_t score = 0;
-  unsigned long lastLogMs = 0;
+// Backend-published target image and the trial state of a freshly flashed one.
+struct OtaState {
+  String target;              // version the backend wants; empty = stay
+  String failedTarget;        // last target that failed to download or apply
+  String rejectedTarget;      // image rolled back after flashing; never retried automatically
+  unsigned long retryAtMs = 0;
+  bool pendingVerify = false;  // running image not yet confirmed healthy
+  unsigned long verifyDeadlineMs = 0;
+};
+
+// Ordered from brightest to darkest; the engine only ever steps along this order.
+enum class SceneMode : uint8_t {
+  Day,
+  Dusk,
+  Night,
+  Ir,
+  Count,
+};
+
+constexpr size_t kSceneModeCount = static_cast<size_t>(SceneMode::Count);
+
+// Thresholds are on the exposure index (aec_value + 40 * agc_gain). Day has no profile of its
+// own: it is the manual tuning from the backend.
+struct SceneProfile {
+  bool enabled = false;
+  uint16_t enterIndex = 0;
+  uint16_t exitIndex = 0;
+  uint8_t gainceilingIndex = 4;
+  int8_t aeLevel = 0;
+  bool aec2 = false;
+  bool grayscale = false;
+  bool irLight = false;
+};
+
+struct SceneState {
+  bool enabled = true;
+  String profileSpec;
+  SceneProfile profiles[kSceneModeCount];
+  SceneMode mode = SceneMode::Day;
+  SceneMode pending = SceneMode::Day;
+  uint8_t pendingSamples = 0;
+  uint32_t exposureIndex = 0;
+  int16_t lastLuma = -1;
+  unsigned long lastLumaMs = 0;
+  unsigned long lastSampleMs = 0;
+  unsigned long modeSinceMs = 0;
+  unsigned long accountedMs = 0;
+  uint32_t transitions = 0;
+  uint32_t timeInModeMs[kSceneModeCount] = {};
 };
 
 struct HttpState {
   int lastStatus = 0;
   String lastError = "-";
+  uint32_t retryAfterMs = 0;
+  // Set when the last upload failed on the network or HTTP side; only that kind of failure backs off.
+  bool transportFailed = false;
+};
+
+enum class TelemetryStage : uint8_t {
+  Grab,
+  UploadConnect,
+  UploadSend,
+  UploadResponse,
+  ConfigFetch,
+  ConfigParse,
+  ConfigApply,
+  TlsHandshake,
+  ArchiveGrab,
+  TriggerToUpload,
+  Count,
+};
+
+enum class TelemetryCounter : uint8_t {
+  GrabFail,
+  FallbackFrame,
+  XclkReinit,
+  UploadOk,
+  UploadHttpError,
+  UploadRejected,
+  ConfigFail,
+  TlsHandshake,
+  ConnReuse,
+  ConnRetry,
+  StaleFrame,
+  ArchiveOk,
+  TriggerEvent,
+  TriggerSuppressed,
+  OtaFail,
+  OtaRollback,
+  Count,
+};
+
+constexpr size_t kTelemetryStageCount = static_cast<size_t>(TelemetryStage::Count);
+constexpr size_t kTelemetryCounterCount = static_cast<size_t>(TelemetryCounter::Count);
+// Bucket 0 holds 0us, bucket i holds [2^(i-1), 2^i) us, the last bucket is open ended (~4 s+).
+constexpr size_t kTelemetryBuckets = 24;
+
+struct LatencyHistogram {
+  uint32_t count = 0;
+  uint32_t maxUs = 0;
+  uint64_t sumUs = 0;
+  uint16_t buckets[kTelemetryBuckets] = {};
+};
+
+struct TelemetryState {
+  LatencyHistogram stages[kTelemetryStageCount];
+  uint32_t counters[kTelemetryCounterCount] = {};
+  unsigned long windowStartMs = 0;
+  unsigned long lastPushMs = 0;
+  uint32_t pushIntervalSec = 60;
+};
+
+// Persistent keep-alive connections; a TLS session is set up once per slot and reused
+// for every later request to the same host, so steady-state uploads skip the handshake.
+constexpr size_t kHttpSlotCount = 2;
+// A socket idle longer than this is reconnected instead of reused. It must stay below the
+// backend's keep-alive timeout (HTTP_KEEPALIVE_SEC, 75 s), or reuse races the server's close.
+constexpr unsigned long kKeepAliveIdleMs = 65000;
+
+struct HttpSlot {
+  WiFiClient plain;
+  WiFiClientSecure secure;
+  HTTPClient http;
+  String host;
+  uint16_t port = 0;
+  bool tls = false;
+  unsigned long lastUsedMs = 0;
+};
+
+struct TransportState {
+  HttpSlot slots[kHttpSlotCount];
+  unsigned long keepAliveIdleMs = kKeepAliveIdleMs;
 };
 
 struct DeviceInfo {
@@ -89,10 +332,16 @@ struct FirmwareState {
   Preferences prefs;
   NetworkState network;
   BackendState backend;
+  ClockState clock;
   UploadState upload;
+  ScheduleState schedule;
+  TriggerState trigger;
+  OtaState ota;
   CameraState camera;
-  LowLightState lowLight;
+  SceneState scene;
   HttpState http;
+  TelemetryState telemetry;
+  TransportState transport;
   DeviceInfo device;
 };
 
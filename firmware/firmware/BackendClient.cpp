@@ -7,13 +7,21 @@
 
 #include "AppContext.h"
 #include "CameraController.h"
+#include "CaptureSchedule.h"
 #include "ConfigStorage.h"
+#include "EventTrigger.h"
+#include "HttpTransport.h"
 #include "Logging.h"
+#include "SceneEngine.h"
+#include "Scheduler.h"
+#include "Telemetry.h"
 #include "esp_camera.h"
+#include "esp_timer.h"
 
 namespace {
 constexpr const char* kRegisterPath = "/api/register";
 constexpr const char* kConfigPath = "/api/config";
+constexpr const char* kTelemetryPath = "/api/telemetry";
 
 String joinUrl(const String& base, const char* path) {
   if (base.length() == 0) return String(path ? path : "");
@@ -53,6 +61,26 @@ long jsonGetInt(const String& body, const char* key, long defv = LONG_MIN) {
   return body.substring(s, j).toInt();
 }
 
+int64_t jsonGetInt64(const String& body, const char* key, int64_t defv) {
+  String needle = "\"" + String(key) + "\"";
+  int i = body.indexOf(needle);
+  if (i < 0) return defv;
+  i = body.indexOf(':', i + needle.length());
+  if (i < 0) return defv;
+  int j = i + 1;
+  while (j < body.length() && (body[j] == ' ' || body[j] == '\t')) j++;
+  bool negative = (j < body.length() && body[j] == '-');
+  if (negative) j++;
+  int s = j;
+  int64_t value = 0;
+  while (j < body.length() && body[j] >= '0' && body[j] <= '9') {
+    value = value * 10 + (body[j] - '0');
+    j++;
+  }
+  if (s == j) return defv;
+  return negative ? -value : value;
+}
+
 bool jsonGetBool(const String& body, const char* key, bool defVal) {
   String needle = "\"" + String(key) + "\"";
   int i = body.indexOf(needle);
@@ -74,19 +102,19 @@ void registerWithBackend() {
   }
 
   String url = joinUrl(ctx.backend.baseUrl, kRegisterPath);
-  WiFiClient client;
-  HTTPClient http;
-  if (!http.begin(client, url)) {
+  bool reused = false;
+  HTTPClient* http = beginHttpRequest(url, reused);
+  if (!http) {
     LOGE_LN("[BE] http.begin failed (register)");
     return;
   }
-  http.addHeader("Content-Type", "application/json");
-  http.addHeader("Authorization", "Bearer " + ctx.backend.token);
+  http->addHeader("Content-Type", "application/json");
+  http->addHeader("Authorization", "Bearer " + ctx.backend.token);
 
   String payload = String("{") +
     "\"deviceId\":\"" + ctx.device.id + "\"," +
     "\"uniqueId\":\"" + ctx.device.id + "\"," +
-    "\"fw\":\"1.0.0\"," +
+    "\"fw\":\"" FIRMWARE_VERSION "\"," +
     "\"ip\":\"" + WiFi.localIP().toString() + "\"," +
     "\"rssi\":" + String(WiFi.RSSI()) + "," +
     "\"model\":\"ESP32-CAM-OV2640\"," +
@@ -98,10 +126,10 @@ void registerWithBackend() {
     "\"sdk\":\"" + String(ESP.getSdkVersion()) + "\"" +
   "}";
 
-  http.setTimeout(15000);
-  int code = http.POST((uint8_t*)payload.c_str(), payload.length());
+  http->setTimeout(15000);
+  int code = http->POST((uint8_t*)payload.c_str(), payload.length());
   LOGV("[BE] register POST => %d\n", code);
-  http.end();
+  endHttpRequest(http, code > 0);
 }
 
 bool fetchConfigFromBackend() {
@@ -111,56 +139,114 @@ bool fetchConfigFromBackend() {
   }
 
   String url = joinUrl(ctx.backend.baseUrl, kConfigPath);
-  url += "?deviceId=" + ctx.device.id + "&rev=" + String(ctx.backend.revision);
-
-  WiFiClient client;
-  HTTPClient http;
-  if (!http.begin(client, url)) {
-    LOGE_LN("[BE] http.begin failed (config)");
-    return false;
+  url += "?deviceId=" + ctx.device.id + "&rev=" + String(ctx.backend.revision) + "&fw=" FIRMWARE_VERSION;
+  if (ctx.ota.rejectedTarget.length()) url += "&fwRejected=" + ctx.ota.rejectedTarget;
+
+  unsigned long fetchStartUs = micros();
+  int code = 0;
+  String body;
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    bool reused = false;
+    HTTPClient* http = beginHttpRequest(url, reused);
+    if (!http) {
+      LOGE_LN("[BE] http.begin failed (config)");
+      break;
+    }
+    http->addHeader("Authorization", "Bearer " + ctx.backend.token);
+    http->setTimeout(15000);
+    code = http->GET();
+    if (code > 0) body = http->getString();
+    endHttpRequest(http, code > 0);
+    // A kept-alive socket may have been closed by the server while idle; retry once on a fresh one.
+    if (code > 0 || !reused) break;
+    telemetryCount(TelemetryCounter::ConnRetry);
   }
-  http.addHeader("Authorization", "Bearer " + ctx.backend.token);
-  http.setTimeout(15000);
-
-  int code = http.GET();
   if (code <= 0) {
     LOGE("[BE] GET config err: %d\n", code);
-    http.end();
+    telemetryCount(TelemetryCounter::ConfigFail);
     return false;
   }
-  String body = http.getString();
-  http.end();
+  uint32_t fetchUs = micros() - fetchStartUs;
+  telemetryRecord(TelemetryStage::ConfigFetch, fetchUs);
+
+  unsigned long parseStartUs = micros();
 
   long rev = jsonGetInt(body, "rev", LONG_MIN);
 
+  // framesize/quality/interval/autoUpload form the base profile; a schedule window may override them.
+  auto& base = ctx.schedule.base;
   String fsKey = jsonGetString(body, "framesize");
-  long q = jsonGetInt(body, "jpegQuality", ctx.camera.jpegQualityTarget);
-  long interval = jsonGetInt(body, "uploadIntervalSec", ctx.upload.intervalSec);
+  long q = jsonGetInt(body, "jpegQuality", base.jpegQuality);
+  long interval = jsonGetInt(body, "uploadIntervalSec", base.intervalSec);
   String newUploadUrl = jsonGetString(body, "uploadUrl");
   String newUploadTok = jsonGetString(body, "uploadToken");
-  bool newAuto = jsonGetBool(body, "autoUpload", ctx.upload.autoUpload);
-  bool newLowLight = jsonGetBool(body, "lowLightBoost", ctx.lowLight.boostEnabled);
-
-  if (fsKey.length()) {
-    ctx.camera.frameSizeTarget = framesizeFromKey(fsKey);
-    ctx.camera.frameSizeKeyTarget = fsKey;
-  }
+  bool newAuto = jsonGetBool(body, "autoUpload", base.autoUpload);
+  String scheduleSpec = jsonGetString(body, "schedule");
+  String tz = jsonGetString(body, "tz");
+  String ntpServer = jsonGetString(body, "ntpServer");
+  bool newSceneEnabled = jsonGetBool(body, "lowLightBoost", ctx.scene.enabled);
+  String sceneProfiles = jsonGetString(body, "sceneProfiles");
+  long telemetryInterval = jsonGetInt(body, "telemetryIntervalSec", ctx.telemetry.pushIntervalSec);
+  int64_t serverTimeMs = jsonGetInt64(body, "serverTimeMs", 0);
+  long uploadPhase = jsonGetInt(body, "uploadPhaseMs", ctx.upload.phaseMs);
+  long pollPhase = jsonGetInt(body, "pollPhaseMs", ctx.backend.pollPhaseMs);
+  long pollInterval = jsonGetInt(body, "pollIntervalSec", ctx.backend.pollIntervalSec);
+  long jitter = jsonGetInt(body, "scheduleJitterMs", ctx.clock.jitterMs);
+
+  if (fsKey.length()) base.frameSize = framesizeFromKey(fsKey);
   if (q < 5) q = 5;
   if (q > 63) q = 63;
-  ctx.camera.jpegQualityTarget = static_cast<int>(q);
+  base.jpegQuality = static_cast<int>(q);
 
   if (interval < 1) interval = 1;
   if (interval > 3600) interval = 3600;
-  ctx.upload.intervalSec = static_cast<uint32_t>(interval);
+  if (uploadPhase < 0) uploadPhase = 0;
+  if (pollPhase < 0) pollPhase = 0;
+  if (pollInterval < 1) pollInterval = 1;
+  if (pollInterval > 3600) pollInterval = 3600;
+  if (jitter < 0) jitter = 0;
+  if (jitter > 10000) jitter = 10000;
+
+  bool resyncClock = serverTimeMs > 0 && !ctx.clock.synced;
+  if (serverTimeMs > 0) syncServerClock(static_cast<uint64_t>(serverTimeMs), fetchUs / 1000);
+  ctx.clock.jitterMs = static_cast<uint32_t>(jitter);
+  wallClockConfigure(tz, ntpServer);
+
+  base.intervalSec = static_cast<uint32_t>(interval);
+  base.autoUpload = newAuto;
+  if (scheduleSpec.length() && scheduleSpec != ctx.schedule.spec) scheduleParse(scheduleSpec);
+  uint32_t oldInterval = ctx.upload.intervalSec;
+  scheduleApplyProfile(scheduleActiveWindow());
+
+  bool uploadGridChanged = resyncClock || ctx.upload.intervalSec != oldInterval ||
+                           ctx.upload.phaseMs != static_cast<uint32_t>(uploadPhase);
+  ctx.upload.phaseMs = static_cast<uint32_t>(uploadPhase);
+  if (uploadGridChanged) {
+    ctx.upload.nextUploadMs = nextAlignedMillis(ctx.upload.intervalSec * 1000UL, ctx.upload.phaseMs);
+  }
+
+  bool pollGridChanged = resyncClock || ctx.backend.pollIntervalSec != static_cast<uint32_t>(pollInterval) ||
+                         ctx.backend.pollPhaseMs != static_cast<uint32_t>(pollPhase);
+  ctx.backend.pollIntervalSec = static_cast<uint32_t>(pollInterval);
+  ctx.backend.pollPhaseMs = static_cast<uint32_t>(pollPhase);
+  if (pollGridChanged) {
+    ctx.backend.nextConfigPollMs = nextAlignedMillis(ctx.backend.pollIntervalSec * 1000UL, ctx.backend.pollPhaseMs);
+  }
 
   if (newUploadUrl.length()) ctx.upload.apiUrl = newUploadUrl;
   else if (ctx.upload.apiUrl.isEmpty()) ctx.upload.apiUrl = defaultUploadUrl(ctx.backend.baseUrl);
   if (newUploadTok.length()) ctx.upload.apiToken = newUploadTok;
-  ctx.upload.autoUpload = newAuto;
 
-  if (ctx.lowLight.boostEnabled != newLowLight) {
-    ctx.lowLight.boostEnabled = newLowLight;
-    resetLowLightState();
+  if (telemetryInterval < 0) telemetryInterval = 0;
+  if (telemetryInterval > 86400) telemetryInterval = 86400;
+  ctx.telemetry.pushIntervalSec = static_cast<uint32_t>(telemetryInterval);
+
+  if (ctx.scene.enabled != newSceneEnabled) {
+    ctx.scene.enabled = newSceneEnabled;
+    sceneReset();
+  }
+  if (sceneProfiles.length() && sceneProfiles != ctx.scene.profileSpec) {
+    sceneParseProfiles(sceneProfiles);
   }
 
   auto& target = ctx.camera.target;
@@ -185,15 +271,37 @@ bool fetchConfigFromBackend() {
   target.dcwEnabled = jsonGetBool(body, "dcw", target.dcwEnabled);
   target.colorbarEnabled = jsonGetBool(body, "colorbar", target.colorbarEnabled);
   target.specialEffect = static_cast<int>(jsonGetInt(body, "specialEffect", target.specialEffect));
-
+  auto& archive = ctx.camera.archive;
+  String archiveKey = jsonGetString(body, "archiveFramesize");
+  if (archiveKey.length()) {
+    archive.frameSize = archiveKey.equalsIgnoreCase("OFF") ? FRAMESIZE_INVALID : framesizeFromKey(archiveKey);
+    archive.frameSizeKey = archive.frameSize == FRAMESIZE_INVALID ? "OFF" : keyFromFramesize(archive.frameSize);
+  }
+  archive.jpegQuality = static_cast<int>(constrain(jsonGetInt(body, "archiveQuality", archive.jpegQuality), 5L, 63L));
+  archive.intervalSec = static_cast<uint32_t>(constrain(jsonGetInt(body, "archiveIntervalSec", archive.intervalSec), 0L, 86400L));
+  auto& trigger = ctx.trigger;
+  trigger.cooldownMs = static_cast<uint32_t>(constrain(jsonGetInt(body, "triggerCooldownMs", trigger.cooldownMs), 0L, 600000L));
+  trigger.lightSleep = jsonGetBool(body, "triggerLightSleep", trigger.lightSleep);
+  eventTriggerConfigure(static_cast<int>(jsonGetInt(body, "triggerGpio", trigger.gpio)),
+                        jsonGetBool(body, "triggerActiveHigh", trigger.activeHigh));
+  ctx.ota.target = jsonGetString(body, "fwTarget");
+  const auto& roi = ctx.camera.roiTarget;
+  setRoiTarget(jsonGetInt(body, "roiX", roi.x), jsonGetInt(body, "roiY", roi.y),
+               jsonGetInt(body, "roiW", roi.w), jsonGetInt(body, "roiH", roi.h),
+               jsonGetBool(body, "roiZoom", roi.zoom));
+  telemetryRecord(TelemetryStage::ConfigParse, micros() - parseStartUs);
+
+  unsigned long applyStartUs = micros();
   applyConfigIfNeeded();
+  telemetryRecord(TelemetryStage::ConfigApply, micros() - applyStartUs);
 
   if (rev != LONG_MIN) {
     ctx.backend.revision = static_cast<uint32_t>(rev);
   }
   savePrefs();
 
-  LOGV("[CFG] auto=%d int=%lus fs=%s q=%d url=%s toklen=%u\n",
+  LOGV("[CFG] window=%d auto=%d int=%lus fs=%s q=%d url=%s toklen=%u\n",
+       ctx.schedule.active,
        ctx.upload.autoUpload ? 1 : 0,
        static_cast<unsigned long>(ctx.upload.intervalSec),
        labelFromFramesize(ctx.camera.frameSizeTarget),
@@ -216,23 +324,24 @@ void testUploadConnectivity() {
   if (!kVerboseLogging) return;
   if (ctx.upload.apiUrl.isEmpty() || WiFi.status() != WL_CONNECTED) return;
 
-  WiFiClient client;
-  HTTPClient http;
-  if (!http.begin(client, ctx.upload.apiUrl)) {
+  bool reused = false;
+  HTTPClient* http = beginHttpRequest(ctx.upload.apiUrl, reused);
+  if (!http) {
     LOGV_LN("[TEST] begin fail");
     return;
   }
   if (ctx.upload.apiToken.length()) {
-    http.addHeader("Authorization", "Bearer " + ctx.upload.apiToken);
+    http->addHeader("Authorization", "Bearer " + ctx.upload.apiToken);
   }
-  http.setTimeout(8000);
-  int code = http.GET();
+  http->setTimeout(8000);
+  int code = http->GET();
   LOGV("[TEST] GET %s => %d\n", ctx.upload.apiUrl.c_str(), code);
-  http.end();
+  endHttpRequest(http, code > 0);
 }
 
 bool uploadFrameToApi(const uint8_t* data, size_t len) {
   auto& ctx = app();
+  ctx.http.transportFailed = false;
   if (ctx.upload.apiUrl.isEmpty()) {
     ctx.http.lastError = "No API URL";
     ctx.http.lastStatus = 0;
@@ -241,57 +350,164 @@ bool uploadFrameToApi(const uint8_t* data, size_t len) {
   if (WiFi.status() != WL_CONNECTED) {
     ctx.http.lastError = "No WiFi";
     ctx.http.lastStatus = 0;
+    ctx.http.transportFailed = true;
     return false;
   }
 
-  WiFiClient client;
-  HTTPClient http;
-  if (!http.begin(client, ctx.upload.apiUrl)) {
-    ctx.http.lastError = "http.begin()";
-    ctx.http.lastStatus = 0;
-    return false;
-  }
-
-  http.addHeader("Content-Type", "image/jpeg", true);
-  http.addHeader("X-Device-ID", ctx.device.id);
-  http.addHeader("X-Frame-Size", ctx.camera.lastUsedFrameSizeKey);
-  http.addHeader("X-JPEG-Quality", String(ctx.camera.jpegQuality));
   char fname[64];
   snprintf(fname, sizeof(fname), "%s_%lu.jpg", ctx.device.id.c_str(), static_cast<unsigned long>(millis()));
-  http.addHeader("X-File-Name", fname);
-  http.addHeader("X-Device-Time", String(static_cast<unsigned long>(time(nullptr))));
-  if (ctx.upload.apiToken.length()) {
-    http.addHeader("Authorization", "Bearer " + ctx.upload.apiToken);
+
+  static const char* kResponseHeaders[] = {"Retry-After"};
+  ctx.http.retryAfterMs = 0;
+  int code = 0;
+  String payload;
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    bool reused = false;
+    unsigned long connectStartUs = micros();
+    HTTPClient* http = beginHttpRequest(ctx.upload.apiUrl, reused);
+    telemetryRecord(TelemetryStage::UploadConnect, micros() - connectStartUs);
+    if (!http) {
+      ctx.http.lastError = "connect()";
+      ctx.http.lastStatus = 0;
+      ctx.http.transportFailed = true;
+      telemetryCount(TelemetryCounter::UploadHttpError);
+      return false;
+    }
+
+    http->addHeader("Content-Type", "image/jpeg", true);
+    http->addHeader("X-Device-ID", ctx.device.id);
+    http->addHeader("X-Frame-Size", ctx.camera.lastUsedFrameSizeKey);
+    http->addHeader("X-JPEG-Quality", String(ctx.camera.lastFrameQuality));
+    http->addHeader("X-Stream", ctx.camera.lastFrameStream == FrameStream::Archive ? "archive" : "analysis");
+    if (ctx.upload.eventFiredUs && ctx.camera.lastFrameStream == FrameStream::Analysis) {
+      http->addHeader("X-Trigger", "gpio");
+      http->addHeader("X-Trigger-Age-Ms", String(static_cast<unsigned long>((esp_timer_get_time() - ctx.upload.eventFiredUs) / 1000)));
+    }
+    if (ctx.camera.lastFrameRoi) {
+      const auto& roi = ctx.camera.roi;
+      http->addHeader("X-ROI", String(roi.x) + "," + String(roi.y) + "," + String(roi.w) + "," + String(roi.h));
+    }
+    http->addHeader("X-File-Name", fname);
+    if (wallClockValid()) http->addHeader("X-Device-Time", String(static_cast<unsigned long>(time(nullptr))));
+    if (ctx.upload.apiToken.length()) {
+      http->addHeader("Authorization", "Bearer " + ctx.upload.apiToken);
+    }
+    http->setTimeout(15000);
+    http->collectHeaders(kResponseHeaders, 1);
+
+    unsigned long sendStartUs = micros();
+    code = http->POST(const_cast<uint8_t*>(data), len);
+    telemetryRecord(TelemetryStage::UploadSend, micros() - sendStartUs);
+    if (code > 0) {
+      unsigned long responseStartUs = micros();
+      payload = http->getString();
+      telemetryRecord(TelemetryStage::UploadResponse, micros() - responseStartUs);
+      long retryAfterSec = http->header("Retry-After").toInt();
+      if (retryAfterSec > 3600) retryAfterSec = 3600;
+      if (retryAfterSec > 0) ctx.http.retryAfterMs = static_cast<uint32_t>(retryAfterSec) * 1000UL;
+    } else {
+      payload = HTTPClient::errorToString(code);
+    }
+    endHttpRequest(http, code > 0);
+    if (code > 0 || !reused) break;
+    telemetryCount(TelemetryCounter::ConnRetry);
   }
-  http.setTimeout(15000);
 
-  int code = http.POST(const_cast<uint8_t*>(data), len);
   ctx.http.lastStatus = code;
-
+  ctx.http.lastError = payload;
   if (code <= 0) {
-    ctx.http.lastError = http.errorToString(code);
-    http.end();
+    ctx.http.transportFailed = true;
+    telemetryCount(TelemetryCounter::UploadHttpError);
     return false;
   }
-  String payload = http.getString();
-  ctx.http.lastError = payload;
-  http.end();
-  return (code >= 200 && code < 300);
+  bool ok = (code >= 200 && code < 300);
+  ctx.http.transportFailed = !ok;
+  telemetryCount(ok ? TelemetryCounter::UploadOk : TelemetryCounter::UploadRejected);
+  if (ok && ctx.upload.eventFiredUs && ctx.camera.lastFrameStream == FrameStream::Analysis) {
+    telemetryRecord(TelemetryStage::TriggerToUpload, static_cast<uint32_t>(esp_timer_get_time() - ctx.upload.eventFiredUs));
+  }
+  if (ok && ctx.camera.lastFrameStream == FrameStream::Archive) {
+    telemetryCount(TelemetryCounter::ArchiveOk);
+    return true;
+  }
+  // The backend decodes every frame anyway; its mean luma tells the scene engine about black frames.
+  if (ok) sceneReportFrameLuma(static_cast<int>(jsonGetInt(payload, "luma", -1)));
+  return ok;
 }
 
 bool captureAndUploadOnce() {
   auto& ctx = app();
-  if (!ctx.camera.inited) return false;
+  // A failure before the request goes out is local (camera); it must not back off like a 429.
+  ctx.http.transportFailed = false;
+  if (!cameraPowerUp()) return false;
 
+  unsigned long grabStartUs = micros();
   camera_fb_t* fb = safeGrab();
+  telemetryRecord(TelemetryStage::Grab, micros() - grabStartUs);
   if (!fb) {
     ctx.http.lastError = "fb=null";
     ctx.http.lastStatus = 0;
     return false;
   }
 
-  evaluateLowLightMetrics();
   bool ok = uploadFrameToApi(fb->buf, fb->len);
   esp_camera_fb_return(fb);
+
+  // The archive frame rides on the analysis slot; its outcome does not change the upload backoff.
+  if (ok && archiveFrameDue()) {
+    grabStartUs = micros();
+    camera_fb_t* archiveFb = grabArchiveFrame();
+    telemetryRecord(TelemetryStage::ArchiveGrab, micros() - grabStartUs);
+    if (archiveFb) {
+      // The caller logs and schedules from ctx.http: keep the analysis upload's status and Retry-After.
+      HttpState analysisHttp = ctx.http;
+      if (!uploadFrameToApi(archiveFb->buf, archiveFb->len)) {
+        LOGE("[Archive] FAIL HTTP=%d info=%s\n", ctx.http.lastStatus, ctx.http.lastError.c_str());
+      }
+      ctx.http = analysisHttp;
+      releaseArchiveFrame(archiveFb);
+    } else {
+      telemetryCount(TelemetryCounter::GrabFail);
+    }
+  }
+  return ok;
+}
+
+bool captureEventAndUpload(int64_t firedUs) {
+  auto& ctx = app();
+  if (!cameraPowerUp()) return false;
+
+  ctx.camera.freshAfterUs = firedUs;
+  ctx.upload.eventFiredUs = firedUs;
+  // An event is exactly when a full-resolution archive frame is worth having.
+  requestArchiveFrame();
+  bool ok = captureAndUploadOnce();
+  ctx.upload.eventFiredUs = 0;
   return ok;
 }
+
+bool pushTelemetryToBackend() {
+  auto& ctx = app();
+  if (ctx.backend.baseUrl.isEmpty() || ctx.backend.token.isEmpty() || WiFi.status() != WL_CONNECTED) {
+    return false;
+  }
+
+  String url = joinUrl(ctx.backend.baseUrl, kTelemetryPath);
+  bool reused = false;
+  HTTPClient* http = beginHttpRequest(url, reused);
+  if (!http) {
+    LOGE_LN("[BE] http.begin failed (telemetry)");
+    return false;
+  }
+  http->addHeader("Content-Type", "application/json");
+  http->addHeader("Authorization", "Bearer " + ctx.backend.token);
+  http->setTimeout(8000);
+
+  String payload = telemetryJson();
+  int code = http->POST((uint8_t*)payload.c_str(), payload.length());
+  endHttpRequest(http, code > 0);
+  LOGV("[BE] telemetry POST (%u bytes) => %d\n", static_cast<unsigned>(payload.length()), code);
+  if (code < 200 || code >= 300) return false;
+  telemetryReset();
+  return true;
+}
@@ -6,4 +6,6 @@ void registerWithBackend();
 bool fetchConfigFromBackend();
 void testUploadConnectivity();
 bool uploadFrameToApi(const uint8_t* data, size_t len);
-bool captureAndUploadOnce();
\ No newline at end of file
+bool captureAndUploadOnce();
+bool captureEventAndUpload(int64_t firedUs);
+bool pushTelemetryToBackend();
\ No newline at end of file
@@ -6,18 +6,12 @@
 #include "AppContext.h"
 #include "ConfigStorage.h"
 #include "Logging.h"
+#include "Telemetry.h"
 
 namespace {
-void EvaluateLowLightMetricsInternal();
-void RefreshLowLightProfileInternal();
-void ResetLowLightStateInternal();
-constexpr uint16_t kLowLightAecActivate = 850;
-constexpr uint16_t kLowLightAecRelease = 700;
-constexpr uint8_t kLowLightGainActivate = 24;
-constexpr uint8_t kLowLightGainRelease = 18;
-constexpr uint8_t kLowLightScoreThreshold = 3;
-constexpr uint8_t kLowLightScoreMax = 6;
-constexpr unsigned long kLowLightLogIntervalMs = 10000UL;
+constexpr uint16_t kOv2640Pid = 0x26;
+// GPIO driving an IR illuminator / IR-cut filter; the stock ESP32-CAM has none.
+constexpr int kIrLightGpio = -1;
 
 constexpr int PWDN_GPIO_NUM = 32;
 constexpr int RESET_GPIO_NUM = -1;
@@ -52,26 +46,6 @@ gainceiling_t gainceilingFromIndex(int idx) {
   return kMap[idx];
 }
 
-void applyLowLightProfile(sensor_t* s, bool active) {
-  if (!s) return;
-  if (!active) {
-    s->set_aec2(s, 0);
-    return;
-  }
-  s->set_gain_ctrl(s, 1);
-  s->set_awb_gain(s, 1);
-  s->set_exposure_ctrl(s, 1);
-  s->set_gainceiling(s, GAINCEILING_32X);
-  s->set_aec2(s, 1);
-
-  auto& target = app().camera.target;
-  int boostAe = constrain(target.aeLevel, 0, 2);
-  s->set_ae_level(s, boostAe);
-  s->set_dcw(s, 1);
-  s->set_bpc(s, 1);
-  s->set_wpc(s, 1);
-}
-
 void applyManualSensorParams(sensor_t* s) {
   if (!s) return;
   auto& ctx = app();
@@ -132,69 +106,234 @@ void applyManualSensorParams(sensor_t* s) {
   active.specialEffect = spe;
 }
 
-void updateLowLightObserver(uint16_t aecValue, uint8_t agcGain) {
+// Registers a scene mode touches on top of the manual tuning.
+struct SceneRegisters {
+  uint8_t gainceilingIndex;
+  int aeLevel;
+  bool aec2;
+  int specialEffect;
+  bool forceAuto;
+  bool irLight;
+};
+
+SceneRegisters sceneRegistersFor(SceneMode mode) {
   auto& ctx = app();
-  auto& lowLight = ctx.lowLight;
-  if (!lowLight.boostEnabled) return;
-
-  bool requestBoost = (aecValue >= kLowLightAecActivate) || (agcGain >= kLowLightGainActivate);
-  bool requestRelease = (aecValue <= kLowLightAecRelease) && (agcGain <= kLowLightGainRelease);
-
-  if (requestBoost) {
-    if (lowLight.score < kLowLightScoreMax) lowLight.score++;
-  } else if (requestRelease) {
-    if (lowLight.score > 0) lowLight.score--;
-  } else if (lowLight.score > 0) {
-    lowLight.score--;
+  const auto& active = ctx.camera.tuning;
+  SceneRegisters regs{active.gainceilingIndex, active.aeLevel, false, active.specialEffect, false, false};
+  if (!ctx.scene.enabled || mode == SceneMode::Day) return regs;
+
+  const auto& profile = ctx.scene.profiles[static_cast<size_t>(mode)];
+  regs.gainceilingIndex = profile.gainceilingIndex;
+  regs.aeLevel = constrain(static_cast<int>(profile.aeLevel), -2, 2);
+  regs.aec2 = profile.aec2;
+  if (profile.grayscale) regs.specialEffect = 2;
+  regs.forceAuto = true;
+  regs.irLight = profile.irLight;
+  return regs;
+}
+
+// Writes only the registers that differ from `from` (all of them when from is null), back to back.
+void writeSceneRegisters(sensor_t* s, const SceneRegisters* from, const SceneRegisters& to) {
+  const auto& active = app().camera.tuning;
+  if (!from || from->forceAuto != to.forceAuto) {
+    s->set_gain_ctrl(s, (to.forceAuto || active.gainCtrl) ? 1 : 0);
+    s->set_exposure_ctrl(s, (to.forceAuto || active.exposureCtrl) ? 1 : 0);
+    s->set_awb_gain(s, (to.forceAuto || active.awbGain) ? 1 : 0);
+    s->set_dcw(s, (to.forceAuto || active.dcwEnabled) ? 1 : 0);
+    s->set_bpc(s, (to.forceAuto || active.bpcEnabled) ? 1 : 0);
+    s->set_wpc(s, (to.forceAuto || active.wpcEnabled) ? 1 : 0);
+  }
+  if (!from || from->gainceilingIndex != to.gainceilingIndex) s->set_gainceiling(s, gainceilingFromIndex(to.gainceilingIndex));
+  if (!from || from->aeLevel != to.aeLevel) s->set_ae_level(s, to.aeLevel);
+  if (!from || from->aec2 != to.aec2) s->set_aec2(s, to.aec2 ? 1 : 0);
+  if (!from || from->specialEffect != to.specialEffect) s->set_special_effect(s, to.specialEffect);
+  if (kIrLightGpio >= 0 && (!from || from->irLight != to.irLight)) {
+    pinMode(kIrLightGpio, OUTPUT);
+    digitalWrite(kIrLightGpio, to.irLight ? HIGH : LOW);
   }
+}
 
-  bool newActive = (lowLight.score >= kLowLightScoreThreshold);
-  if (newActive != lowLight.active) {
-    lowLight.active = newActive;
-    RefreshLowLightProfileInternal();
-    LOGV("[LowLight] %s (aec=%u gain=%u score=%u)\n", newActive ? "enabled" : "disabled", aecValue, agcGain, lowLight.score);
-    lowLight.lastLogMs = millis();
-  } else if (kVerboseLogging) {
-    unsigned long now = millis();
-    if (now - lowLight.lastLogMs > kLowLightLogIntervalMs) {
-      LOGV("[LowLight] state=%d aec=%u gain=%u score=%u\n", newActive ? 1 : 0, aecValue, agcGain, lowLight.score);
-      lowLight.lastLogMs = now;
+struct Ov2640Window {
+  int mode;  // ov2640_sensor_mode_t: CIF, SVGA, UXGA
+  uint16_t width;
+  uint16_t height;
+};
+
+// Sensor readout modes, smallest first; the DSP can only scale a window down, never up.
+constexpr Ov2640Window kOv2640Windows[] = {
+  {0, 400, 296},
+  {1, 800, 600},
+  {2, 1600, 1200},
+};
+
+uint32_t alignDown4(uint32_t v) {
+  return v & ~3u;
+}
+
+// Programs the OV2640 output window so the sensor reads out and encodes only the ROI. A full ROI
+// (or any other sensor) gets the driver's default window back via set_framesize.
+void applyRoiWindow(sensor_t* s) {
+  auto& camera = app().camera;
+  const RoiWindow roi = camera.roiTarget;
+  bool wasActive = camera.roiActive;
+  camera.roi = roi;
+  camera.roiActive = false;
+  camera.roiOutW = 0;
+  camera.roiOutH = 0;
+  if (!s) return;
+
+  if (roi.full() || s->id.PID != kOv2640Pid || !s->set_res_raw) {
+    if (!roi.full()) LOGE("[CAM] ROI needs an OV2640 (PID=0x%02x), using full frame\n", s->id.PID);
+    if (wasActive) s->set_framesize(s, camera.frameSize);
+    return;
+  }
+
+  const auto& fs = resolution[camera.frameSize];
+  uint32_t outW;
+  uint32_t outH;
+  if (roi.zoom) {
+    // Fit the ROI's aspect (per-mille of a 4:3 array) into the framesize.
+    uint32_t aspectW = roi.w * 4u;
+    uint32_t aspectH = roi.h * 3u;
+    outW = fs.width;
+    outH = outW * aspectH / aspectW;
+    if (outH > fs.height) {
+      outH = fs.height;
+      outW = outH * aspectW / aspectH;
     }
+  } else {
+    outW = static_cast<uint32_t>(fs.width) * roi.w / 1000;
+    outH = static_cast<uint32_t>(fs.height) * roi.h / 1000;
+  }
+
+  // Smallest readout mode whose ROI window still covers the output keeps the frame rate up.
+  const Ov2640Window* mode = &kOv2640Windows[sizeof(kOv2640Windows) / sizeof(kOv2640Windows[0]) - 1];
+  for (const auto& candidate : kOv2640Windows) {
+    if (candidate.width * roi.w / 1000 >= outW && candidate.height * roi.h / 1000 >= outH) {
+      mode = &candidate;
+      break;
+    }
+  }
+  uint32_t winW = alignDown4(mode->width * roi.w / 1000);
+  uint32_t winH = alignDown4(mode->height * roi.h / 1000);
+  if (outW > winW) {
+    outH = outH * winW / outW;
+    outW = winW;
+  }
+  if (outH > winH) {
+    outW = outW * winH / outH;
+    outH = winH;
+  }
+  outW = alignDown4(outW);
+  outH = alignDown4(outH);
+  uint32_t offX = mode->width * roi.x / 1000;
+  uint32_t offY = mode->height * roi.y / 1000;
+  if (offX + winW > mode->width) offX = mode->width - winW;
+  if (offY + winH > mode->height) offY = mode->height - winH;
+
+  if (outW < 16 || outH < 16 ||
+      s->set_res_raw(s, mode->mode, 0, 0, 0, static_cast<int>(offX), static_cast<int>(offY),
+                     static_cast<int>(winW), static_cast<int>(winH),
+                     static_cast<int>(outW), static_cast<int>(outH), false, false) != 0) {
+    LOGE("[CAM] ROI %u,%u,%u,%u rejected, using full frame\n", roi.x, roi.y, roi.w, roi.h);
+    s->set_framesize(s, camera.frameSize);
+    return;
   }
+  camera.roiActive = true;
+  camera.roiOutW = static_cast<uint16_t>(outW);
+  camera.roiOutH = static_cast<uint16_t>(outH);
+  LOGV("[CAM] ROI %u,%u,%u,%u%s -> window %lux%lu+%lu+%lu of mode %d, out %lux%lu\n",
+       roi.x, roi.y, roi.w, roi.h, roi.zoom ? " zoom" : "",
+       static_cast<unsigned long>(winW), static_cast<unsigned long>(winH),
+       static_cast<unsigned long>(offX), static_cast<unsigned long>(offY), mode->mode,
+       static_cast<unsigned long>(outW), static_cast<unsigned long>(outH));
 }
 
-void EvaluateLowLightMetricsInternal() {
-  auto& ctx = app();
-  if (!ctx.lowLight.boostEnabled || !ctx.camera.inited) return;
-  sensor_t* s = esp_camera_sensor_get();
-  if (!s) return;
-  updateLowLightObserver(s->status.aec_value, s->status.agc_gain);
+// Largest frame the two DRAM frame buffers can hold when the board has no PSRAM.
+constexpr framesize_t kDramMaxFrameSize = FRAMESIZE_SVGA;
+
+// Buffers are sized for the larger stream; the smaller one only changes the sensor output.
+// Without PSRAM an archive stream that does not fit DRAM is left out (see archiveFits()).
+framesize_t requiredBufferFrameSize() {
+  const auto& camera = app().camera;
+  framesize_t fs = camera.frameSizeTarget;
+  framesize_t archive = camera.archive.frameSize;
+  if (archive != FRAMESIZE_INVALID && archive > fs && (psramFound() || archive <= kDramMaxFrameSize)) fs = archive;
+  return fs;
 }
 
-void applyAdvancedParams() {
-  sensor_t* s = esp_camera_sensor_get();
-  if (!s) return;
-  applyManualSensorParams(s);
-  auto& ctx = app();
-  if (ctx.lowLight.boostEnabled && ctx.lowLight.active) {
-    applyLowLightProfile(s, true);
+bool archiveFits() {
+  const auto& camera = app().camera;
+  return camera.archive.frameSize != FRAMESIZE_INVALID && camera.archive.frameSize <= camera.bufferFrameSize;
+}
+
+// Reads width/height from the SOF marker; the driver's fb->width only echoes the configured framesize.
+bool jpegDimensions(const uint8_t* buf, size_t len, uint16_t& width, uint16_t& height) {
+  size_t i = 2;
+  if (len < 4 || buf[0] != 0xFF || buf[1] != 0xD8) return false;
+  while (i + 9 < len) {
+    if (buf[i] != 0xFF) return false;
+    uint8_t marker = buf[i + 1];
+    size_t segLen = (static_cast<size_t>(buf[i + 2]) << 8) | buf[i + 3];
+    if (marker >= 0xC0 && marker <= 0xC2) {
+      height = static_cast<uint16_t>((buf[i + 5] << 8) | buf[i + 6]);
+      width = static_cast<uint16_t>((buf[i + 7] << 8) | buf[i + 8]);
+      return true;
+    }
+    if (marker == 0xDA) return false;
+    i += 2 + segLen;
   }
+  return false;
 }
 
-void RefreshLowLightProfileInternal() {
-  auto& ctx = app();
-  if (!ctx.camera.inited) return;
-  sensor_t* s = esp_camera_sensor_get();
+// After a set_framesize/set_res_raw switch the DMA buffers can still hold frames of the old size;
+// drop those (at most fb_count of them) instead of uploading them under the new stream's tag.
+// Returns nullptr when the sensor still delivers the wrong size after that.
+camera_fb_t* grabExpecting(uint16_t width, uint16_t height) {
+  auto& camera = app().camera;
+  bool verify = camera.verifyNextFrame;
+  camera.verifyNextFrame = false;
+  for (int attempt = 0; attempt < 3; ++attempt) {
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (!fb || !verify) return fb;
+    uint16_t w = 0;
+    uint16_t h = 0;
+    if (!jpegDimensions(fb->buf, fb->len, w, h) || (w == width && h == height)) return fb;
+    telemetryCount(TelemetryCounter::StaleFrame);
+    esp_camera_fb_return(fb);
+  }
+  LOGE("[CAM] frame size still not %ux%u after 3 grabs\n", width, height);
+  camera.verifyNextFrame = true;
+  return nullptr;
+}
+
+void expectedAnalysisSize(uint16_t& width, uint16_t& height) {
+  const auto& camera = app().camera;
+  if (camera.roiActive) {
+    width = camera.roiOutW;
+    height = camera.roiOutH;
+  } else {
+    width = resolution[camera.frameSize].width;
+    height = resolution[camera.frameSize].height;
+  }
+}
+
+void restoreAnalysisStream(sensor_t* s) {
+  auto& camera = app().camera;
   if (!s) return;
-  applyManualSensorParams(s);
-  applyLowLightProfile(s, ctx.lowLight.boostEnabled && ctx.lowLight.active);
+  s->set_framesize(s, camera.frameSize);
+  s->set_quality(s, camera.jpegQuality);
+  // set_framesize already put the default window back.
+  camera.roiActive = false;
+  applyRoiWindow(s);
+  camera.verifyNextFrame = true;
 }
 
-void ResetLowLightStateInternal() {
-  auto& ctx = app();
-  ctx.lowLight.score = 0;
-  ctx.lowLight.active = false;
-  RefreshLowLightProfileInternal();
+void applyAdvancedParams() {
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s) return;
+  applyManualSensorParams(s);
+  writeSceneRegisters(s, nullptr, sceneRegistersFor(app().scene.mode));
 }
 
 bool initCameraWithXclk(int xclkHz) {
@@ -225,7 +364,8 @@ bool initCameraWithXclk(int xclkHz) {
   config.xclk_freq_hz = xclkHz;
   config.pixel_format = PIXFORMAT_JPEG;
 
-  config.frame_size   = camera.frameSize;
+  camera.bufferFrameSize = requiredBufferFrameSize();
+  config.frame_size   = camera.bufferFrameSize;
   config.jpeg_quality = camera.jpegQuality;
   config.fb_count     = 2;
   config.fb_location  = psramFound() ? CAMERA_FB_IN_PSRAM : CAMERA_FB_IN_DRAM;
@@ -242,11 +382,15 @@ bool initCameraWithXclk(int xclkHz) {
   if (s) {
     s->set_framesize(s, camera.frameSize);
     s->set_quality(s, camera.jpegQuality);
+    camera.verifyNextFrame = camera.bufferFrameSize != camera.frameSize;
+    // A fresh init always starts from the default window.
+    camera.roiActive = false;
+    applyRoiWindow(s);
   }
   camera.inited = true;
-  LOGV("[CAM] init ok @%dHz, %s, q=%d\n", xclkHz, labelFromFramesize(camera.frameSize), camera.jpegQuality);
+  LOGV("[CAM] init ok @%dHz, %s, q=%d, buffers %s\n", xclkHz, labelFromFramesize(camera.frameSize),
+       camera.jpegQuality, labelFromFramesize(camera.bufferFrameSize));
   applyAdvancedParams();
-  RefreshLowLightProfileInternal();
   return true;
 }
 
@@ -258,6 +402,7 @@ void maybeReinitLowerXclk() {
   else if (camera.currentXclkHz > 10000000) next = 10000000;
   if (next != camera.currentXclkHz) {
     LOGV("[CAM] re-init lower XCLK: %d -> %d\n", camera.currentXclkHz, next);
+    telemetryCount(TelemetryCounter::XclkReinit);
     esp_camera_deinit();
     camera.inited = false;
     delay(200);
@@ -267,17 +412,56 @@ void maybeReinitLowerXclk() {
 
 }  // namespace
 
-void evaluateLowLightMetrics() {
-  EvaluateLowLightMetricsInternal();
+void refreshSceneRegisters() {
+  if (!app().camera.inited) return;
+  applyAdvancedParams();
 }
 
+void applySceneTransition(SceneMode from, SceneMode to) {
+  auto& camera = app().camera;
+  if (!camera.inited) return;
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s) return;
+  SceneRegisters prev = sceneRegistersFor(from);
+  writeSceneRegisters(s, &prev, sceneRegistersFor(to));
+  // The frame already sitting in the DMA buffer was exposed with the old registers.
+  camera.discardNextFrame = true;
+}
 
-void refreshLowLightProfile() {
-  RefreshLowLightProfileInternal();
+bool readSensorExposure(uint16_t& aecValue, uint8_t& agcGain) {
+  if (!app().camera.inited) return false;
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s) return false;
+  if (s->id.PID == kOv2640Pid && s->get_reg) {
+    // Live AEC/AGC from the sensor bank (0x100 | reg); status only mirrors the last manual write.
+    int reg04 = s->get_reg(s, 0x104, 0x03);
+    int reg10 = s->get_reg(s, 0x110, 0xFF);
+    int reg45 = s->get_reg(s, 0x145, 0x3F);
+    int gain = s->get_reg(s, 0x100, 0xFF);
+    if (reg04 >= 0 && reg10 >= 0 && reg45 >= 0 && gain >= 0) {
+      uint32_t aec = (static_cast<uint32_t>(reg45) << 10) | (static_cast<uint32_t>(reg10) << 2) | static_cast<uint32_t>(reg04);
+      aecValue = aec > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(aec);
+      // Each of bits 7..4 doubles the gain, bits 3..0 add n/16; map onto the 0..30 agc_gain scale.
+      int doublings = ((gain >> 4) & 1) + ((gain >> 5) & 1) + ((gain >> 6) & 1) + ((gain >> 7) & 1);
+      int index = doublings * 6 + ((gain & 0x0F) * 6 + 8) / 16;
+      agcGain = static_cast<uint8_t>(index > 30 ? 30 : index);
+      return true;
+    }
+  }
+  aecValue = s->status.aec_value;
+  agcGain = s->status.agc_gain;
+  return true;
 }
 
-void resetLowLightState() {
-  ResetLowLightStateInternal();
+void setRoiTarget(long x, long y, long w, long h, bool zoom) {
+  RoiWindow roi;
+  // At least 5% per side; the window must stay inside the frame.
+  roi.w = static_cast<uint16_t>(constrain(w, 50L, 1000L));
+  roi.h = static_cast<uint16_t>(constrain(h, 50L, 1000L));
+  roi.x = static_cast<uint16_t>(constrain(x, 0L, 1000L - roi.w));
+  roi.y = static_cast<uint16_t>(constrain(y, 0L, 1000L - roi.h));
+  roi.zoom = zoom && !roi.full();
+  app().camera.roiTarget = roi;
 }
 
 bool initCamera() {
@@ -289,14 +473,45 @@ bool initCamera() {
   return false;
 }
 
+// Light sleep gates XCLK and the I2S DMA, which would tear the frame in flight and leave stale
+// ones in the buffers; the camera is off for the idle stretch instead.
+void cameraPowerDown() {
+  auto& camera = app().camera;
+  if (!camera.inited) return;
+  esp_camera_deinit();
+  camera.inited = false;
+  camera.poweredDown = true;
+  LOGV_LN("[CAM] off for light sleep");
+}
+
+bool cameraPowerUp() {
+  auto& camera = app().camera;
+  if (!camera.poweredDown) return camera.inited;
+  camera.poweredDown = false;
+  // On failure the loop retries like any other failed init.
+  if (!initCamera()) return false;
+  // A fresh sensor's first frame is still settling exposure.
+  camera.discardNextFrame = true;
+  applyConfigIfNeeded();
+  return true;
+}
+
+bool cameraAvailable() {
+  const auto& camera = app().camera;
+  return camera.inited || camera.poweredDown;
+}
+
 void applyConfigIfNeeded() {
   auto& ctx = app();
   auto& camera = ctx.camera;
   if (!camera.inited) return;
 
-  bool needReinit = (camera.frameSizeTarget != camera.frameSize);
+  // Only a change of buffer size needs esp_camera_init; a smaller stream is a sensor setting.
+  bool needReinit = (requiredBufferFrameSize() != camera.bufferFrameSize);
   if (needReinit) {
-    LOGV("[CFG] reinit FS: %s -> %s\n", labelFromFramesize(camera.frameSize), labelFromFramesize(camera.frameSizeTarget));
+    LOGV("[CFG] reinit FS: %s -> %s (buffers %s -> %s)\n", labelFromFramesize(camera.frameSize),
+         labelFromFramesize(camera.frameSizeTarget), labelFromFramesize(camera.bufferFrameSize),
+         labelFromFramesize(requiredBufferFrameSize()));
     esp_camera_deinit();
     camera.inited = false;
     camera.frameSize = camera.frameSizeTarget;
@@ -307,6 +522,15 @@ void applyConfigIfNeeded() {
       LOGE_LN("[CFG] reinit failed");
       return;
     }
+  } else if (camera.frameSizeTarget != camera.frameSize) {
+    sensor_t* s = esp_camera_sensor_get();
+    if (s) {
+      LOGV("[CFG] set FS: %s -> %s\n", labelFromFramesize(camera.frameSize), labelFromFramesize(camera.frameSizeTarget));
+      camera.frameSize = camera.frameSizeTarget;
+      camera.frameSizeKey = camera.frameSizeKeyTarget;
+      camera.jpegQuality = camera.jpegQualityTarget;
+      restoreAnalysisStream(s);
+    }
   } else if (camera.jpegQualityTarget != camera.jpegQuality) {
     sensor_t* s = esp_camera_sensor_get();
     if (s) {
@@ -315,23 +539,46 @@ void applyConfigIfNeeded() {
       LOGV("[CFG] set q=%d\n", camera.jpegQuality);
     }
   }
+  if (!needReinit && camera.roiTarget != camera.roi) {
+    applyRoiWindow(esp_camera_sensor_get());
+    camera.verifyNextFrame = true;
+  }
 
   applyAdvancedParams();
-  if (!ctx.lowLight.boostEnabled) {
-    ResetLowLightStateInternal();
-  } else {
-    RefreshLowLightProfileInternal();
-  }
 }
 
 camera_fb_t* safeGrab() {
   auto& ctx = app();
   auto& camera = ctx.camera;
 
-  camera_fb_t* fb = esp_camera_fb_get();
+  if (camera.discardNextFrame) {
+    camera.discardNextFrame = false;
+    camera_fb_t* stale = esp_camera_fb_get();
+    if (stale) esp_camera_fb_return(stale);
+  }
+
+  uint16_t width = 0;
+  uint16_t height = 0;
+  expectedAnalysisSize(width, height);
+  camera_fb_t* fb = grabExpecting(width, height);
+  if (fb && camera.freshAfterUs) {
+    // Event capture: frames that started exposing before the trigger are already in the DMA
+    // buffers (up to fb_count of them); the driver stamps each with esp_timer time at VSYNC.
+    for (int drop = 0; fb && drop < 2; ++drop) {
+      int64_t startedUs = static_cast<int64_t>(fb->timestamp.tv_sec) * 1000000LL + fb->timestamp.tv_usec;
+      if (startedUs >= camera.freshAfterUs) break;
+      telemetryCount(TelemetryCounter::StaleFrame);
+      esp_camera_fb_return(fb);
+      fb = esp_camera_fb_get();
+    }
+    camera.freshAfterUs = 0;
+  }
   if (fb) {
     camera.failedGrabStreak = 0;
     camera.lastUsedFrameSizeKey = keyFromFramesize(camera.frameSize);
+    camera.lastFrameQuality = camera.jpegQuality;
+    camera.lastFrameStream = FrameStream::Analysis;
+    camera.lastFrameRoi = camera.roiActive;
     return fb;
   }
 
@@ -350,14 +597,23 @@ camera_fb_t* safeGrab() {
       camera_fb_t* fb2 = esp_camera_fb_get();
       if (fb2) {
         camera.lastUsedFrameSizeKey = keyFromFramesize(fs);
+        camera.lastFrameQuality = camera.jpegQuality;
+        camera.lastFrameStream = FrameStream::Analysis;
+        camera.lastFrameRoi = false;
         s->set_framesize(s, wanted);
+        if (camera.roiActive) applyRoiWindow(s);
+        camera.verifyNextFrame = true;
         camera.failedGrabStreak = 0;
+        telemetryCount(TelemetryCounter::FallbackFrame);
         return fb2;
       }
     }
     s->set_framesize(s, wanted);
+    if (camera.roiActive) applyRoiWindow(s);
+    camera.verifyNextFrame = true;
   }
 
+  telemetryCount(TelemetryCounter::GrabFail);
   unsigned long now = millis();
   if (camera.failedGrabStreak >= 3 && now - camera.lastReinitMs > 7000) {
     camera.lastReinitMs = now;
@@ -365,3 +621,48 @@ camera_fb_t* safeGrab() {
   }
   return nullptr;
 }
+
+void requestArchiveFrame() {
+  // With archiving off a request would stay pending and fire whenever the stream is turned on.
+  app().camera.archive.requested = archiveFits();
+}
+
+bool archiveFrameDue() {
+  const auto& camera = app().camera;
+  const auto& archive = camera.archive;
+  if (!camera.inited || !archiveFits()) return false;
+  if (archive.requested) return true;
+  if (archive.intervalSec == 0) return false;
+  return archive.lastMs == 0 || millis() - archive.lastMs >= archive.intervalSec * 1000UL;
+}
+
+camera_fb_t* grabArchiveFrame() {
+  auto& camera = app().camera;
+  auto& archive = camera.archive;
+  if (!camera.inited || !archiveFits()) return nullptr;
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s) return nullptr;
+
+  // Same init, bigger output: the buffers were sized for the archive stream up front.
+  s->set_framesize(s, archive.frameSize);
+  s->set_quality(s, archive.jpegQuality);
+  camera.roiActive = false;
+  camera.verifyNextFrame = true;
+  camera_fb_t* fb = grabExpecting(resolution[archive.frameSize].width, resolution[archive.frameSize].height);
+  archive.requested = false;
+  archive.lastMs = millis();
+  if (!fb) {
+    restoreAnalysisStream(s);
+    return nullptr;
+  }
+  camera.lastUsedFrameSizeKey = archive.frameSizeKey;
+  camera.lastFrameQuality = archive.jpegQuality;
+  camera.lastFrameStream = FrameStream::Archive;
+  camera.lastFrameRoi = false;
+  return fb;
+}
+
+void releaseArchiveFrame(camera_fb_t* fb) {
+  if (fb) esp_camera_fb_return(fb);
+  restoreAnalysisStream(esp_camera_sensor_get());
+}
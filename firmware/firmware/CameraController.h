@@ -2,9 +2,19 @@
 
 #include "esp_camera.h"
 
-void refreshLowLightProfile();
-void resetLowLightState();
-void evaluateLowLightMetrics();
+#include "AppContext.h"
+
+void refreshSceneRegisters();
+void applySceneTransition(SceneMode from, SceneMode to);
+bool readSensorExposure(uint16_t& aecValue, uint8_t& agcGain);
+void setRoiTarget(long x, long y, long w, long h, bool zoom);
 bool initCamera();
+void cameraPowerDown();
+bool cameraPowerUp();
+bool cameraAvailable();
 void applyConfigIfNeeded();
-camera_fb_t* safeGrab();
\ No newline at end of file
+camera_fb_t* safeGrab();
+void requestArchiveFrame();
+bool archiveFrameDue();
+camera_fb_t* grabArchiveFrame();
+void releaseArchiveFrame(camera_fb_t* fb);
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "CaptureSchedule.h"
+
+#include <Arduino.h>
+#include <time.h>
+
+#include "AppContext.h"
+#include "CameraController.h"
+#include "ConfigStorage.h"
+#include "Logging.h"
+#include "Scheduler.h"
+
+// days:startMin:endMin:intervalSec:framesize:quality:autoUpload;... ("-" keeps the base value).
+// Windows are tried in order, the first match wins; "none" clears the schedule.
+
+namespace {
+// Windows are minute-aligned; a few seconds of lag at a boundary is fine.
+constexpr unsigned long kScheduleEvalMs = 5000UL;
+
+bool keep(const String& field) {
+  return field.length() == 0 || field == "-";
+}
+
+bool parseWindow(const String& item, ScheduleWindow& window) {
+  String fields[7];
+  int start = 0;
+  for (int i = 0; i < 7; ++i) {
+    if (start > static_cast<int>(item.length())) return false;
+    int end = item.indexOf(':', start);
+    if (end < 0) end = item.length();
+    fields[i] = item.substring(start, end);
+    fields[i].trim();
+    start = end + 1;
+  }
+  if (start <= static_cast<int>(item.length())) return false;
+
+  window = ScheduleWindow{};
+  window.days = static_cast<uint8_t>(constrain(fields[0].toInt(), 0L, 0x7FL));
+  window.startMin = static_cast<uint16_t>(constrain(fields[1].toInt(), 0L, 1439L));
+  window.endMin = static_cast<uint16_t>(constrain(fields[2].toInt(), 0L, 1440L));
+  if (window.days == 0) return false;
+  if (!keep(fields[3])) window.intervalSec = static_cast<uint32_t>(constrain(fields[3].toInt(), 1L, 3600L));
+  if (!keep(fields[4])) window.frameSize = framesizeFromKey(fields[4]);
+  if (!keep(fields[5])) window.jpegQuality = static_cast<int8_t>(constrain(fields[5].toInt(), 5L, 63L));
+  if (!keep(fields[6])) window.autoUpload = fields[6].toInt() != 0 ? 1 : 0;
+  return true;
+}
+
+bool dayEnabled(const ScheduleWindow& window, int wday) {
+  return (window.days >> (wday % 7)) & 1;
+}
+
+bool windowContains(const ScheduleWindow& window, int wday, uint16_t minute) {
+  if (window.startMin < window.endMin) {
+    return dayEnabled(window, wday) && minute >= window.startMin && minute < window.endMin;
+  }
+  // Overnight window: the part after midnight belongs to the day it started on.
+  if (minute >= window.startMin) return dayEnabled(window, wday);
+  return minute < window.endMin && dayEnabled(window, wday + 6);
+}
+}  // namespace
+
+bool scheduleParse(const String& spec) {
+  ScheduleWindow parsed[kScheduleMaxWindows];
+  uint8_t count = 0;
+  int start = 0;
+  while (start < static_cast<int>(spec.length())) {
+    int end = spec.indexOf(';', start);
+    if (end < 0) end = spec.length();
+    String item = spec.substring(start, end);
+    item.trim();
+    start = end + 1;
+    if (!item.length() || item == "none") continue;
+    if (count >= kScheduleMaxWindows) {
+      LOGE("[Sched] more than %u windows, rest ignored\n", static_cast<unsigned>(kScheduleMaxWindows));
+      break;
+    }
+    if (!parseWindow(item, parsed[count])) {
+      LOGE("[Sched] bad window '%s'\n", item.c_str());
+      return false;
+    }
+    count++;
+  }
+
+  auto& schedule = app().schedule;
+  for (uint8_t i = 0; i < count; ++i) schedule.windows[i] = parsed[i];
+  schedule.count = count;
+  schedule.spec = spec;
+  // Re-evaluated against the new windows on the next tick (or right away by the config path).
+  schedule.lastEvalMs = 0;
+  return true;
+}
+
+int8_t scheduleActiveWindow() {
+  const auto& schedule = app().schedule;
+  // Without a valid wall clock a window cannot be placed; the base config is the safe choice.
+  if (schedule.count == 0 || !wallClockValid()) return -1;
+  time_t now = time(nullptr);
+  struct tm local;
+  localtime_r(&now, &local);
+  uint16_t minute = static_cast<uint16_t>(local.tm_hour * 60 + local.tm_min);
+  for (uint8_t i = 0; i < schedule.count; ++i) {
+    if (windowContains(schedule.windows[i], local.tm_wday, minute)) return static_cast<int8_t>(i);
+  }
+  return -1;
+}
+
+void scheduleApplyProfile(int8_t window) {
+  auto& ctx = app();
+  auto& schedule = ctx.schedule;
+  const auto& base = schedule.base;
+  uint32_t intervalSec = base.intervalSec;
+  framesize_t frameSize = base.frameSize;
+  int jpegQuality = base.jpegQuality;
+  bool autoUpload = base.autoUpload;
+  if (window >= 0 && window < schedule.count) {
+    const auto& w = schedule.windows[window];
+    if (w.intervalSec) intervalSec = w.intervalSec;
+    if (w.frameSize != FRAMESIZE_INVALID) frameSize = w.frameSize;
+    if (w.jpegQuality >= 0) jpegQuality = w.jpegQuality;
+    if (w.autoUpload >= 0) autoUpload = w.autoUpload != 0;
+  } else {
+    window = -1;
+  }
+
+  if (window != schedule.active) {
+    LOGV("[Sched] window %d -> %d: int=%lus fs=%s q=%d auto=%d\n", schedule.active, window,
+         static_cast<unsigned long>(intervalSec), keyFromFramesize(frameSize), jpegQuality, autoUpload ? 1 : 0);
+  }
+  schedule.active = window;
+  ctx.upload.intervalSec = intervalSec;
+  ctx.upload.autoUpload = autoUpload;
+  ctx.camera.frameSizeTarget = frameSize;
+  ctx.camera.frameSizeKeyTarget = keyFromFramesize(frameSize);
+  ctx.camera.jpegQualityTarget = jpegQuality;
+}
+
+void scheduleTick() {
+  auto& ctx = app();
+  auto& schedule = ctx.schedule;
+  unsigned long now = millis();
+  if (schedule.lastEvalMs && now - schedule.lastEvalMs < kScheduleEvalMs) return;
+  schedule.lastEvalMs = now;
+
+  int8_t window = scheduleActiveWindow();
+  if (window == schedule.active) return;
+  uint32_t oldInterval = ctx.upload.intervalSec;
+  bool oldAuto = ctx.upload.autoUpload;
+  scheduleApplyProfile(window);
+  applyConfigIfNeeded();
+  // Move onto the new grid at once; a night interval of 10 min must not delay the morning's first frame.
+  if (ctx.upload.intervalSec != oldInterval || (ctx.upload.autoUpload && !oldAuto)) {
+    ctx.upload.nextUploadMs = nextAlignedMillis(ctx.upload.intervalSec * 1000UL, ctx.upload.phaseMs);
+  }
+}
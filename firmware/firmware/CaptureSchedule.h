@@ -0,0 +1,8 @@
+#pragma once
+
+#include <Arduino.h>
+
+bool scheduleParse(const String& spec);
+int8_t scheduleActiveWindow();
+void scheduleApplyProfile(int8_t window);
+void scheduleTick();
@@ -2,7 +2,10 @@
 
 #include "AppContext.h"
 #include "CameraController.h"
+#include "CaptureSchedule.h"
+#include "EventTrigger.h"
 #include "Logging.h"
+#include "SceneEngine.h"
 
 namespace {
 struct FsItem {
@@ -75,6 +78,7 @@ void loadPrefs() {
   ctx.network.password = ctx.prefs.getString("wifi_pass", "");
   ctx.backend.baseUrl = ctx.prefs.getString("be_url", "");
   ctx.backend.token = ctx.prefs.getString("be_tok", "");
+  ctx.backend.caCert = ctx.prefs.getString("be_ca", "");
   ctx.upload.apiUrl = ctx.prefs.getString("api_url", "");
   ctx.upload.apiToken = ctx.prefs.getString("api_token", "");
   camera.jpegQuality = ctx.prefs.getInt("jpeg_q", 12);
@@ -103,7 +107,23 @@ void loadPrefs() {
   tuning.dcwEnabled = ctx.prefs.getBool("dcw", true);
   tuning.colorbarEnabled = ctx.prefs.getBool("clb", false);
   tuning.specialEffect = ctx.prefs.getInt("spe", 0);
-  ctx.lowLight.boostEnabled = ctx.prefs.getBool("low_light", true);
+  ctx.scene.enabled = ctx.prefs.getBool("low_light", true);
+  String sceneProfiles = ctx.prefs.getString("scene", kDefaultSceneProfiles);
+  long roiX = ctx.prefs.getInt("roi_x", 0);
+  long roiY = ctx.prefs.getInt("roi_y", 0);
+  long roiW = ctx.prefs.getInt("roi_w", 1000);
+  long roiH = ctx.prefs.getInt("roi_h", 1000);
+  bool roiZoom = ctx.prefs.getBool("roi_z", false);
+  camera.archive.frameSizeKey = ctx.prefs.getString("arc_fs", "OFF");
+  camera.archive.jpegQuality = ctx.prefs.getInt("arc_q", 10);
+  camera.archive.intervalSec = ctx.prefs.getUInt("arc_int", 300);
+  int triggerGpio = ctx.prefs.getInt("trg_gpio", -1);
+  bool triggerActiveHigh = ctx.prefs.getBool("trg_hi", true);
+  ctx.trigger.cooldownMs = ctx.prefs.getUInt("trg_cd", 2000);
+  ctx.trigger.lightSleep = ctx.prefs.getBool("trg_sleep", false);
+  ctx.clock.tz = ctx.prefs.getString("tz", ctx.clock.tz);
+  ctx.clock.ntpServer = ctx.prefs.getString("ntp", ctx.clock.ntpServer);
+  String schedule = ctx.prefs.getString("sched", "");
   ctx.prefs.end();
   if (ctx.upload.apiUrl.isEmpty() && !ctx.backend.baseUrl.isEmpty()) {
     ctx.upload.apiUrl = defaultUploadUrl(ctx.backend.baseUrl);
@@ -112,6 +132,10 @@ void loadPrefs() {
   camera.frameSize = framesizeFromKey(camera.frameSizeKey);
   camera.frameSizeTarget = camera.frameSize;
   camera.frameSizeKeyTarget = camera.frameSizeKey;
+  camera.archive.frameSize = camera.archive.frameSizeKey.equalsIgnoreCase("OFF")
+                                 ? FRAMESIZE_INVALID
+                                 : framesizeFromKey(camera.archive.frameSizeKey);
+  camera.archive.jpegQuality = constrain(camera.archive.jpegQuality, 5, 63);
 
   if (camera.jpegQuality < 5) camera.jpegQuality = 5;
   if (camera.jpegQuality > 63) camera.jpegQuality = 63;
@@ -120,6 +144,14 @@ void loadPrefs() {
   if (ctx.upload.intervalSec < 1) ctx.upload.intervalSec = 1;
   if (ctx.upload.intervalSec > 3600) ctx.upload.intervalSec = 3600;
 
+  // The stored values are the base profile; a schedule window is laid over them once the clock is set.
+  auto& base = ctx.schedule.base;
+  base.intervalSec = ctx.upload.intervalSec;
+  base.frameSize = camera.frameSize;
+  base.jpegQuality = camera.jpegQuality;
+  base.autoUpload = ctx.upload.autoUpload;
+  scheduleParse(schedule);
+
   tuning.brightness = constrain(tuning.brightness, -2, 2);
   tuning.contrast   = constrain(tuning.contrast,   -2, 2);
   tuning.saturation = constrain(tuning.saturation, -2, 2);
@@ -129,8 +161,11 @@ void loadPrefs() {
   if (tuning.gainceilingIndex > 5) tuning.gainceilingIndex = 5;
 
   target = tuning;
+  setRoiTarget(roiX, roiY, roiW, roiH, roiZoom);
+  eventTriggerConfigure(triggerGpio, triggerActiveHigh);
 
-  resetLowLightState();
+  if (!sceneParseProfiles(sceneProfiles)) sceneParseProfiles(kDefaultSceneProfiles);
+  sceneReset();
 }
 
 void savePrefs() {
@@ -143,12 +178,15 @@ void savePrefs() {
   ctx.prefs.putString("wifi_pass", ctx.network.password);
   ctx.prefs.putString("be_url", ctx.backend.baseUrl);
   ctx.prefs.putString("be_tok", ctx.backend.token);
+  ctx.prefs.putString("be_ca", ctx.backend.caCert);
   ctx.prefs.putString("api_url", ctx.upload.apiUrl);
   ctx.prefs.putString("api_token", ctx.upload.apiToken);
-  ctx.prefs.putInt("jpeg_q", camera.jpegQualityTarget);
-  ctx.prefs.putString("fs_key", camera.frameSizeKeyTarget);
-  ctx.prefs.putBool("auto_up", ctx.upload.autoUpload);
-  ctx.prefs.putUInt("up_int", ctx.upload.intervalSec);
+  // Base profile, not whatever schedule window happens to be active right now
+  const auto& base = ctx.schedule.base;
+  ctx.prefs.putInt("jpeg_q", base.jpegQuality);
+  ctx.prefs.putString("fs_key", keyFromFramesize(base.frameSize));
+  ctx.prefs.putBool("auto_up", base.autoUpload);
+  ctx.prefs.putUInt("up_int", base.intervalSec);
   ctx.prefs.putUInt("cfg_rev", ctx.backend.revision);
 
   ctx.prefs.putBool("awb", target.whitebal);
@@ -171,6 +209,22 @@ void savePrefs() {
   ctx.prefs.putBool("dcw", target.dcwEnabled);
   ctx.prefs.putBool("clb", target.colorbarEnabled);
   ctx.prefs.putInt("spe", target.specialEffect);
-  ctx.prefs.putBool("low_light", ctx.lowLight.boostEnabled);
+  ctx.prefs.putBool("low_light", ctx.scene.enabled);
+  ctx.prefs.putString("scene", ctx.scene.profileSpec);
+  ctx.prefs.putInt("roi_x", camera.roiTarget.x);
+  ctx.prefs.putInt("roi_y", camera.roiTarget.y);
+  ctx.prefs.putInt("roi_w", camera.roiTarget.w);
+  ctx.prefs.putInt("roi_h", camera.roiTarget.h);
+  ctx.prefs.putBool("roi_z", camera.roiTarget.zoom);
+  ctx.prefs.putString("arc_fs", camera.archive.frameSizeKey);
+  ctx.prefs.putInt("arc_q", camera.archive.jpegQuality);
+  ctx.prefs.putUInt("arc_int", camera.archive.intervalSec);
+  ctx.prefs.putInt("trg_gpio", ctx.trigger.gpio);
+  ctx.prefs.putBool("trg_hi", ctx.trigger.activeHigh);
+  ctx.prefs.putUInt("trg_cd", ctx.trigger.cooldownMs);
+  ctx.prefs.putBool("trg_sleep", ctx.trigger.lightSleep);
+  ctx.prefs.putString("tz", ctx.clock.tz);
+  ctx.prefs.putString("ntp", ctx.clock.ntpServer);
+  ctx.prefs.putString("sched", ctx.schedule.spec);
   ctx.prefs.end();
 }
@@ -0,0 +1,216 @@
+#include "DeltaPatch.h"
+
+#include <string.h>
+
+namespace {
+constexpr uint8_t kOpEnd = 0;
+constexpr uint8_t kOpDiff = 1;
+constexpr uint8_t kOpInsert = 2;
+constexpr size_t kLitChunk = 64;
+
+uint32_t readLe32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+DeltaPatchStatus fail(DeltaPatchState& state, const char* error) {
+  state.phase = DeltaPhase::Failed;
+  state.error = error;
+  return DeltaPatchStatus::Error;
+}
+
+bool flush(DeltaPatchState& state) {
+  if (!state.outFill) return true;
+  bool ok = state.io.writeNew(state.io.ctx, state.out, state.outFill);
+  state.outFill = 0;
+  return ok;
+}
+
+// Room in the output buffer, flushing first when it is full.
+size_t outSpace(DeltaPatchState& state) {
+  if (state.outFill == kDeltaOutBufferSize && !flush(state)) return 0;
+  return kDeltaOutBufferSize - state.outFill;
+}
+
+// Returns true once the varint is complete; a varint longer than 32 bits fails the patch.
+bool takeVarint(DeltaPatchState& state, uint8_t byte, bool& overflow) {
+  // The fifth byte carries bits 28..31 only; anything above would be shifted out silently.
+  if (state.varintShift > 28 || (state.varintShift == 28 && (byte & 0x70))) {
+    overflow = true;
+    return false;
+  }
+  state.varint |= static_cast<uint32_t>(byte & 0x7F) << state.varintShift;
+  if (byte & 0x80) {
+    state.varintShift += 7;
+    return false;
+  }
+  return true;
+}
+
+void startVarint(DeltaPatchState& state, DeltaPhase next) {
+  state.varint = 0;
+  state.varintShift = 0;
+  state.phase = next;
+}
+
+// An op may only produce what is still missing from the new image.
+bool reserveOutput(DeltaPatchState& state, uint32_t length) {
+  if (length > state.newSize - state.produced) return false;
+  state.produced += length;
+  return true;
+}
+
+bool copyOld(DeltaPatchState& state, uint32_t length) {
+  while (length) {
+    size_t space = outSpace(state);
+    if (!space) return false;
+    size_t n = length < space ? length : space;
+    if (!state.io.readOld(state.io.ctx, state.opOffset, state.out + state.outFill, n)) return false;
+    state.outFill += n;
+    state.opOffset += n;
+    length -= n;
+  }
+  return true;
+}
+
+void nextRunOrOp(DeltaPatchState& state) {
+  startVarint(state, state.opRemain ? DeltaPhase::RunZeros : DeltaPhase::Opcode);
+}
+}  // namespace
+
+void deltaPatchBegin(DeltaPatchState& state, const DeltaPatchIo& io) {
+  state = DeltaPatchState();
+  state.io = io;
+}
+
+DeltaPatchStatus deltaPatchFeed(DeltaPatchState& state, const uint8_t* data, size_t len) {
+  size_t pos = 0;
+  while (pos < len) {
+    bool overflow = false;
+    switch (state.phase) {
+      case DeltaPhase::Header: {
+        size_t n = kDeltaHeaderSize - state.headerFill;
+        if (n > len - pos) n = len - pos;
+        memcpy(state.header + state.headerFill, data + pos, n);
+        state.headerFill += n;
+        pos += n;
+        if (state.headerFill < kDeltaHeaderSize) break;
+        if (memcmp(state.header, "HDP1", 4) != 0) return fail(state, "bad magic");
+        state.oldSize = readLe32(state.header + 4);
+        state.newSize = readLe32(state.header + 8);
+        memcpy(state.newSha256, state.header + 44, sizeof(state.newSha256));
+        if (state.io.checkBase && !state.io.checkBase(state.io.ctx, state.oldSize, state.header + 12)) {
+          return fail(state, "base image mismatch");
+        }
+        state.phase = DeltaPhase::Opcode;
+        break;
+      }
+
+      case DeltaPhase::Opcode: {
+        uint8_t op = data[pos++];
+        if (op == kOpEnd) {
+          if (!flush(state)) return fail(state, "write failed");
+          if (state.produced != state.newSize) return fail(state, "short output");
+          state.phase = DeltaPhase::Done;
+        } else if (op == kOpDiff) {
+          startVarint(state, DeltaPhase::DiffOffset);
+        } else if (op == kOpInsert) {
+          startVarint(state, DeltaPhase::InsertLength);
+        } else {
+          return fail(state, "unknown op");
+        }
+        break;
+      }
+
+      case DeltaPhase::DiffOffset:
+        if (!takeVarint(state, data[pos++], overflow)) break;
+        state.opOffset = state.varint;
+        startVarint(state, DeltaPhase::DiffLength);
+        break;
+
+      case DeltaPhase::DiffLength:
+        if (!takeVarint(state, data[pos++], overflow)) break;
+        state.opRemain = state.varint;
+        if (state.opOffset > state.oldSize || state.opRemain > state.oldSize - state.opOffset) {
+          return fail(state, "diff outside base image");
+        }
+        if (!reserveOutput(state, state.opRemain)) return fail(state, "output overflow");
+        nextRunOrOp(state);
+        break;
+
+      case DeltaPhase::RunZeros:
+        if (!takeVarint(state, data[pos++], overflow)) break;
+        if (state.varint > state.opRemain) return fail(state, "diff run overflow");
+        state.runZeros = state.varint;
+        state.opRemain -= state.runZeros;
+        // The zero run is a plain copy of old bytes and needs no further input.
+        if (!copyOld(state, state.runZeros)) return fail(state, "flash I/O failed");
+        startVarint(state, DeltaPhase::RunLits);
+        break;
+
+      case DeltaPhase::RunLits:
+        if (!takeVarint(state, data[pos++], overflow)) break;
+        if (state.varint > state.opRemain) return fail(state, "diff run overflow");
+        if (!state.varint && !state.runZeros) return fail(state, "empty diff run");
+        state.runLits = state.varint;
+        state.opRemain -= state.runLits;
+        if (state.runLits) {
+          state.phase = DeltaPhase::RunLitBytes;
+        } else {
+          nextRunOrOp(state);
+        }
+        break;
+
+      case DeltaPhase::RunLitBytes: {
+        uint8_t old[kLitChunk];
+        size_t n = state.runLits;
+        if (n > len - pos) n = len - pos;
+        if (n > kLitChunk) n = kLitChunk;
+        size_t space = outSpace(state);
+        if (!space) return fail(state, "write failed");
+        if (n > space) n = space;
+        if (!state.io.readOld(state.io.ctx, state.opOffset, old, n)) return fail(state, "flash I/O failed");
+        for (size_t i = 0; i < n; ++i) {
+          state.out[state.outFill + i] = static_cast<uint8_t>(old[i] + data[pos + i]);
+        }
+        state.outFill += n;
+        state.opOffset += n;
+        state.runLits -= n;
+        pos += n;
+        if (!state.runLits) nextRunOrOp(state);
+        break;
+      }
+
+      case DeltaPhase::InsertLength:
+        if (!takeVarint(state, data[pos++], overflow)) break;
+        state.opRemain = state.varint;
+        if (!reserveOutput(state, state.opRemain)) return fail(state, "output overflow");
+        state.phase = state.opRemain ? DeltaPhase::InsertBytes : DeltaPhase::Opcode;
+        break;
+
+      case DeltaPhase::InsertBytes: {
+        size_t n = state.opRemain;
+        if (n > len - pos) n = len - pos;
+        size_t space = outSpace(state);
+        if (!space) return fail(state, "write failed");
+        if (n > space) n = space;
+        memcpy(state.out + state.outFill, data + pos, n);
+        state.outFill += n;
+        state.opRemain -= n;
+        pos += n;
+        if (!state.opRemain) state.phase = DeltaPhase::Opcode;
+        break;
+      }
+
+      case DeltaPhase::Done:
+        return fail(state, "data after END");
+
+      case DeltaPhase::Failed:
+        return DeltaPatchStatus::Error;
+    }
+    if (overflow) return fail(state, "bad varint");
+  }
+  if (state.phase == DeltaPhase::Done) return DeltaPatchStatus::Done;
+  if (state.phase == DeltaPhase::Failed) return DeltaPatchStatus::Error;
+  return DeltaPatchStatus::NeedMore;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// Streaming applier for the backend's HDP1 firmware delta (backend/core/delta.py).
+// Plain C++ with no Arduino or IDF dependencies so the same file builds on a host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr size_t kDeltaHeaderSize = 4 + 4 + 4 + 32 + 32;
+constexpr size_t kDeltaOutBufferSize = 1024;
+
+enum class DeltaPatchStatus : uint8_t {
+  NeedMore,
+  Done,
+  Error,
+};
+
+enum class DeltaPhase : uint8_t {
+  Header,
+  Opcode,
+  DiffOffset,
+  DiffLength,
+  RunZeros,
+  RunLits,
+  RunLitBytes,
+  InsertLength,
+  InsertBytes,
+  Done,
+  Failed,
+};
+
+// readOld is random access: each DIFF starts at an arbitrary old offset, often behind the previous
+// one, and only reads forward within its own run. The old image must stay readable for the whole
+// patch; the running flash partition qualifies because the output goes to the other slot.
+struct DeltaPatchIo {
+  void* ctx = nullptr;
+  bool (*readOld)(void* ctx, uint32_t offset, uint8_t* buf, size_t len) = nullptr;
+  bool (*writeNew)(void* ctx, const uint8_t* buf, size_t len) = nullptr;
+  // Called once the header is in, before any output; returning false rejects the patch.
+  bool (*checkBase)(void* ctx, uint32_t oldSize, const uint8_t* oldSha256) = nullptr;
+};
+
+struct DeltaPatchState {
+  DeltaPatchIo io;
+  DeltaPhase phase = DeltaPhase::Header;
+  uint8_t header[kDeltaHeaderSize] = {};
+  size_t headerFill = 0;
+  uint32_t oldSize = 0;
+  uint32_t newSize = 0;
+  uint8_t newSha256[32] = {};
+  uint32_t varint = 0;
+  uint8_t varintShift = 0;
+  uint32_t opOffset = 0;   // next old byte the current DIFF reads
+  uint32_t opRemain = 0;   // bytes left in the current DIFF or INSERT
+  uint32_t runZeros = 0;
+  uint32_t runLits = 0;
+  uint32_t produced = 0;
+  uint8_t out[kDeltaOutBufferSize] = {};
+  size_t outFill = 0;
+  const char* error = nullptr;
+};
+
+void deltaPatchBegin(DeltaPatchState& state, const DeltaPatchIo& io);
+DeltaPatchStatus deltaPatchFeed(DeltaPatchState& state, const uint8_t* data, size_t len);
@@ -0,0 +1,137 @@
+#include "EventTrigger.h"
+
+#include <Arduino.h>
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+
+#include "AppContext.h"
+#include "CameraController.h"
+#include "Logging.h"
+#include "Telemetry.h"
+
+namespace {
+constexpr unsigned long kIdlePollMs = 10;
+// Manual light sleep pauses the radio; short naps keep the AP association alive.
+constexpr unsigned long kMaxLightSleepMs = 500;
+constexpr unsigned long kMinLightSleepMs = 30;
+// The camera is shut down for light sleep; a re-init costs a few hundred ms, so a running camera
+// is only stopped for an idle stretch at least this long.
+constexpr unsigned long kCameraOffMinMs = 3000;
+
+// Touched from the ISR: plain DRAM statics only (no app(), no String), the handler runs from IRAM.
+TaskHandle_t loopTask = nullptr;
+portMUX_TYPE triggerMux = portMUX_INITIALIZER_UNLOCKED;
+volatile bool pending = false;
+volatile int64_t firedAtUs = 0;
+int attachedGpio = -1;
+
+void IRAM_ATTR markFired(int64_t nowUs) {
+  if (!pending) {
+    // Keep the first edge: latency is measured from when the event actually started.
+    firedAtUs = nowUs;
+    pending = true;
+  }
+}
+
+void IRAM_ATTR onTriggerEdge() {
+  portENTER_CRITICAL_ISR(&triggerMux);
+  markFired(esp_timer_get_time());
+  portEXIT_CRITICAL_ISR(&triggerMux);
+  BaseType_t woken = pdFALSE;
+  if (loopTask) vTaskNotifyGiveFromISR(loopTask, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+bool inputActive() {
+  const auto& trigger = app().trigger;
+  return digitalRead(trigger.gpio) == (trigger.activeHigh ? HIGH : LOW);
+}
+
+void lightSleepUntil(unsigned long untilMs) {
+  const auto& trigger = app().trigger;
+  long remaining = static_cast<long>(untilMs - millis());
+  if (remaining < static_cast<long>(kMinLightSleepMs) || pending || inputActive()) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(kIdlePollMs));
+    return;
+  }
+  if (app().camera.inited) {
+    if (remaining < static_cast<long>(kCameraOffMinMs)) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(kIdlePollMs));
+      return;
+    }
+    cameraPowerDown();
+  }
+  unsigned long sleepMs = static_cast<unsigned long>(remaining);
+  if (sleepMs > kMaxLightSleepMs) sleepMs = kMaxLightSleepMs;
+
+  gpio_num_t pin = static_cast<gpio_num_t>(trigger.gpio);
+  // gpio_wakeup_enable switches the pin to a level interrupt; with the ISR still armed an active
+  // input would re-enter onTriggerEdge until sleep starts. The wakeup cause covers that edge instead.
+  gpio_intr_disable(pin);
+  gpio_wakeup_enable(pin, trigger.activeHigh ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  esp_sleep_enable_timer_wakeup(static_cast<uint64_t>(sleepMs) * 1000ULL);
+  esp_light_sleep_start();
+  gpio_wakeup_disable(pin);
+  gpio_set_intr_type(pin, trigger.activeHigh ? GPIO_INTR_POSEDGE : GPIO_INTR_NEGEDGE);
+  gpio_intr_enable(pin);
+
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO) {
+    portENTER_CRITICAL(&triggerMux);
+    markFired(esp_timer_get_time());
+    portEXIT_CRITICAL(&triggerMux);
+  }
+}
+}  // namespace
+
+void eventTriggerBegin() {
+  loopTask = xTaskGetCurrentTaskHandle();
+}
+
+void eventTriggerConfigure(int gpio, bool activeHigh) {
+  auto& trigger = app().trigger;
+  // Free pins on the ESP32-CAM (SD-card lines). GPIO2, GPIO12 and GPIO15 are boot straps: a PIR
+  // holding one of them at the wrong level during reset changes the boot mode or flash voltage.
+  if (gpio != 13 && gpio != 14) gpio = -1;
+  if (gpio == attachedGpio && activeHigh == trigger.activeHigh) return;
+  if (attachedGpio >= 0) detachInterrupt(digitalPinToInterrupt(attachedGpio));
+  attachedGpio = -1;
+  trigger.gpio = gpio;
+  trigger.activeHigh = activeHigh;
+  if (gpio < 0) return;
+
+  // PIR modules drive the line; door contacts usually switch to ground and need the pull-up.
+  pinMode(gpio, activeHigh ? INPUT_PULLDOWN : INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(gpio), onTriggerEdge, activeHigh ? RISING : FALLING);
+  attachedGpio = gpio;
+  LOGV("[Trigger] GPIO%d active %s\n", gpio, activeHigh ? "high" : "low");
+}
+
+bool eventTriggerTake(int64_t& firedUs) {
+  auto& trigger = app().trigger;
+  if (!pending) return false;
+  portENTER_CRITICAL(&triggerMux);
+  firedUs = firedAtUs;
+  pending = false;
+  portEXIT_CRITICAL(&triggerMux);
+
+  // A PIR re-fires for as long as something moves; one capture per cooldown window is enough.
+  if (trigger.lastEventUs && firedUs - trigger.lastEventUs < static_cast<int64_t>(trigger.cooldownMs) * 1000) {
+    telemetryCount(TelemetryCounter::TriggerSuppressed);
+    return false;
+  }
+  trigger.lastEventUs = firedUs;
+  telemetryCount(TelemetryCounter::TriggerEvent);
+  return true;
+}
+
+void eventTriggerWait(unsigned long untilMs) {
+  const auto& trigger = app().trigger;
+  if (trigger.lightSleep && attachedGpio >= 0) {
+    lightSleepUntil(untilMs);
+    return;
+  }
+  // Same 10 ms idle as before, but an edge ends it immediately.
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(kIdlePollMs));
+}
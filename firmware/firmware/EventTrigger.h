@@ -0,0 +1,8 @@
+#pragma once
+
+#include <Arduino.h>
+
+void eventTriggerBegin();
+void eventTriggerConfigure(int gpio, bool activeHigh);
+bool eventTriggerTake(int64_t& firedUs);
+void eventTriggerWait(unsigned long untilMs);
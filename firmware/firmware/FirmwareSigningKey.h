@@ -0,0 +1,9 @@
+#pragma once
+
+// Public half of the OTA signing key (ECDSA P-256, PEM). Every image the backend serves carries a
+// signature over its SHA-256 made with the private half, which stays with whoever builds releases:
+//   openssl ecparam -name prime256v1 -genkey -noout -out fw_signing.key
+//   openssl ec -in fw_signing.key -pubout -out fw_signing.pub      (paste below)
+//   openssl dgst -sha256 -sign fw_signing.key -out fw-1.2.0.sig fw-1.2.0.bin
+// Left empty, the firmware refuses every OTA image; it can still be flashed over serial.
+static const char kFirmwareSigningKeyPem[] = "";
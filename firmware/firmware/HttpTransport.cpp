@@ -0,0 +1,139 @@
+#include "HttpTransport.h"
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+
+#include "AppContext.h"
+#include "Logging.h"
+#include "Telemetry.h"
+
+namespace {
+constexpr unsigned long kTlsHandshakeTimeoutSec = 10;
+
+HttpSlot* findSlot(const String& host, uint16_t port, bool tls) {
+  auto& transport = app().transport;
+  for (auto& slot : transport.slots) {
+    if (slot.port == port && slot.tls == tls && slot.host == host) return &slot;
+  }
+  return nullptr;
+}
+
+HttpSlot& evictSlot() {
+  auto& transport = app().transport;
+  HttpSlot* oldest = &transport.slots[0];
+  for (auto& slot : transport.slots) {
+    if (slot.port == 0) return slot;
+    if (slot.lastUsedMs < oldest->lastUsedMs) oldest = &slot;
+  }
+  oldest->plain.stop();
+  oldest->secure.stop();
+  oldest->port = 0;
+  return *oldest;
+}
+
+void configureTls(WiFiClientSecure& client) {
+  auto& backend = app().backend;
+  if (backend.caCert.length()) {
+    client.setCACert(backend.caCert.c_str());
+  } else {
+    client.setInsecure();
+  }
+  client.setHandshakeTimeout(kTlsHandshakeTimeoutSec);
+}
+}  // namespace
+
+bool splitHostPort(const String& url, String& host, uint16_t& port, bool& tls) {
+  int schemeEnd = url.indexOf("://");
+  tls = url.startsWith("https://");
+  int hostStart = schemeEnd >= 0 ? schemeEnd + 3 : 0;
+  int hostEnd = url.indexOf('/', hostStart);
+  if (hostEnd < 0) hostEnd = url.length();
+  String authority = url.substring(hostStart, hostEnd);
+  int at = authority.indexOf('@');
+  if (at >= 0) authority = authority.substring(at + 1);
+  int colon = authority.indexOf(':');
+  if (colon >= 0) {
+    host = authority.substring(0, colon);
+    port = static_cast<uint16_t>(authority.substring(colon + 1).toInt());
+  } else {
+    host = authority;
+    port = tls ? 443 : 80;
+  }
+  return host.length() > 0 && port != 0;
+}
+
+HTTPClient* beginHttpRequest(const String& url, bool& reused) {
+  reused = false;
+  String host;
+  uint16_t port = 0;
+  bool tls = false;
+  if (!splitHostPort(url, host, port, tls)) return nullptr;
+
+  HttpSlot* slot = findSlot(host, port, tls);
+  if (!slot) {
+    slot = &evictSlot();
+    slot->host = host;
+    slot->port = port;
+    slot->tls = tls;
+  }
+  // connected() only sees a close that has already arrived; past the idle budget the server may be
+  // closing the socket just as the request goes out, so start over rather than fail the first write.
+  bool fresh = millis() - slot->lastUsedMs < app().transport.keepAliveIdleMs;
+  slot->lastUsedMs = millis();
+
+  WiFiClient& client = tls ? static_cast<WiFiClient&>(slot->secure) : slot->plain;
+  if (fresh && client.connected()) {
+    reused = true;
+    telemetryCount(TelemetryCounter::ConnReuse);
+  } else {
+    client.stop();
+    if (tls) configureTls(slot->secure);
+    unsigned long startUs = micros();
+    bool ok = client.connect(host.c_str(), port);
+    uint32_t elapsedUs = micros() - startUs;
+    if (tls) {
+      telemetryRecord(TelemetryStage::TlsHandshake, elapsedUs);
+      telemetryCount(TelemetryCounter::TlsHandshake);
+    }
+    if (!ok) {
+      LOGE("[NET] connect %s:%u failed\n", host.c_str(), port);
+      client.stop();
+      return nullptr;
+    }
+    LOGV("[NET] %s %s:%u in %lu us\n", tls ? "TLS" : "TCP", host.c_str(), port, static_cast<unsigned long>(elapsedUs));
+  }
+
+  // HTTPClient finds the socket already open and keeps it after end() when the server allows keep-alive.
+  slot->http.setReuse(true);
+  if (!slot->http.begin(client, url)) {
+    client.stop();
+    return nullptr;
+  }
+  return &slot->http;
+}
+
+void endHttpRequest(HTTPClient* http, bool keepAlive) {
+  if (!http) return;
+  http->end();
+  auto& transport = app().transport;
+  for (auto& slot : transport.slots) {
+    if (&slot.http != http) continue;
+    // Idle time counts from the end of the response; a slow upload must not use up the budget.
+    slot.lastUsedMs = millis();
+    if (keepAlive) return;
+    slot.plain.stop();
+    slot.secure.stop();
+    return;
+  }
+}
+
+void closeAllHttpClients() {
+  auto& transport = app().transport;
+  for (auto& slot : transport.slots) {
+    slot.http.end();
+    slot.plain.stop();
+    slot.secure.stop();
+    slot.port = 0;
+  }
+}
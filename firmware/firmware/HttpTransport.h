@@ -0,0 +1,9 @@
+#pragma once
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+
+bool splitHostPort(const String& url, String& host, uint16_t& port, bool& tls);
+HTTPClient* beginHttpRequest(const String& url, bool& reused);
+void endHttpRequest(HTTPClient* http, bool keepAlive);
+void closeAllHttpClients();
@@ -74,7 +74,7 @@ void startCaptivePortal() {
     String html =
       String(F("<!doctype html><meta charset='utf-8'><meta name='viewport' content='width=device-width,initial-scale=1'>"
                "<style>body{font-family:sans-serif;margin:24px}label{display:block;margin:.6rem 0 .2rem}"
-               "input,button{width:100%;padding:.6rem;font-size:16px}button{margin-top:1rem}</style>"
+               "input,textarea,button{width:100%;padding:.6rem;font-size:16px}button{margin-top:1rem}</style>"
                "<h2>ESP32-CAM Kurulum</h2>")) +
       "<p>Device ID: <b>" + state.device.id + "</b></p>"
       "<form method='POST' action='/save'>"
@@ -82,6 +82,7 @@ void startCaptivePortal() {
       "<label>WiFi Password</label><input name='pass' type='password' required>"
       "<label>Backend URL (ex: http://192.168.1.10:8000)</label><input name='be' required>"
       "<label>Backend Token (Bearer)</label><input name='betok' type='password' required>"
+      "<label>Backend CA certificate (PEM, optional, for https)</label><textarea name='beca' rows='4'></textarea>"
       "<button type='submit'>Save & Reboot</button></form>"
       "<p style='margin-top:1rem;color:#666'>After reboot, local UI is disabled. Manage via your PC admin interface.</p>";
     state.server.send(200, "text/html", html);
@@ -98,6 +99,7 @@ void startCaptivePortal() {
     state.network.password = state.server.arg("pass");
     state.backend.baseUrl = state.server.arg("be");
     state.backend.token = state.server.arg("betok");
+    state.backend.caCert = state.server.hasArg("beca") ? state.server.arg("beca") : String();
     if (state.backend.baseUrl.endsWith("/")) {
       state.backend.baseUrl.remove(state.backend.baseUrl.length() - 1);
     }
@@ -108,6 +110,7 @@ void startCaptivePortal() {
     state.prefs.putString("wifi_pass", state.network.password);
     state.prefs.putString("be_url", state.backend.baseUrl);
     state.prefs.putString("be_tok", state.backend.token);
+    state.prefs.putString("be_ca", state.backend.caCert);
     state.prefs.putString("api_url", state.upload.apiUrl);
     state.prefs.putString("api_token", state.upload.apiToken);
     state.prefs.end();
@@ -0,0 +1,386 @@
+#include "OtaUpdater.h"
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include "esp32/rom/miniz.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "mbedtls/base64.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+
+#include "AppContext.h"
+#include "CameraController.h"
+#include "DeltaPatch.h"
+#include "FirmwareSigningKey.h"
+#include "HttpTransport.h"
+#include "Logging.h"
+#include "Telemetry.h"
+
+// initArduino() confirms the running image on its own unless this says otherwise; a new image
+// is only confirmed once it has reached the backend with a working camera (otaMarkHealthy).
+bool verifyRollbackLater() { return true; }
+
+namespace {
+constexpr const char* kFirmwarePath = "/api/firmware";
+constexpr const char* kPrefsNamespace = "ota";
+// Unconfirmed boots of a new image, counting the one that rolls back: a crash loop costs three boots.
+constexpr uint8_t kMaxTrialBoots = 3;
+constexpr unsigned long kVerifyWindowMs = 10UL * 60UL * 1000UL;
+constexpr unsigned long kRetryBackoffMs = 15UL * 60UL * 1000UL;
+constexpr uint16_t kReadTimeoutMs = 15000;
+constexpr size_t kInputChunk = 1024;
+constexpr size_t kShaChunk = 1024;
+constexpr size_t kMaxSignatureLen = 72;  // DER-encoded ECDSA P-256
+
+enum class OtaResult : uint8_t {
+  Ok,
+  BaseMismatch,
+  Failed,
+};
+
+// Heap-allocated for the duration of one update: the inflater and patch state are too big to keep around.
+struct OtaSession {
+  const esp_partition_t* running = nullptr;
+  esp_ota_handle_t handle = 0;
+  bool delta = false;
+  bool baseMismatch = false;
+  uint32_t written = 0;
+  mbedtls_sha256_context sha;
+  DeltaPatchState patch;
+  tinfl_decompressor inflator;
+};
+
+String toHex(const uint8_t* data, size_t len) {
+  static const char kDigits[] = "0123456789abcdef";
+  String out;
+  out.reserve(len * 2);
+  for (size_t i = 0; i < len; ++i) {
+    out += kDigits[data[i] >> 4];
+    out += kDigits[data[i] & 0x0F];
+  }
+  return out;
+}
+
+// The SHA-256 header only shows the download matches what the server sent; the signature shows the
+// image was released with the signing key, even if the server or the (possibly unpinned) TLS link is not trusted.
+bool signatureValid(const uint8_t* digest, const String& signatureB64) {
+  uint8_t sig[kMaxSignatureLen];
+  size_t sigLen = 0;
+  if (mbedtls_base64_decode(sig, sizeof(sig), &sigLen, reinterpret_cast<const uint8_t*>(signatureB64.c_str()),
+                            signatureB64.length()) != 0 || sigLen == 0) {
+    return false;
+  }
+  mbedtls_pk_context key;
+  mbedtls_pk_init(&key);
+  bool ok = mbedtls_pk_parse_public_key(&key, reinterpret_cast<const uint8_t*>(kFirmwareSigningKeyPem),
+                                        sizeof(kFirmwareSigningKeyPem)) == 0 &&
+            mbedtls_pk_can_do(&key, MBEDTLS_PK_ECDSA) &&
+            mbedtls_pk_verify(&key, MBEDTLS_MD_SHA256, digest, 32, sig, sigLen) == 0;
+  mbedtls_pk_free(&key);
+  return ok;
+}
+
+bool readRunning(void* ctx, uint32_t offset, uint8_t* buf, size_t len) {
+  auto* session = static_cast<OtaSession*>(ctx);
+  return esp_partition_read(session->running, offset, buf, len) == ESP_OK;
+}
+
+bool writeImage(void* ctx, const uint8_t* buf, size_t len) {
+  auto* session = static_cast<OtaSession*>(ctx);
+  if (esp_ota_write(session->handle, buf, len) != ESP_OK) return false;
+  mbedtls_sha256_update(&session->sha, buf, len);
+  session->written += len;
+  return true;
+}
+
+// The delta was made against the backend's copy of our version; make sure that is what we run.
+bool checkRunningImage(void* ctx, uint32_t oldSize, const uint8_t* oldSha256) {
+  auto* session = static_cast<OtaSession*>(ctx);
+  session->baseMismatch = true;
+  if (oldSize > session->running->size) return false;
+  uint8_t buf[kShaChunk];
+  uint8_t digest[32];
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+  bool ok = true;
+  for (uint32_t offset = 0; offset < oldSize && ok; offset += kShaChunk) {
+    size_t n = oldSize - offset < kShaChunk ? oldSize - offset : kShaChunk;
+    ok = esp_partition_read(session->running, offset, buf, n) == ESP_OK;
+    if (ok) mbedtls_sha256_update(&sha, buf, n);
+  }
+  mbedtls_sha256_finish(&sha, digest);
+  mbedtls_sha256_free(&sha);
+  if (!ok || memcmp(digest, oldSha256, sizeof(digest)) != 0) return false;
+  session->baseMismatch = false;
+  return true;
+}
+
+bool consume(OtaSession& session, const uint8_t* data, size_t len) {
+  if (!session.delta) return writeImage(&session, data, len);
+  return deltaPatchFeed(session.patch, data, len) != DeltaPatchStatus::Error;
+}
+
+// Streams the zlib body through the ROM inflater; its 32 KB output ring doubles as the LZ window.
+bool inflateBody(OtaSession& session, WiFiClient* stream, int remaining, uint8_t* in, uint8_t* dict) {
+  size_t dictOfs = 0;
+  for (;;) {
+    size_t inLen = 0;
+    if (remaining > 0) {
+      inLen = stream->readBytes(in, remaining < static_cast<int>(kInputChunk) ? remaining : kInputChunk);
+      if (!inLen) {
+        LOGE_LN("[OTA] read timeout");
+        return false;
+      }
+      remaining -= inLen;
+    }
+    size_t inPos = 0;
+    for (;;) {
+      size_t inAvail = inLen - inPos;
+      size_t outAvail = TINFL_LZ_DICT_SIZE - dictOfs;
+      uint32_t flags = TINFL_FLAG_PARSE_ZLIB_HEADER | (remaining > 0 ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+      tinfl_status status = tinfl_decompress(&session.inflator, in + inPos, &inAvail, dict, dict + dictOfs, &outAvail, flags);
+      inPos += inAvail;
+      if (outAvail && !consume(session, dict + dictOfs, outAvail)) return false;
+      dictOfs = (dictOfs + outAvail) & (TINFL_LZ_DICT_SIZE - 1);
+      if (status == TINFL_STATUS_DONE) return true;
+      if (status < 0) {
+        LOGE("[OTA] inflate failed: %d\n", static_cast<int>(status));
+        return false;
+      }
+      if (status == TINFL_STATUS_NEEDS_MORE_INPUT) break;
+    }
+    if (remaining <= 0) {
+      LOGE_LN("[OTA] body truncated");
+      return false;
+    }
+  }
+}
+
+OtaResult downloadAndApply(bool full) {
+  auto& ctx = app();
+  if (sizeof(kFirmwareSigningKeyPem) <= 1) {
+    LOGE_LN("[OTA] no signing key built in");
+    return OtaResult::Failed;
+  }
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  const esp_partition_t* next = esp_ota_get_next_update_partition(nullptr);
+  if (!running || !next) {
+    LOGE_LN("[OTA] no update partition");
+    return OtaResult::Failed;
+  }
+
+  String url = ctx.backend.baseUrl;
+  if (url.endsWith("/")) url.remove(url.length() - 1);
+  url += String(kFirmwarePath) + "?deviceId=" + ctx.device.id + "&from=" + FIRMWARE_VERSION + "&to=" + ctx.ota.target;
+  if (full) url += "&full=1";
+
+  bool reused = false;
+  HTTPClient* http = beginHttpRequest(url, reused);
+  if (!http) {
+    LOGE_LN("[OTA] http.begin failed");
+    return OtaResult::Failed;
+  }
+  static const char* kHeaders[] = {"X-Fw-Format", "X-Fw-Size", "X-Fw-Sha256", "X-Fw-Signature"};
+  http->addHeader("Authorization", "Bearer " + ctx.backend.token);
+  http->setTimeout(kReadTimeoutMs);
+  http->collectHeaders(kHeaders, 4);
+  int code = http->GET();
+  if (code != 200) {
+    LOGE("[OTA] GET firmware => %d\n", code);
+    endHttpRequest(http, code > 0);
+    return OtaResult::Failed;
+  }
+
+  bool delta = http->header("X-Fw-Format") == "delta";
+  uint32_t imageSize = static_cast<uint32_t>(http->header("X-Fw-Size").toInt());
+  String imageSha = http->header("X-Fw-Sha256");
+  imageSha.toLowerCase();
+  String signature = http->header("X-Fw-Signature");
+  int bodySize = http->getSize();
+  if (!imageSize || imageSize > next->size || bodySize <= 0 || imageSha.length() != 64 || signature.isEmpty()) {
+    LOGE("[OTA] bad response: size=%lu body=%d\n", static_cast<unsigned long>(imageSize), bodySize);
+    endHttpRequest(http, false);
+    return OtaResult::Failed;
+  }
+
+  auto* session = new OtaSession();
+  auto* dict = static_cast<uint8_t*>(malloc(TINFL_LZ_DICT_SIZE));
+  auto* in = static_cast<uint8_t*>(malloc(kInputChunk));
+  session->running = running;
+  session->delta = delta;
+  mbedtls_sha256_init(&session->sha);
+  mbedtls_sha256_starts(&session->sha, 0);
+  tinfl_init(&session->inflator);
+  DeltaPatchIo io;
+  io.ctx = session;
+  io.readOld = readRunning;
+  io.writeNew = writeImage;
+  io.checkBase = checkRunningImage;
+  deltaPatchBegin(session->patch, io);
+
+  OtaResult result = OtaResult::Failed;
+  bool begun = false;
+  if (!dict || !in) {
+    LOGE_LN("[OTA] out of memory");
+  } else if (esp_ota_begin(next, imageSize, &session->handle) != ESP_OK) {
+    LOGE_LN("[OTA] esp_ota_begin failed");
+  } else {
+    begun = true;
+    LOGV("[OTA] %s %s -> %s, %d bytes into %s\n", delta ? "delta" : "full", FIRMWARE_VERSION,
+         ctx.ota.target.c_str(), bodySize, next->label);
+    bool ok = inflateBody(*session, http->getStreamPtr(), bodySize, in, dict);
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&session->sha, digest);
+    if (delta && session->patch.phase != DeltaPhase::Done) {
+      if (session->patch.error) LOGE("[OTA] patch: %s\n", session->patch.error);
+      ok = false;
+    }
+    if (ok && (session->written != imageSize || toHex(digest, sizeof(digest)) != imageSha ||
+               (delta && memcmp(digest, session->patch.newSha256, sizeof(digest)) != 0))) {
+      LOGE("[OTA] verify failed: %lu/%lu bytes\n", static_cast<unsigned long>(session->written),
+           static_cast<unsigned long>(imageSize));
+      ok = false;
+    }
+    if (ok && !signatureValid(digest, signature)) {
+      LOGE_LN("[OTA] signature rejected");
+      ok = false;
+    }
+    if (ok) {
+      begun = false;
+      // esp_ota_end re-validates the image structure and app checksum before it may boot.
+      if (esp_ota_end(session->handle) == ESP_OK && esp_ota_set_boot_partition(next) == ESP_OK) {
+        result = OtaResult::Ok;
+      } else {
+        LOGE_LN("[OTA] image rejected");
+      }
+    } else if (session->baseMismatch) {
+      result = OtaResult::BaseMismatch;
+    }
+  }
+  if (begun) esp_ota_abort(session->handle);
+  mbedtls_sha256_free(&session->sha);
+  free(in);
+  free(dict);
+  delete session;
+  // A half-read body cannot be reused for keep-alive.
+  endHttpRequest(http, result == OtaResult::Ok);
+  return result;
+}
+
+void rollBack(const char* why) {
+  auto& ota = app().ota;
+  Preferences prefs;
+  prefs.begin(kPrefsNamespace, false);
+  String prev = prefs.getString("prev", "");
+  const esp_partition_t* part =
+      prev.length() ? esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, prev.c_str()) : nullptr;
+  bool switched = part && esp_ota_set_boot_partition(part) == ESP_OK;
+  if (switched) {
+    // The rejected version is remembered so the still-published target is not flashed again.
+    prefs.putString("bad", prefs.getString("next", ""));
+    prefs.putUChar("rolled", 1);
+  }
+  prefs.remove("boots");
+  prefs.remove("prev");
+  prefs.remove("next");
+  prefs.end();
+
+  if (!switched) {
+    LOGE("[OTA] cannot roll back (%s), keeping %s\n", why, FIRMWARE_VERSION);
+    esp_ota_mark_app_valid_cancel_rollback();
+    ota.pendingVerify = false;
+    return;
+  }
+  LOGE("[OTA] %s: rolling back to %s\n", why, prev.c_str());
+  closeAllHttpClients();
+  ESP.restart();
+}
+}  // namespace
+
+void otaBegin() {
+  auto& ota = app().ota;
+  Preferences prefs;
+  prefs.begin(kPrefsNamespace, false);
+  ota.rejectedTarget = prefs.getString("bad", "");
+  if (prefs.getUChar("rolled", 0)) {
+    prefs.remove("rolled");
+    telemetryCount(TelemetryCounter::OtaRollback);
+  }
+  uint8_t boots = prefs.getUChar("boots", 0);
+  if (boots == 0) {
+    prefs.end();
+    // Not on trial (serial flash or an already confirmed image).
+    esp_ota_mark_app_valid_cancel_rollback();
+    return;
+  }
+  if (boots >= kMaxTrialBoots) {
+    prefs.end();
+    rollBack("too many trial boots");
+    return;
+  }
+  prefs.putUChar("boots", boots + 1);
+  prefs.end();
+  ota.pendingVerify = true;
+  ota.verifyDeadlineMs = millis() + kVerifyWindowMs;
+  LOGV("[OTA] %s on trial, boot %u\n", FIRMWARE_VERSION, static_cast<unsigned>(boots));
+}
+
+bool otaUpdateDue() {
+  const auto& ota = app().ota;
+  if (ota.target.isEmpty() || ota.target == FIRMWARE_VERSION || ota.pendingVerify) return false;
+  if (ota.target == ota.rejectedTarget) return false;
+  if (ota.target == ota.failedTarget && static_cast<long>(millis() - ota.retryAtMs) < 0) return false;
+  return WiFi.status() == WL_CONNECTED;
+}
+
+bool otaRunUpdate() {
+  auto& ota = app().ota;
+  OtaResult result = downloadAndApply(false);
+  // The backend's image of our version may not match what is flashed; the full image still works.
+  if (result == OtaResult::BaseMismatch) {
+    LOGE_LN("[OTA] delta base mismatch, fetching full image");
+    result = downloadAndApply(true);
+  }
+  if (result != OtaResult::Ok) {
+    telemetryCount(TelemetryCounter::OtaFail);
+    ota.failedTarget = ota.target;
+    ota.retryAtMs = millis() + kRetryBackoffMs;
+    return false;
+  }
+
+  Preferences prefs;
+  prefs.begin(kPrefsNamespace, false);
+  prefs.putString("prev", esp_ota_get_running_partition()->label);
+  prefs.putString("next", ota.target);
+  prefs.putUChar("boots", 1);
+  prefs.end();
+  LOGV("[OTA] %s staged, rebooting\n", ota.target.c_str());
+  closeAllHttpClients();
+  ESP.restart();
+  return true;
+}
+
+void otaMarkHealthy() {
+  auto& ctx = app();
+  if (!ctx.ota.pendingVerify || !cameraAvailable()) return;
+  esp_ota_mark_app_valid_cancel_rollback();
+  Preferences prefs;
+  prefs.begin(kPrefsNamespace, false);
+  prefs.remove("boots");
+  prefs.remove("prev");
+  prefs.remove("next");
+  prefs.end();
+  ctx.ota.pendingVerify = false;
+  LOGV("[OTA] %s confirmed\n", FIRMWARE_VERSION);
+}
+
+void otaTick() {
+  const auto& ota = app().ota;
+  if (ota.pendingVerify && static_cast<long>(millis() - ota.verifyDeadlineMs) >= 0) {
+    rollBack("not confirmed in time");
+  }
+}
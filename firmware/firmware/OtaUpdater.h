@@ -0,0 +1,9 @@
+#pragma once
+
+#include <Arduino.h>
+
+void otaBegin();
+bool otaUpdateDue();
+bool otaRunUpdate();
+void otaMarkHealthy();
+void otaTick();
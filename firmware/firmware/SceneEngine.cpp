@@ -0,0 +1,208 @@
+#include "SceneEngine.h"
+
+#include <Arduino.h>
+
+#include "CameraController.h"
+#include "Logging.h"
+
+// mode:enterIndex:exitIndex:gainceiling:aeLevel:aec2:grayscale:irLight;... (modes not listed are off)
+const char* const kDefaultSceneProfiles = "dusk:650:500:4:1:1:0:0;night:1100:900:5:2:1:0:0";
+
+namespace {
+// Sampling runs on its own cadence so a 60 s upload interval no longer delays dusk by minutes.
+constexpr unsigned long kSceneSampleMs = 2000UL;
+constexpr uint8_t kSceneDarkerSamples = 2;
+constexpr uint8_t kSceneBrighterSamples = 5;
+constexpr uint32_t kSceneGainWeight = 40;
+constexpr int kSceneDarkLuma = 24;
+constexpr unsigned long kSceneLumaHoldMs = 120000UL;
+constexpr unsigned long kSceneLogIntervalMs = 10000UL;
+
+const char* const kSceneModeNames[kSceneModeCount] = {
+  "day",
+  "dusk",
+  "night",
+  "ir",
+};
+
+unsigned long lastLogMs = 0;
+
+size_t modeIndex(SceneMode mode) {
+  return static_cast<size_t>(mode);
+}
+
+bool modeEnabled(SceneMode mode) {
+  return mode == SceneMode::Day || app().scene.profiles[modeIndex(mode)].enabled;
+}
+
+// Darkest enabled mode whose entry threshold is met; a darker current mode is kept while the
+// index stays above its exit threshold.
+SceneMode classify(uint32_t index) {
+  auto& scene = app().scene;
+  size_t best = 0;
+  for (size_t m = 1; m < kSceneModeCount; ++m) {
+    const auto& profile = scene.profiles[m];
+    if (profile.enabled && index >= profile.enterIndex) best = m;
+  }
+  for (size_t m = modeIndex(scene.mode); m > best; --m) {
+    const auto& profile = scene.profiles[m];
+    if (profile.enabled && index >= profile.exitIndex) return static_cast<SceneMode>(m);
+  }
+  return static_cast<SceneMode>(best);
+}
+
+void switchMode(SceneMode to, const char* reason) {
+  auto& scene = app().scene;
+  if (to == scene.mode) return;
+  sceneAccountTime();
+  SceneMode from = scene.mode;
+  scene.mode = to;
+  scene.pending = to;
+  scene.pendingSamples = 0;
+  scene.modeSinceMs = millis();
+  scene.transitions++;
+  applySceneTransition(from, to);
+  LOGV("[Scene] %s -> %s (%s, index=%lu luma=%d)\n", sceneModeName(from), sceneModeName(to), reason,
+       static_cast<unsigned long>(scene.exposureIndex), scene.lastLuma);
+  lastLogMs = millis();
+}
+
+bool parseProfile(const String& item, SceneProfile profiles[]) {
+  long fields[7] = {};
+  int start = item.indexOf(':');
+  if (start < 0) return false;
+  String name = item.substring(0, start);
+  size_t slot = 0;
+  for (size_t m = 1; m < kSceneModeCount; ++m) {
+    if (name == kSceneModeNames[m]) slot = m;
+  }
+  if (slot == 0) return false;
+  for (int i = 0; i < 7; ++i) {
+    if (start < 0) return false;
+    int end = item.indexOf(':', start + 1);
+    fields[i] = item.substring(start + 1, end < 0 ? item.length() : end).toInt();
+    start = end;
+  }
+
+  auto& profile = profiles[slot];
+  profile.enabled = true;
+  profile.enterIndex = static_cast<uint16_t>(constrain(fields[0], 0L, 65535L));
+  profile.exitIndex = static_cast<uint16_t>(constrain(fields[1], 0L, static_cast<long>(profile.enterIndex)));
+  profile.gainceilingIndex = static_cast<uint8_t>(constrain(fields[2], 0L, 5L));
+  profile.aeLevel = static_cast<int8_t>(constrain(fields[3], -2L, 2L));
+  profile.aec2 = fields[4] != 0;
+  profile.grayscale = fields[5] != 0;
+  profile.irLight = fields[6] != 0;
+  return true;
+}
+}  // namespace
+
+const char* sceneModeName(SceneMode mode) {
+  size_t idx = modeIndex(mode);
+  return idx < kSceneModeCount ? kSceneModeNames[idx] : "?";
+}
+
+bool sceneParseProfiles(const String& spec) {
+  SceneProfile parsed[kSceneModeCount];
+  int start = 0;
+  while (start < static_cast<int>(spec.length())) {
+    int end = spec.indexOf(';', start);
+    if (end < 0) end = spec.length();
+    String item = spec.substring(start, end);
+    item.trim();
+    // "none" switches every non-day mode off (an empty string means "unchanged" in the config).
+    if (item.length() && item != "none" && !parseProfile(item, parsed)) {
+      LOGE("[Scene] bad profile '%s'\n", item.c_str());
+      return false;
+    }
+    start = end + 1;
+  }
+
+  auto& scene = app().scene;
+  // Precomputed once here; a mode switch later only diffs two of these register sets.
+  for (size_t m = 0; m < kSceneModeCount; ++m) scene.profiles[m] = parsed[m];
+  scene.profileSpec = spec;
+  if (!modeEnabled(scene.mode)) {
+    switchMode(classify(scene.exposureIndex), "profile removed");
+  } else {
+    refreshSceneRegisters();
+  }
+  return true;
+}
+
+void sceneReset() {
+  auto& scene = app().scene;
+  sceneAccountTime();
+  scene.mode = SceneMode::Day;
+  scene.pending = SceneMode::Day;
+  scene.pendingSamples = 0;
+  scene.exposureIndex = 0;
+  scene.lastSampleMs = 0;
+  scene.modeSinceMs = millis();
+  refreshSceneRegisters();
+}
+
+void sceneEngineTick() {
+  auto& ctx = app();
+  auto& scene = ctx.scene;
+  if (!scene.enabled || !ctx.camera.inited) return;
+  unsigned long now = millis();
+  if (scene.lastSampleMs && now - scene.lastSampleMs < kSceneSampleMs) return;
+  bool first = scene.lastSampleMs == 0;
+  scene.lastSampleMs = now;
+
+  uint16_t aec = 0;
+  uint8_t gain = 0;
+  if (!readSensorExposure(aec, gain)) return;
+  uint32_t raw = aec + kSceneGainWeight * gain;
+  scene.exposureIndex = first ? raw : (scene.exposureIndex * 3 + raw) / 4;
+
+  SceneMode target = classify(scene.exposureIndex);
+  // A recent dark frame outranks the exposure index when it argues for a brighter mode.
+  bool darkFrameRecent = scene.lastLuma >= 0 && scene.lastLuma <= kSceneDarkLuma * 2 &&
+                         now - scene.lastLumaMs < kSceneLumaHoldMs;
+  if (target < scene.mode && darkFrameRecent) target = scene.mode;
+  if (target == scene.mode) {
+    scene.pendingSamples = 0;
+  } else {
+    if (target != scene.pending) {
+      scene.pending = target;
+      scene.pendingSamples = 0;
+    }
+    scene.pendingSamples++;
+    uint8_t needed = target > scene.mode ? kSceneDarkerSamples : kSceneBrighterSamples;
+    if (scene.pendingSamples >= needed) {
+      switchMode(target, "exposure");
+      return;
+    }
+  }
+
+  if (kVerboseLogging && now - lastLogMs > kSceneLogIntervalMs) {
+    LOGV("[Scene] mode=%s aec=%u gain=%u index=%lu\n", sceneModeName(scene.mode), aec, gain,
+         static_cast<unsigned long>(scene.exposureIndex));
+    lastLogMs = now;
+  }
+}
+
+void sceneReportFrameLuma(int luma) {
+  auto& scene = app().scene;
+  if (luma < 0) return;
+  scene.lastLuma = static_cast<int16_t>(luma);
+  scene.lastLumaMs = millis();
+  if (!scene.enabled || luma > kSceneDarkLuma) return;
+
+  // The sensor AEC is already saturated when frames come out black; skip the dwell.
+  for (size_t m = modeIndex(scene.mode) + 1; m < kSceneModeCount; ++m) {
+    if (scene.profiles[m].enabled) {
+      switchMode(static_cast<SceneMode>(m), "dark frame");
+      return;
+    }
+  }
+}
+
+void sceneAccountTime() {
+  auto& scene = app().scene;
+  unsigned long now = millis();
+  scene.timeInModeMs[modeIndex(scene.mode)] += now - scene.accountedMs;
+  scene.accountedMs = now;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "AppContext.h"
+
+extern const char* const kDefaultSceneProfiles;
+
+const char* sceneModeName(SceneMode mode);
+bool sceneParseProfiles(const String& spec);
+void sceneReset();
+void sceneEngineTick();
+void sceneReportFrameLuma(int luma);
+void sceneAccountTime();
@@ -0,0 +1,103 @@
+#include "Scheduler.h"
+
+#include <Arduino.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "AppContext.h"
+#include "Logging.h"
+
+namespace {
+constexpr uint32_t kBackoffBaseMs = 2000;
+constexpr uint32_t kBackoffCapMs = 300000;
+// Anything before this is the RTC counting up from the 1970 boot value.
+constexpr time_t kMinValidEpoch = 1700000000;
+}  // namespace
+
+void syncServerClock(uint64_t serverEpochMs, uint32_t rttMs) {
+  auto& clock = app().clock;
+  clock.serverEpochMs = serverEpochMs + rttMs / 2;
+  clock.syncMillis = millis();
+  clock.synced = true;
+  // Until SNTP answers the backend clock is the best wall time there is; SNTP corrects it later.
+  if (!wallClockValid()) {
+    struct timeval tv;
+    tv.tv_sec = static_cast<time_t>(clock.serverEpochMs / 1000);
+    tv.tv_usec = static_cast<suseconds_t>((clock.serverEpochMs % 1000) * 1000);
+    settimeofday(&tv, nullptr);
+    LOGV("[Clock] seeded from backend: %lu\n", static_cast<unsigned long>(tv.tv_sec));
+  }
+}
+
+void wallClockBegin() {
+  auto& clock = app().clock;
+  // Sets TZ as well; SNTP keeps resyncing in the background from here on.
+  configTzTime(clock.tz.c_str(), clock.ntpServer.c_str());
+  clock.sntpStarted = true;
+  LOGV("[Clock] SNTP %s tz=%s\n", clock.ntpServer.c_str(), clock.tz.c_str());
+}
+
+void wallClockConfigure(const String& tz, const String& ntpServer) {
+  auto& clock = app().clock;
+  bool changed = false;
+  if (tz.length() && tz != clock.tz) {
+    clock.tz = tz;
+    changed = true;
+  }
+  if (ntpServer.length() && ntpServer != clock.ntpServer) {
+    clock.ntpServer = ntpServer;
+    changed = true;
+  }
+  if (changed || !clock.sntpStarted) wallClockBegin();
+}
+
+bool wallClockValid() {
+  return time(nullptr) >= kMinValidEpoch;
+}
+
+unsigned long nextAlignedMillis(uint32_t periodMs, uint32_t phaseMs) {
+  auto& clock = app().clock;
+  unsigned long now = millis();
+  if (periodMs == 0) return now;
+  uint32_t jitter = clock.jitterMs ? static_cast<uint32_t>(random(static_cast<long>(clock.jitterMs) + 1)) : 0;
+  if (!clock.synced) return now + periodMs + jitter;
+
+  // Next slot strictly after "now" on the grid k * period + phase of the backend clock.
+  uint64_t epochNow = clock.serverEpochMs + static_cast<uint32_t>(now - clock.syncMillis);
+  uint64_t phase = phaseMs % periodMs;
+  uint64_t base = epochNow >= phase ? epochNow - phase : 0;
+  uint64_t slot = (base / periodMs + 1) * periodMs + phase;
+  return now + static_cast<unsigned long>(slot - epochNow) + jitter;
+}
+
+bool deadlineReached(unsigned long deadlineMs) {
+  return static_cast<long>(millis() - deadlineMs) >= 0;
+}
+
+void scheduleNextUpload(bool ok) {
+  auto& ctx = app();
+  auto& upload = ctx.upload;
+  unsigned long aligned = nextAlignedMillis(upload.intervalSec * 1000UL, upload.phaseMs);
+  if (ok) {
+    upload.failStreak = 0;
+    upload.nextUploadMs = aligned;
+    return;
+  }
+  if (!ctx.http.transportFailed) {
+    // Grab failure or missing upload URL: the backend is fine, so keep the normal cadence and streak.
+    upload.nextUploadMs = aligned;
+    LOGV_LN("[Upload] local failure, no backoff");
+    return;
+  }
+
+  if (upload.failStreak < 16) upload.failStreak++;
+  uint32_t backoff = kBackoffBaseMs << (upload.failStreak - 1);
+  if (backoff > kBackoffCapMs || upload.failStreak > 8) backoff = kBackoffCapMs;
+  // Retry-After is a floor; half-range jitter keeps a rejected fleet from coming back in step.
+  uint32_t wait = backoff / 2 + static_cast<uint32_t>(random(static_cast<long>(backoff / 2) + 1));
+  if (ctx.http.retryAfterMs > wait) wait = ctx.http.retryAfterMs;
+
+  unsigned long now = millis();
+  upload.nextUploadMs = (static_cast<long>(aligned - now) >= static_cast<long>(wait)) ? aligned : now + wait;
+  LOGV("[Upload] backoff streak=%u wait=%lums\n", upload.failStreak, static_cast<unsigned long>(upload.nextUploadMs - now));
+}
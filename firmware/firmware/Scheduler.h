@@ -0,0 +1,11 @@
+#pragma once
+
+#include <Arduino.h>
+
+void syncServerClock(uint64_t serverEpochMs, uint32_t rttMs);
+void wallClockBegin();
+void wallClockConfigure(const String& tz, const String& ntpServer);
+bool wallClockValid();
+unsigned long nextAlignedMillis(uint32_t periodMs, uint32_t phaseMs);
+bool deadlineReached(unsigned long deadlineMs);
+void scheduleNextUpload(bool ok);
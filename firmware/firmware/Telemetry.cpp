@@ -0,0 +1,135 @@
+#include "Telemetry.h"
+
+#include <Arduino.h>
+
+#include "AppContext.h"
+#include "SceneEngine.h"
+
+namespace {
+const char* const kStageNames[kTelemetryStageCount] = {
+  "grab",
+  "upConnect",
+  "upSend",
+  "upResponse",
+  "cfgFetch",
+  "cfgParse",
+  "cfgApply",
+  "tlsHandshake",
+  "grabArchive",
+  "trigger",
+};
+
+const char* const kCounterNames[kTelemetryCounterCount] = {
+  "grabFail",
+  "fallbackFrame",
+  "xclkReinit",
+  "uploadOk",
+  "uploadHttpError",
+  "uploadRejected",
+  "configFail",
+  "tlsHandshake",
+  "connReuse",
+  "connRetry",
+  "staleFrame",
+  "archiveOk",
+  "triggerEvent",
+  "triggerSuppressed",
+  "otaFail",
+  "otaRollback",
+};
+
+size_t bucketFor(uint32_t elapsedUs) {
+  size_t bucket = 0;
+  while (elapsedUs != 0 && bucket < kTelemetryBuckets - 1) {
+    elapsedUs >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+}  // namespace
+
+void telemetryRecord(TelemetryStage stage, uint32_t elapsedUs) {
+  size_t idx = static_cast<size_t>(stage);
+  if (idx >= kTelemetryStageCount) return;
+  auto& hist = app().telemetry.stages[idx];
+  hist.count++;
+  hist.sumUs += elapsedUs;
+  if (elapsedUs > hist.maxUs) hist.maxUs = elapsedUs;
+  uint16_t& slot = hist.buckets[bucketFor(elapsedUs)];
+  if (slot != UINT16_MAX) slot++;
+}
+
+void telemetryCount(TelemetryCounter counter) {
+  size_t idx = static_cast<size_t>(counter);
+  if (idx >= kTelemetryCounterCount) return;
+  app().telemetry.counters[idx]++;
+}
+
+String telemetryJson() {
+  auto& ctx = app();
+  auto& telemetry = ctx.telemetry;
+  unsigned long now = millis();
+
+  String out;
+  out.reserve(768);
+  out += "{\"deviceId\":\"" + ctx.device.id + "\"";
+  out += ",\"uptimeMs\":" + String(now);
+  out += ",\"windowMs\":" + String(now - telemetry.windowStartMs);
+  out += ",\"heap\":{\"free\":" + String(ESP.getFreeHeap()) +
+         ",\"min\":" + String(ESP.getMinFreeHeap()) +
+         ",\"maxAlloc\":" + String(ESP.getMaxAllocHeap()) +
+         ",\"psram\":" + String(psramFound() ? ESP.getFreePsram() : 0) + "}";
+
+  out += ",\"counters\":{";
+  for (size_t i = 0; i < kTelemetryCounterCount; ++i) {
+    if (i) out += ',';
+    out += "\"" + String(kCounterNames[i]) + "\":" + String(telemetry.counters[i]);
+  }
+  out += "}";
+
+  sceneAccountTime();
+  const auto& scene = ctx.scene;
+  out += ",\"scene\":{\"mode\":\"" + String(sceneModeName(scene.mode)) + "\"";
+  out += ",\"index\":" + String(scene.exposureIndex);
+  out += ",\"luma\":" + String(scene.lastLuma);
+  out += ",\"transitions\":" + String(scene.transitions);
+  out += ",\"ms\":{";
+  for (size_t i = 0; i < kSceneModeCount; ++i) {
+    if (i) out += ',';
+    out += "\"" + String(sceneModeName(static_cast<SceneMode>(i))) + "\":" + String(scene.timeInModeMs[i]);
+  }
+  out += "}}";
+
+  out += ",\"stages\":{";
+  bool first = true;
+  for (size_t i = 0; i < kTelemetryStageCount; ++i) {
+    const auto& hist = telemetry.stages[i];
+    if (hist.count == 0) continue;
+    size_t used = kTelemetryBuckets;
+    while (used > 0 && hist.buckets[used - 1] == 0) used--;
+    if (!first) out += ',';
+    first = false;
+    out += "\"" + String(kStageNames[i]) + "\":{\"n\":" + String(hist.count) +
+           ",\"sumUs\":" + String(static_cast<unsigned long long>(hist.sumUs)) +
+           ",\"maxUs\":" + String(hist.maxUs) + ",\"b\":[";
+    for (size_t b = 0; b < used; ++b) {
+      if (b) out += ',';
+      out += String(hist.buckets[b]);
+    }
+    out += "]}";
+  }
+  out += "}}";
+  return out;
+}
+
+void telemetryReset() {
+  auto& telemetry = app().telemetry;
+  for (auto& hist : telemetry.stages) hist = LatencyHistogram{};
+  for (auto& counter : telemetry.counters) counter = 0;
+  telemetry.windowStartMs = millis();
+
+  auto& scene = app().scene;
+  scene.transitions = 0;
+  for (auto& ms : scene.timeInModeMs) ms = 0;
+  scene.accountedMs = telemetry.windowStartMs;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "AppContext.h"
+
+void telemetryRecord(TelemetryStage stage, uint32_t elapsedUs);
+void telemetryCount(TelemetryCounter counter);
+String telemetryJson();
+void telemetryReset();
@@ -5,9 +5,15 @@
 #include "AppContext.h"
 #include "BackendClient.h"
 #include "CameraController.h"
+#include "CaptureSchedule.h"
 #include "ConfigStorage.h"
+#include "EventTrigger.h"
 #include "Logging.h"
 #include "NetworkManager.h"
+#include "OtaUpdater.h"
+#include "SceneEngine.h"
+#include "Scheduler.h"
+#include "Telemetry.h"
 
 void setup() {
   Serial.begin(115200);
@@ -21,18 +27,23 @@ void setup() {
   ctx.device.id = getDeviceIdHex();
   LOGV("[Boot] ID=%s, PSRAM=%s\n", ctx.device.id.c_str(), psramFound() ? "OK" : "NO");
 
+  eventTriggerBegin();
   loadPrefs();
+  telemetryReset();
+  otaBegin();
   ensureWiFiOrPortal();
 
   if (!ctx.network.portalMode) {
+    wallClockBegin();
     registerWithBackend();
     if (!initCamera()) {
       LOGE_LN("[CAM] init failed (will retry)");
     }
-    fetchConfigFromBackend();
+    if (fetchConfigFromBackend()) otaMarkHealthy();
     testUploadConnectivity();
 
-    if (ctx.upload.autoUpload && ctx.camera.inited && WiFi.status() == WL_CONNECTED) {
+    // With a backend-assigned phase the first frame waits for its slot instead of joining the boot burst.
+    if (ctx.upload.autoUpload && ctx.camera.inited && WiFi.status() == WL_CONNECTED && !ctx.clock.synced) {
       bool ok = captureAndUploadOnce();
       if (!ok) {
         LOGE("[Upload@boot] FAIL HTTP=%d info=%s\n", ctx.http.lastStatus, ctx.http.lastError.c_str());
@@ -40,6 +51,7 @@ void setup() {
         LOGV("[Upload@boot] OK HTTP=%d info=%s\n", ctx.http.lastStatus, ctx.http.lastError.c_str());
       }
       ctx.upload.lastUploadMs = millis();
+      scheduleNextUpload(ok);
     }
   } else {
     LOGV_LN("[Portal] WiFi + Backend portal active");
@@ -55,24 +67,53 @@ void loop() {
   }
 
   static unsigned long lastCamRetry = 0;
-  if (!ctx.camera.inited && millis() - lastCamRetry > 5000) {
+  if (!cameraAvailable() && millis() - lastCamRetry > 5000) {
     lastCamRetry = millis();
     initCamera();
   }
 
-  if (WiFi.status() == WL_CONNECTED) {
-    unsigned long now = millis();
-    if (now - ctx.backend.lastConfigPollMs >= ctx.backend.pollIntervalSec * 1000UL) {
-      ctx.backend.lastConfigPollMs = now;
-      fetchConfigFromBackend();
+  // Events go ahead of everything else in the loop, scheduled uploads included. While the camera or
+  // WiFi is down the event stays pending (and the cooldown unarmed) until it can be captured.
+  int64_t firedUs = 0;
+  if (cameraAvailable() && WiFi.status() == WL_CONNECTED && eventTriggerTake(firedUs)) {
+    bool ok = captureEventAndUpload(firedUs);
+    if (!ok) {
+      LOGE("[Event] FAIL HTTP=%d info=%s\n", ctx.http.lastStatus, ctx.http.lastError.c_str());
+    } else {
+      LOGV("[Event] OK HTTP=%d info=%s\n", ctx.http.lastStatus, ctx.http.lastError.c_str());
     }
   }
 
-  if (ctx.upload.autoUpload && ctx.camera.inited && WiFi.status() == WL_CONNECTED) {
+  sceneEngineTick();
+  scheduleTick();
+
+  if (WiFi.status() == WL_CONNECTED && deadlineReached(ctx.backend.nextConfigPollMs)) {
+    ctx.backend.lastConfigPollMs = millis();
+    ctx.backend.nextConfigPollMs = nextAlignedMillis(ctx.backend.pollIntervalSec * 1000UL, ctx.backend.pollPhaseMs);
+    if (fetchConfigFromBackend()) otaMarkHealthy();
+  }
+
+  otaTick();
+  if (otaUpdateDue()) {
+    // On success this reboots into the new image; a failure is retried after a backoff.
+    otaRunUpdate();
+  }
+
+  if (ctx.telemetry.pushIntervalSec > 0 && WiFi.status() == WL_CONNECTED) {
     unsigned long now = millis();
-    if (now - ctx.upload.lastUploadMs >= ctx.upload.intervalSec * 1000UL) {
-      ctx.upload.lastUploadMs = now;
+    if (now - ctx.telemetry.lastPushMs >= ctx.telemetry.pushIntervalSec * 1000UL) {
+      // Re-anchor on the upload phase so telemetry pushes do not line up across the fleet either.
+      unsigned long aligned = nextAlignedMillis(ctx.telemetry.pushIntervalSec * 1000UL, ctx.upload.phaseMs);
+      ctx.telemetry.lastPushMs = aligned - ctx.telemetry.pushIntervalSec * 1000UL;
+      pushTelemetryToBackend();
+    }
+  }
+
+  if (ctx.upload.autoUpload && cameraAvailable() && WiFi.status() == WL_CONNECTED) {
+    if (deadlineReached(ctx.upload.nextUploadMs)) {
+      ctx.upload.lastUploadMs = millis();
       bool ok = captureAndUploadOnce();
+      scheduleNextUpload(ok);
       if (!ok) {
         LOGE("[Upload] FAIL HTTP=%d info=%s\n", ctx.http.lastStatus, ctx.http.lastError.c_str());
       } else {
@@ -81,5 +122,9 @@ void loop() {
     }
   }
 
-  delay(10);
+  unsigned long idleUntil = ctx.backend.nextConfigPollMs;
+  if (ctx.upload.autoUpload && static_cast<long>(ctx.upload.nextUploadMs - idleUntil) < 0) {
+    idleUntil = ctx.upload.nextUploadMs;
+  }
+  eventTriggerWait(idleUntil);
 }
\ No newline at end of file
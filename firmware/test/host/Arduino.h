@@ -0,0 +1,116 @@
+#pragma once
+// Host stand-in for the Arduino core: enough of String, Serial and timing for the host tests.
+#include <cctype>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <cstdlib>
+#include <algorithm>
+typedef bool boolean;
+#define F(x) x
+#define PROGMEM
+#define IRAM_ATTR
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+#define INPUT 0
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+#define OUTPUT 1
+#define HIGH 1
+#define LOW 0
+class String {
+ public:
+  std::string s;
+  String() {}
+  String(const char* c) : s(c ? c : "") {}
+  String(const std::string& c) : s(c) {}
+  String(char c) : s(1, c) {}
+  String(int v, int base = 10) { char b[34]; if (base == 16) snprintf(b, 34, "%x", v); else snprintf(b, 34, "%d", v); s = b; }
+  String(unsigned v, int base = 10) { char b[34]; if (base == 16) snprintf(b, 34, "%x", v); else snprintf(b, 34, "%u", v); s = b; }
+  String(long v) : s(std::to_string(v)) {}
+  String(unsigned long v, int base = 10) { char b[34]; if (base == 16) snprintf(b, 34, "%lx", v); else snprintf(b, 34, "%lu", v); s = b; }
+  String(long long v) : s(std::to_string(v)) {}
+  String(unsigned long long v) : s(std::to_string(v)) {}
+  String(float v, unsigned d = 2) { char b[40]; snprintf(b, 40, "%.*f", d, v); s = b; }
+  String(double v, unsigned d = 2) { char b[40]; snprintf(b, 40, "%.*f", d, v); s = b; }
+  const char* c_str() const { return s.c_str(); }
+  unsigned length() const { return s.size(); }
+  bool isEmpty() const { return s.empty(); }
+  int indexOf(char c, unsigned from = 0) const { auto p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+  int indexOf(const String& c, unsigned from = 0) const { auto p = s.find(c.s, from); return p == std::string::npos ? -1 : (int)p; }
+  int lastIndexOf(char c) const { auto p = s.rfind(c); return p == std::string::npos ? -1 : (int)p; }
+  String substring(unsigned a) const { return a >= s.size() ? String() : String(s.substr(a)); }
+  String substring(unsigned a, unsigned b) const { if (a >= s.size()) return String(); return String(s.substr(a, b - a)); }
+  char operator[](unsigned i) const { return s[i]; }
+  char& operator[](unsigned i) { return s[i]; }
+  char charAt(unsigned i) const { return s[i]; }
+  bool startsWith(const String& p) const { return s.rfind(p.s, 0) == 0; }
+  bool startsWith(const String& p, unsigned off) const { return s.compare(off, p.s.size(), p.s) == 0; }
+  bool endsWith(const String& p) const { return s.size() >= p.s.size() && s.compare(s.size() - p.s.size(), p.s.size(), p.s) == 0; }
+  bool equalsIgnoreCase(const String& o) const { return strcasecmp(s.c_str(), o.s.c_str()) == 0; }
+  bool equals(const String& o) const { return s == o.s; }
+  long toInt() const { return atol(s.c_str()); }
+  float toFloat() const { return atof(s.c_str()); }
+  void remove(unsigned i) { s.erase(i); }
+  void remove(unsigned i, unsigned n) { s.erase(i, n); }
+  void trim() {
+    size_t a = s.find_first_not_of(" \t\r\n");
+    size_t b = s.find_last_not_of(" \t\r\n");
+    s = a == std::string::npos ? std::string() : s.substr(a, b - a + 1);
+  }
+  void toLowerCase() { for (auto& c : s) c = static_cast<char>(tolower(static_cast<unsigned char>(c))); }
+  void toUpperCase() { for (auto& c : s) c = static_cast<char>(toupper(static_cast<unsigned char>(c))); }
+  void reserve(unsigned n) { s.reserve(n); }
+  void replace(const String&, const String&) {}
+  bool concat(const String& o) { s += o.s; return true; }
+  String& operator+=(const String& o) { s += o.s; return *this; }
+  String& operator+=(const char* o) { s += o; return *this; }
+  String& operator+=(char o) { s += o; return *this; }
+  String& operator+=(int o) { s += std::to_string(o); return *this; }
+  String& operator+=(unsigned o) { s += std::to_string(o); return *this; }
+  String& operator+=(long o) { s += std::to_string(o); return *this; }
+  String& operator+=(unsigned long o) { s += std::to_string(o); return *this; }
+  bool operator==(const String& o) const { return s == o.s; }
+  bool operator!=(const String& o) const { return s != o.s; }
+  bool operator==(const char* o) const { return s == o; }
+  bool operator!=(const char* o) const { return s != o; }
+  friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+  friend String operator+(const String& a, const char* b) { return String(a.s + b); }
+  friend String operator+(const char* a, const String& b) { return String(std::string(a) + b.s); }
+  friend String operator+(const String& a, char b) { return String(a.s + b); }
+};
+struct HardwareSerial {
+  void begin(int) {}
+  int printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+  void println(const char* s) { fprintf(stderr, "%s\n", s); }
+  void println(const String& s) { println(s.c_str()); }
+  void println() { fputc('\n', stderr); }
+  void print(char c) { fputc(c, stderr); }
+  void print(const char* s) { fputs(s, stderr); }
+};
+extern HardwareSerial Serial;
+struct EspClass { const char* getChipModel() { return ""; } int getChipRevision() { return 0; } int getChipCores() { return 2; } uint32_t getFlashChipSize() { return 0; } const char* getSdkVersion() { return ""; } uint64_t getEfuseMac() { return 0; } void restart() {} uint32_t getFreeHeap() { return 0; } uint32_t getMinFreeHeap() { return 0; } uint32_t getFreePsram() { return 0; } uint32_t getPsramSize() { return 0; } uint32_t getMaxAllocHeap() { return 0; } uint32_t getSketchSize() { return 0; } };
+extern EspClass ESP;
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void delayMicroseconds(unsigned);
+bool psramFound();
+long random(long);
+long random(long, long);
+void pinMode(int, int);
+void digitalWrite(int, int);
+int digitalRead(int);
+int digitalRead(int);
+void attachInterrupt(int, void (*)(), int);
+void detachInterrupt(int);
+int digitalPinToInterrupt(int);
+template <class T, class L, class H> T constrain(T v, L l, H h) { return v < l ? l : (v > h ? h : v); }
+#include "freertos/FreeRTOS.h"
+#define MALLOC_CAP_8BIT 4
+#define MALLOC_CAP_SPIRAM 1024
+inline void* heap_caps_malloc(size_t n, uint32_t) { return malloc(n); }
+void configTzTime(const char*, const char*, const char* = nullptr, const char* = nullptr);
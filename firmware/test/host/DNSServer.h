@@ -0,0 +1,5 @@
+#pragma once
+#include <Arduino.h>
+#include "IPAddress.h"
+class DNSServer { public: void start(int, const char*, IPAddress) {} void processNextRequest() {} };
+
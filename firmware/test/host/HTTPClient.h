@@ -0,0 +1,50 @@
+#pragma once
+// Host stand-in for the ESP32 HTTPClient: HTTP/1.1 over a caller-supplied WiFiClient,
+// keeping the socket after end() when setReuse(true) and the server allowed keep-alive.
+#include <Arduino.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "WiFiClient.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+#define HTTP_CODE_OK 200
+
+class HTTPClient {
+ public:
+  bool begin(WiFiClient& client, const String& url);
+  void addHeader(const String& name, const String& value, bool first = false, bool replace = true);
+  void setTimeout(uint16_t ms) { timeoutMs_ = ms; }
+  void setReuse(bool reuse) { reuse_ = reuse; }
+  void collectHeaders(const char* headerKeys[], const size_t count);
+  int GET() { return sendRequest("GET"); }
+  int POST(uint8_t* payload, size_t size) { return sendRequest("POST", payload, size); }
+  int POST(const String& payload) {
+    return sendRequest("POST", reinterpret_cast<uint8_t*>(const_cast<char*>(payload.c_str())), payload.length());
+  }
+  int sendRequest(const char* method, uint8_t* payload = nullptr, size_t size = 0);
+  String getString() { return String(body_); }
+  String header(const char* name);
+  bool hasHeader(const char* name);
+  int getSize() { return static_cast<int>(body_.size()); }
+  void end();
+
+ private:
+  WiFiClient* client_ = nullptr;
+  String host_;
+  uint16_t port_ = 0;
+  String path_;
+  uint16_t timeoutMs_ = 5000;
+  bool reuse_ = true;
+  bool canReuse_ = false;
+  std::vector<std::pair<String, String>> requestHeaders_;
+  std::vector<String> collect_;
+  std::vector<std::pair<String, String>> responseHeaders_;
+  std::string body_;
+};
@@ -0,0 +1,3 @@
+#pragma once
+#include <Arduino.h>
+struct IPAddress { IPAddress() {} IPAddress(int, int, int, int) {} String toString() const { return ""; } };
@@ -0,0 +1,6 @@
+#pragma once
+#include <Arduino.h>
+class Preferences { public: bool begin(const char*, bool) { return true; } void end() {}
+ String getString(const char*, const String& d = String()) { return d; } int getInt(const char*, int d = 0) { return d; } unsigned getUInt(const char*, unsigned d = 0) { return d; } bool getBool(const char*, bool d = false) { return d; } uint16_t getUShort(const char*, uint16_t d = 0) { return d; } int16_t getShort(const char*, int16_t d = 0) { return d; }
+ uint8_t getUChar(const char*, uint8_t d = 0) { return d; } size_t putUChar(const char*, uint8_t) { return 0; }
+ size_t putString(const char*, const String&) { return 0; } size_t putInt(const char*, int) { return 0; } size_t putUInt(const char*, unsigned) { return 0; } size_t putBool(const char*, bool) { return 0; } size_t putUShort(const char*, uint16_t) { return 0; } size_t putShort(const char*, int16_t) { return 0; } bool remove(const char*) { return true; } };
@@ -0,0 +1,5 @@
+#pragma once
+#include <Arduino.h>
+#include <functional>
+enum { HTTP_GET, HTTP_POST };
+class WebServer { public: WebServer(int) {} void onNotFound(std::function<void()>) {} void on(const char*, int, std::function<void()>) {} void sendHeader(const String&, const String&, bool = false) {} void send(int, const char*, const String&) {} bool hasArg(const char*) { return false; } String arg(const char*) { return ""; } void begin() {} void handleClient() {} };
@@ -0,0 +1,36 @@
+#pragma once
+// Host stand-in for the ESP32 WiFiClient: a blocking POSIX TCP socket.
+#include <Arduino.h>
+
+class Client {
+ public:
+  virtual ~Client() {}
+};
+
+class WiFiClient : public Client {
+ public:
+  WiFiClient() = default;
+  WiFiClient(const WiFiClient&) = delete;
+  WiFiClient& operator=(const WiFiClient&) = delete;
+  ~WiFiClient() override { closeSocket(); }
+
+  virtual int connect(const char* host, uint16_t port);
+  virtual uint8_t connected();
+  virtual void stop() { closeSocket(); }
+  virtual size_t write(const uint8_t* buf, size_t len);
+  virtual int read(uint8_t* buf, size_t len);
+  int read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  void setTimeout(uint32_t ms) { timeoutMs_ = ms; }
+  void setNoDelay(bool) {}
+  int fd() const { return fd_; }
+
+ protected:
+  bool openSocket(const char* host, uint16_t port);
+  void closeSocket();
+
+  int fd_ = -1;
+  uint32_t timeoutMs_ = 5000;
+};
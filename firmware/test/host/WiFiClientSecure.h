@@ -0,0 +1,37 @@
+#pragma once
+// Host stand-in for the ESP32 WiFiClientSecure: OpenSSL on top of the host WiFiClient socket.
+// Like the mbedtls client, a CA certificate enables chain and host name checks; setInsecure() skips both.
+#include <string>
+
+#include "WiFiClient.h"
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+
+class WiFiClientSecure : public WiFiClient {
+ public:
+  ~WiFiClientSecure() override { stop(); }
+
+  void setInsecure() {
+    insecure_ = true;
+    caCert_.clear();
+  }
+  void setCACert(const char* pem) {
+    insecure_ = false;
+    caCert_ = pem ? pem : "";
+  }
+  void setHandshakeTimeout(unsigned long sec) { handshakeTimeoutSec_ = sec; }
+
+  int connect(const char* host, uint16_t port) override;
+  uint8_t connected() override;
+  void stop() override;
+  size_t write(const uint8_t* buf, size_t len) override;
+  int read(uint8_t* buf, size_t len) override;
+
+ private:
+  SSL_CTX* ctx_ = nullptr;
+  SSL* ssl_ = nullptr;
+  std::string caCert_;
+  bool insecure_ = false;
+  unsigned long handshakeTimeoutSec_ = 120;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+typedef enum { FRAMESIZE_96X96, FRAMESIZE_QQVGA, FRAMESIZE_QCIF, FRAMESIZE_HQVGA, FRAMESIZE_240X240, FRAMESIZE_QVGA, FRAMESIZE_CIF, FRAMESIZE_HVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_XGA, FRAMESIZE_HD, FRAMESIZE_SXGA, FRAMESIZE_UXGA, FRAMESIZE_INVALID } framesize_t;
+typedef enum { GAINCEILING_2X, GAINCEILING_4X, GAINCEILING_8X, GAINCEILING_16X, GAINCEILING_32X, GAINCEILING_64X, GAINCEILING_128X } gainceiling_t;
+typedef enum { PIXFORMAT_RGB565, PIXFORMAT_YUV422, PIXFORMAT_GRAYSCALE, PIXFORMAT_JPEG } pixformat_t;
+typedef enum { CAMERA_FB_IN_PSRAM, CAMERA_FB_IN_DRAM } camera_fb_location_t;
+typedef enum { CAMERA_GRAB_WHEN_EMPTY, CAMERA_GRAB_LATEST } camera_grab_mode_t;
+typedef enum { LEDC_CHANNEL_0 } ledc_channel_t;
+typedef enum { LEDC_TIMER_0 } ledc_timer_t;
+typedef struct { uint16_t width; uint16_t height; } resolution_info_t;
+extern const resolution_info_t resolution[];
+typedef struct {
+  int pin_pwdn, pin_reset, pin_xclk, pin_sscb_sda, pin_sscb_scl, pin_d7, pin_d6, pin_d5, pin_d4, pin_d3, pin_d2, pin_d1, pin_d0, pin_vsync, pin_href, pin_pclk;
+  int xclk_freq_hz; ledc_timer_t ledc_timer; ledc_channel_t ledc_channel; pixformat_t pixel_format; framesize_t frame_size; int jpeg_quality; size_t fb_count; camera_fb_location_t fb_location; camera_grab_mode_t grab_mode;
+} camera_config_t;
+typedef struct { uint8_t* buf; size_t len; size_t width; size_t height; pixformat_t format; struct { long tv_sec; long tv_usec; } timestamp; } camera_fb_t;
+typedef struct { framesize_t framesize; uint8_t quality; int8_t brightness, contrast, saturation, sharpness; uint8_t denoise, special_effect, wb_mode, awb, awb_gain, aec, aec2; int8_t ae_level; uint16_t aec_value; uint8_t agc, agc_gain, gainceiling, bpc, wpc, raw_gma, lenc, hmirror, vflip, dcw, colorbar; } camera_status_t;
+typedef struct { uint16_t PID; } sensor_id_t;
+typedef struct _sensor sensor_t;
+struct _sensor {
+  sensor_id_t id; camera_status_t status; pixformat_t pixformat;
+  int (*set_framesize)(sensor_t*, framesize_t);
+  int (*set_quality)(sensor_t*, int);
+  int (*set_whitebal)(sensor_t*, int);
+  int (*set_wb_mode)(sensor_t*, int);
+  int (*set_hmirror)(sensor_t*, int);
+  int (*set_vflip)(sensor_t*, int);
+  int (*set_brightness)(sensor_t*, int);
+  int (*set_contrast)(sensor_t*, int);
+  int (*set_saturation)(sensor_t*, int);
+  int (*set_sharpness)(sensor_t*, int);
+  int (*set_awb_gain)(sensor_t*, int);
+  int (*set_gain_ctrl)(sensor_t*, int);
+  int (*set_exposure_ctrl)(sensor_t*, int);
+  int (*set_gainceiling)(sensor_t*, gainceiling_t);
+  int (*set_ae_level)(sensor_t*, int);
+  int (*set_aec2)(sensor_t*, int);
+  int (*set_aec_value)(sensor_t*, int);
+  int (*set_agc_gain)(sensor_t*, int);
+  int (*set_lenc)(sensor_t*, int);
+  int (*set_raw_gma)(sensor_t*, int);
+  int (*set_bpc)(sensor_t*, int);
+  int (*set_wpc)(sensor_t*, int);
+  int (*set_dcw)(sensor_t*, int);
+  int (*set_colorbar)(sensor_t*, int);
+  int (*set_special_effect)(sensor_t*, int);
+  int (*set_denoise)(sensor_t*, int);
+  int (*set_res_raw)(sensor_t*, int, int, int, int, int, int, int, int, int, int, bool, bool);
+  int (*set_reg)(sensor_t*, int, int, int);
+  int (*get_reg)(sensor_t*, int, int);
+};
+esp_err_t esp_camera_init(const camera_config_t*);
+esp_err_t esp_camera_deinit();
+camera_fb_t* esp_camera_fb_get();
+void esp_camera_fb_return(camera_fb_t*);
+sensor_t* esp_camera_sensor_get();
+#define OV2640_PID 0x26
@@ -0,0 +1,328 @@
+// Host implementations behind the stand-in Arduino, WiFiClient, WiFiClientSecure and HTTPClient headers.
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdarg>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+int HardwareSerial::printf(const char* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int n = vfprintf(stderr, fmt, args);
+  va_end(args);
+  return n;
+}
+
+namespace {
+const auto kStart = std::chrono::steady_clock::now();
+
+void setSocketTimeout(int fd, uint32_t ms) {
+  timeval tv;
+  tv.tv_sec = ms / 1000;
+  tv.tv_usec = (ms % 1000) * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+}  // namespace
+
+unsigned long millis() {
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - kStart).count());
+}
+
+unsigned long micros() {
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - kStart).count());
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// --- WiFiClient ---
+
+bool WiFiClient::openSocket(const char* host, uint16_t port) {
+  closeSocket();
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res = nullptr;
+  if (getaddrinfo(host, std::to_string(port).c_str(), &hints, &res) != 0) return false;
+  for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+    int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+    if (fd < 0) continue;
+    setSocketTimeout(fd, timeoutMs_);
+    if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      fd_ = fd;
+      break;
+    }
+    ::close(fd);
+  }
+  freeaddrinfo(res);
+  return fd_ >= 0;
+}
+
+void WiFiClient::closeSocket() {
+  if (fd_ >= 0) ::close(fd_);
+  fd_ = -1;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  return openSocket(host, port) ? 1 : 0;
+}
+
+uint8_t WiFiClient::connected() {
+  if (fd_ < 0) return 0;
+  char c;
+  ssize_t n = recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+    closeSocket();
+    return 0;
+  }
+  return 1;
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t len) {
+  size_t sent = 0;
+  while (fd_ >= 0 && sent < len) {
+    ssize_t n = send(fd_, buf + sent, len - sent, MSG_NOSIGNAL);
+    if (n <= 0) break;
+    sent += static_cast<size_t>(n);
+  }
+  return sent;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t len) {
+  if (fd_ < 0) return -1;
+  ssize_t n = recv(fd_, buf, len, 0);
+  return n > 0 ? static_cast<int>(n) : -1;
+}
+
+// --- WiFiClientSecure ---
+
+int WiFiClientSecure::connect(const char* host, uint16_t port) {
+  stop();
+  if (!openSocket(host, port)) return 0;
+  setSocketTimeout(fd_, static_cast<uint32_t>(handshakeTimeoutSec_ * 1000));
+
+  ctx_ = SSL_CTX_new(TLS_client_method());
+  if (!ctx_) {
+    stop();
+    return 0;
+  }
+  if (!insecure_) {
+    BIO* bio = BIO_new_mem_buf(caCert_.data(), static_cast<int>(caCert_.size()));
+    X509* ca = bio ? PEM_read_bio_X509(bio, nullptr, nullptr, nullptr) : nullptr;
+    BIO_free(bio);
+    if (!ca || X509_STORE_add_cert(SSL_CTX_get_cert_store(ctx_), ca) != 1) {
+      X509_free(ca);
+      stop();
+      return 0;
+    }
+    X509_free(ca);
+    SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER, nullptr);
+  } else {
+    SSL_CTX_set_verify(ctx_, SSL_VERIFY_NONE, nullptr);
+  }
+
+  ssl_ = SSL_new(ctx_);
+  SSL_set_fd(ssl_, fd_);
+  SSL_set_tlsext_host_name(ssl_, host);
+  if (!insecure_) SSL_set1_host(ssl_, host);
+  if (SSL_connect(ssl_) != 1) {
+    ERR_clear_error();
+    stop();
+    return 0;
+  }
+  setSocketTimeout(fd_, timeoutMs_);
+  return 1;
+}
+
+uint8_t WiFiClientSecure::connected() {
+  if (!ssl_ || fd_ < 0) return 0;
+  if (SSL_pending(ssl_) > 0) return 1;
+  pollfd p{fd_, POLLIN, 0};
+  if (poll(&p, 1, 0) <= 0) return 1;
+  // Readable while idle: either records for the next response or the peer closing the socket.
+  int flags = fcntl(fd_, F_GETFL);
+  fcntl(fd_, F_SETFL, flags | O_NONBLOCK);
+  char c;
+  int n = SSL_peek(ssl_, &c, 1);
+  int err = n > 0 ? SSL_ERROR_NONE : SSL_get_error(ssl_, n);
+  fcntl(fd_, F_SETFL, flags);
+  if (n > 0 || err == SSL_ERROR_WANT_READ) return 1;
+  ERR_clear_error();
+  stop();
+  return 0;
+}
+
+void WiFiClientSecure::stop() {
+  if (ssl_) {
+    SSL_free(ssl_);
+    ssl_ = nullptr;
+  }
+  if (ctx_) {
+    SSL_CTX_free(ctx_);
+    ctx_ = nullptr;
+  }
+  closeSocket();
+}
+
+size_t WiFiClientSecure::write(const uint8_t* buf, size_t len) {
+  if (!ssl_) return 0;
+  int n = SSL_write(ssl_, buf, static_cast<int>(len));
+  return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+int WiFiClientSecure::read(uint8_t* buf, size_t len) {
+  if (!ssl_) return -1;
+  int n = SSL_read(ssl_, buf, static_cast<int>(len));
+  return n > 0 ? n : -1;
+}
+
+// --- HTTPClient ---
+
+bool HTTPClient::begin(WiFiClient& client, const String& url) {
+  client_ = &client;
+  requestHeaders_.clear();
+  responseHeaders_.clear();
+  body_.clear();
+  canReuse_ = false;
+  int schemeEnd = url.indexOf("://");
+  if (schemeEnd < 0) return false;
+  bool tls = url.startsWith("https://");
+  int hostStart = schemeEnd + 3;
+  int pathStart = url.indexOf('/', hostStart);
+  String authority = pathStart < 0 ? url.substring(hostStart) : url.substring(hostStart, pathStart);
+  path_ = pathStart < 0 ? String("/") : url.substring(pathStart);
+  int colon = authority.indexOf(':');
+  host_ = colon < 0 ? authority : authority.substring(0, colon);
+  port_ = colon < 0 ? (tls ? 443 : 80) : static_cast<uint16_t>(authority.substring(colon + 1).toInt());
+  return host_.length() > 0;
+}
+
+void HTTPClient::addHeader(const String& name, const String& value, bool first, bool replace) {
+  if (replace) {
+    for (auto& h : requestHeaders_) {
+      if (h.first.equalsIgnoreCase(name)) {
+        h.second = value;
+        return;
+      }
+    }
+  }
+  if (first) {
+    requestHeaders_.insert(requestHeaders_.begin(), {name, value});
+  } else {
+    requestHeaders_.push_back({name, value});
+  }
+}
+
+void HTTPClient::collectHeaders(const char* headerKeys[], const size_t count) {
+  collect_.clear();
+  for (size_t i = 0; i < count; ++i) collect_.push_back(headerKeys[i]);
+}
+
+int HTTPClient::sendRequest(const char* method, uint8_t* payload, size_t size) {
+  if (!client_) return HTTPC_ERROR_NOT_CONNECTED;
+  responseHeaders_.clear();
+  body_.clear();
+  canReuse_ = false;
+  // Like the ESP32 client: an already-open socket is used as is.
+  if (!client_->connected() && !client_->connect(host_.c_str(), port_)) return HTTPC_ERROR_CONNECTION_REFUSED;
+  client_->setTimeout(timeoutMs_);
+
+  std::string request = std::string(method) + " " + path_.c_str() + " HTTP/1.1\r\nHost: " + host_.c_str();
+  if (port_ != 80 && port_ != 443) request += ":" + std::to_string(port_);
+  request += std::string("\r\nConnection: ") + (reuse_ ? "keep-alive" : "close") + "\r\n";
+  for (const auto& h : requestHeaders_) request += std::string(h.first.c_str()) + ": " + h.second.c_str() + "\r\n";
+  if (payload || !strcmp(method, "POST")) request += "Content-Length: " + std::to_string(size) + "\r\n";
+  request += "\r\n";
+  if (client_->write(reinterpret_cast<const uint8_t*>(request.data()), request.size()) != request.size()) {
+    return HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+  if (size && client_->write(payload, size) != size) return HTTPC_ERROR_SEND_HEADER_FAILED;
+
+  std::string head;
+  while (head.find("\r\n\r\n") == std::string::npos) {
+    int c = client_->read();
+    if (c < 0) return HTTPC_ERROR_CONNECTION_LOST;
+    head += static_cast<char>(c);
+  }
+  int code = 0;
+  int minor = 1;
+  if (sscanf(head.c_str(), "HTTP/1.%d %d", &minor, &code) != 2) return HTTPC_ERROR_CONNECTION_LOST;
+  canReuse_ = minor >= 1;
+  long contentLength = -1;
+  size_t lineStart = head.find("\r\n") + 2;
+  while (lineStart < head.size()) {
+    size_t lineEnd = head.find("\r\n", lineStart);
+    if (lineEnd == lineStart || lineEnd == std::string::npos) break;
+    std::string line = head.substr(lineStart, lineEnd - lineStart);
+    lineStart = lineEnd + 2;
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) continue;
+    String name = line.substr(0, colon).c_str();
+    String value = line.substr(colon + 1).c_str();
+    value.trim();
+    if (name.equalsIgnoreCase("Content-Length")) contentLength = value.toInt();
+    if (name.equalsIgnoreCase("Connection")) {
+      String lower = value;
+      lower.toLowerCase();
+      canReuse_ = lower != "close";
+    }
+    responseHeaders_.push_back({name, value});
+  }
+
+  uint8_t buf[4096];
+  while (contentLength < 0 || static_cast<long>(body_.size()) < contentLength) {
+    size_t want = sizeof(buf);
+    if (contentLength >= 0) want = std::min<size_t>(want, contentLength - body_.size());
+    int n = client_->read(buf, want);
+    if (n <= 0) {
+      if (contentLength >= 0) return HTTPC_ERROR_CONNECTION_LOST;
+      canReuse_ = false;
+      break;
+    }
+    body_.append(reinterpret_cast<char*>(buf), n);
+  }
+  return code;
+}
+
+String HTTPClient::header(const char* name) {
+  for (const auto& h : responseHeaders_) {
+    if (h.first.equalsIgnoreCase(name)) return h.second;
+  }
+  return String();
+}
+
+bool HTTPClient::hasHeader(const char* name) {
+  for (const auto& h : responseHeaders_) {
+    if (h.first.equalsIgnoreCase(name)) return true;
+  }
+  return false;
+}
+
+void HTTPClient::end() {
+  if (client_ && !(reuse_ && canReuse_)) client_->stop();
+  client_ = nullptr;
+}
@@ -0,0 +1,23 @@
+# Writes the backend's HDP1 delta (backend/core/delta.py) between two images, uncompressed.
+# Usage: python3 make_delta.py OLD NEW PATCH
+import sys
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+from backend.core.delta import apply_patch, make_patch  # noqa: E402
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit("usage: make_delta.py OLD NEW PATCH")
+    old = Path(sys.argv[1]).read_bytes()
+    new = Path(sys.argv[2]).read_bytes()
+    patch = make_patch(old, new)
+    # Same self-check the backend runs before caching a patch.
+    if apply_patch(old, patch) != new:
+        sys.exit("make_delta.py: patch does not reproduce NEW")
+    Path(sys.argv[3]).write_bytes(patch)
+
+
+if __name__ == "__main__":
+    main()
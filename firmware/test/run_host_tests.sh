@@ -0,0 +1,66 @@
+#!/bin/sh
+# Builds and runs the firmware host tests (Linux, g++, OpenSSL headers, python3).
+#   sh firmware/test/run_host_tests.sh
+# The DeltaPatch pairs are x86 ELF builds, not ESP32 app images (no esp_image header, segment
+# layout, padding or appended hash), so they say nothing about patch sizes on device images. Real
+# exports from the Arduino IDE / arduino-cli can be added as OLD:NEW pairs:
+#   ESP_IMAGES="fw-1.1.0.bin:fw-1.2.0.bin" sh firmware/test/run_host_tests.sh
+set -eu
+
+here=$(cd "$(dirname "$0")" && pwd)
+fw="$here/../firmware"
+work=$(mktemp -d)
+stub_pid=
+cleanup() {
+  [ -n "$stub_pid" ] && kill "$stub_pid" 2>/dev/null || true
+  rm -rf "$work"
+}
+trap cleanup EXIT INT TERM
+
+CXX=${CXX:-g++}
+CXXFLAGS="-std=gnu++17 -O1 -g -Wall -Wextra -Wno-unused-parameter"
+
+# HttpTransport over TLS: self-signed localhost certificate, plus an unrelated one for the untrusted case.
+for name in stub other; do
+  openssl req -x509 -newkey rsa:2048 -nodes -days 2 -subj "/CN=localhost" \
+    -addext "subjectAltName=DNS:localhost,IP:127.0.0.1" \
+    -keyout "$work/$name.key" -out "$work/$name.pem" 2>/dev/null
+done
+$CXX $CXXFLAGS -I"$here/host" -I"$fw" -o "$work/test_http_transport" \
+  "$here/test_http_transport.cpp" "$fw/HttpTransport.cpp" "$fw/AppContext.cpp" "$here/host/host.cpp" -lssl -lcrypto
+python3 "$here/tls_stub.py" "$work/stub.pem" "$work/stub.key" > "$work/port" &
+stub_pid=$!
+for _ in 1 2 3 4 5 6 7 8 9 10; do
+  [ -s "$work/port" ] && break
+  sleep 0.2
+done
+"$work/test_http_transport" "$(cat "$work/port")" "$work/stub.pem" "$work/other.pem"
+
+# DeltaPatch against backend/core/delta.py. The image pairs are host builds of firmware sources:
+# a version bump, a compiler flag change (code moves everywhere) and an added translation unit.
+image() {
+  out=$1
+  shift
+  $CXX $CXXFLAGS "$@" -I"$here/host" -I"$fw" -o "$work/$out" \
+    "$here/test_http_transport.cpp" "$fw/HttpTransport.cpp" "$fw/AppContext.cpp" "$here/host/host.cpp" -lssl -lcrypto
+}
+image v1 -DFIRMWARE_VERSION='"1.1.0"'
+image v2 -DFIRMWARE_VERSION='"1.2.0"'
+image v2-o2 -DFIRMWARE_VERSION='"1.2.0"' -O2
+image v3 -DFIRMWARE_VERSION='"1.3.0"' "$fw/DeltaPatch.cpp"
+pairs=
+for pair in v1:v2 v1:v2-o2 v2:v3 v3:v1; do
+  old=${pair%%:*}
+  new=${pair##*:}
+  python3 "$here/make_delta.py" "$work/$old" "$work/$new" "$work/$old-$new.hdp"
+  pairs="$pairs $work/$old $work/$new $work/$old-$new.hdp"
+done
+n=0
+for pair in ${ESP_IMAGES:-}; do
+  n=$((n + 1))
+  python3 "$here/make_delta.py" "${pair%%:*}" "${pair##*:}" "$work/esp$n.hdp"
+  pairs="$pairs ${pair%%:*} ${pair##*:} $work/esp$n.hdp"
+done
+$CXX $CXXFLAGS -I"$fw" -o "$work/test_delta_patch" "$here/test_delta_patch.cpp" "$fw/DeltaPatch.cpp" -lcrypto
+# shellcheck disable=SC2086
+"$work/test_delta_patch" $pairs
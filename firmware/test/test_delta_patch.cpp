@@ -0,0 +1,157 @@
+// Host test for DeltaPatch: applies patches made by backend/core/delta.py (make_delta.py) to real
+// image pairs and compares the result byte for byte. The patch is fed in several chunk sizes to
+// cover every phase boundary, and the old image is read through readOld like the flash partition.
+// Usage: test_delta_patch OLD NEW PATCH [OLD NEW PATCH ...]
+#include <openssl/sha.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "DeltaPatch.h"
+
+namespace {
+int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+using Bytes = std::vector<uint8_t>;
+
+const char* baseName(const char* path) {
+  const char* slash = strrchr(path, '/');
+  return slash ? slash + 1 : path;
+}
+
+Bytes readFile(const char* path) {
+  std::ifstream in(path, std::ios::binary);
+  return Bytes(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+struct Images {
+  const Bytes* old = nullptr;
+  Bytes out;
+  uint32_t lastReadEnd = 0;
+  uint32_t backwardReads = 0;
+  bool baseChecked = false;
+  bool acceptBase = true;
+};
+
+bool readOld(void* ctx, uint32_t offset, uint8_t* buf, size_t len) {
+  auto* images = static_cast<Images*>(ctx);
+  if (offset > images->old->size() || len > images->old->size() - offset) return false;
+  if (offset < images->lastReadEnd) images->backwardReads++;
+  images->lastReadEnd = offset + static_cast<uint32_t>(len);
+  memcpy(buf, images->old->data() + offset, len);
+  return true;
+}
+
+bool writeNew(void* ctx, const uint8_t* buf, size_t len) {
+  auto* images = static_cast<Images*>(ctx);
+  images->out.insert(images->out.end(), buf, buf + len);
+  return true;
+}
+
+bool checkBase(void* ctx, uint32_t oldSize, const uint8_t* oldSha256) {
+  auto* images = static_cast<Images*>(ctx);
+  uint8_t sha[SHA256_DIGEST_LENGTH];
+  SHA256(images->old->data(), images->old->size(), sha);
+  images->baseChecked = oldSize == images->old->size() && memcmp(sha, oldSha256, sizeof(sha)) == 0;
+  return images->acceptBase && images->baseChecked;
+}
+
+DeltaPatchStatus apply(Images& images, const Bytes& patch, size_t chunk, DeltaPatchState& state) {
+  DeltaPatchIo io;
+  io.ctx = &images;
+  io.readOld = readOld;
+  io.writeNew = writeNew;
+  io.checkBase = checkBase;
+  deltaPatchBegin(state, io);
+  DeltaPatchStatus status = DeltaPatchStatus::NeedMore;
+  for (size_t pos = 0; pos < patch.size() && status == DeltaPatchStatus::NeedMore; pos += chunk) {
+    size_t n = patch.size() - pos < chunk ? patch.size() - pos : chunk;
+    status = deltaPatchFeed(state, patch.data() + pos, n);
+  }
+  return status;
+}
+
+void testPair(const char* oldPath, const char* newPath, const char* patchPath) {
+  const Bytes old = readFile(oldPath);
+  const Bytes expected = readFile(newPath);
+  const Bytes patch = readFile(patchPath);
+  CHECK(!old.empty() && !expected.empty() && patch.size() > kDeltaHeaderSize);
+  static DeltaPatchState state;  // ~1 KB output buffer, as on the device
+
+  uint32_t backwardReads = 0;
+  for (size_t chunk : {size_t(1), size_t(7), size_t(1024), patch.size()}) {
+    Images images;
+    images.old = &old;
+    DeltaPatchStatus status = apply(images, patch, chunk, state);
+    if (status != DeltaPatchStatus::Done) {
+      fprintf(stderr, "%s: chunk %zu: status %d (%s)\n", baseName(newPath), chunk, static_cast<int>(status),
+              state.error ? state.error : "incomplete");
+    }
+    CHECK(status == DeltaPatchStatus::Done);
+    CHECK(images.baseChecked);
+    CHECK(images.out == expected);
+    uint8_t sha[SHA256_DIGEST_LENGTH];
+    SHA256(images.out.data(), images.out.size(), sha);
+    CHECK(memcmp(sha, state.newSha256, sizeof(sha)) == 0);
+    backwardReads = images.backwardReads;
+  }
+
+  // A different base image is refused before anything is written.
+  {
+    Images images;
+    images.old = &old;
+    images.acceptBase = false;
+    CHECK(apply(images, patch, patch.size(), state) == DeltaPatchStatus::Error);
+    CHECK(images.out.empty());
+  }
+  // A truncated patch never reports Done.
+  {
+    Images images;
+    images.old = &old;
+    Bytes cut(patch.begin(), patch.end() - 1);
+    CHECK(apply(images, cut, cut.size(), state) != DeltaPatchStatus::Done);
+  }
+  // A DIFF offset varint whose fifth byte sets bits above 31 must fail, not wrap to offset 0;
+  // 0xFFFFFFFF still decodes and is then refused as outside the base image.
+  {
+    const uint8_t tooLong[] = {1, 0x80, 0x80, 0x80, 0x80, 0x10, 1};
+    const uint8_t maxValue[] = {1, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 1};
+    for (const auto& body : {Bytes(tooLong, tooLong + sizeof(tooLong)), Bytes(maxValue, maxValue + sizeof(maxValue))}) {
+      Images images;
+      images.old = &old;
+      Bytes bad(patch.begin(), patch.begin() + kDeltaHeaderSize);
+      bad.insert(bad.end(), body.begin(), body.end());
+      CHECK(apply(images, bad, bad.size(), state) == DeltaPatchStatus::Error);
+      const char* expectedError = body[5] == 0x10 ? "bad varint" : "diff outside base image";
+      CHECK(state.error && strcmp(state.error, expectedError) == 0);
+    }
+  }
+  printf("%s -> %s: %zu patch bytes, %u backward seeks in the old image\n", baseName(oldPath),
+         baseName(newPath), patch.size(), static_cast<unsigned>(backwardReads));
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 4 || (argc - 1) % 3 != 0) {
+    fprintf(stderr, "usage: %s OLD NEW PATCH [OLD NEW PATCH ...]\n", argv[0]);
+    return 2;
+  }
+  for (int i = 1; i + 2 < argc; i += 3) testPair(argv[i], argv[i + 1], argv[i + 2]);
+  if (failures) {
+    fprintf(stderr, "test_delta_patch: %d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("test_delta_patch: ok\n");
+  return 0;
+}
@@ -0,0 +1,150 @@
+// Host test for HttpTransport against a local TLS stub (tls_stub.py): handshake with and without a
+// pinned CA, keep-alive reuse of the slot socket, and recovery when the server closes it.
+// Usage: test_http_transport PORT CA_PEM OTHER_CA_PEM (the stub closes sockets idle for 1 s)
+#include <Arduino.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "AppContext.h"
+#include "HttpTransport.h"
+#include "Telemetry.h"
+
+namespace {
+int failures = 0;
+uint32_t counters[static_cast<size_t>(TelemetryCounter::Count)] = {};
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+uint32_t count(TelemetryCounter counter) {
+  return counters[static_cast<size_t>(counter)];
+}
+
+String readFile(const char* path) {
+  std::ifstream in(path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return String(ss.str());
+}
+
+struct Response {
+  bool opened = false;
+  bool reused = false;
+  int code = 0;
+  String body;
+};
+
+Response get(const String& url, bool keepAlive = true) {
+  Response r;
+  HTTPClient* http = beginHttpRequest(url, r.reused);
+  if (!http) return r;
+  r.opened = true;
+  http->setTimeout(5000);
+  r.code = http->GET();
+  if (r.code > 0) r.body = http->getString();
+  endHttpRequest(http, keepAlive && r.code > 0);
+  return r;
+}
+
+String connOf(const String& body) {
+  int space = body.indexOf(' ');
+  return space < 0 ? body : body.substring(0, space);
+}
+}  // namespace
+
+void telemetryRecord(TelemetryStage, uint32_t) {}
+
+void telemetryCount(TelemetryCounter counter) {
+  counters[static_cast<size_t>(counter)]++;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 4) {
+    fprintf(stderr, "usage: %s PORT CA_PEM OTHER_CA_PEM\n", argv[0]);
+    return 2;
+  }
+  const String base = String("https://localhost:") + argv[1];
+  auto& backend = app().backend;
+
+  // Pinned CA: handshake verifies the chain and the host name, then the socket is kept.
+  backend.caCert = readFile(argv[2]);
+  Response first = get(base + "/ping");
+  CHECK(first.opened && first.code == 200);
+  CHECK(!first.reused);
+  CHECK(count(TelemetryCounter::TlsHandshake) == 1);
+
+  Response second = get(base + "/api/config?deviceId=x");
+  CHECK(second.code == 200);
+  CHECK(second.reused);
+  CHECK(connOf(second.body) == connOf(first.body));
+  CHECK(second.body.endsWith("req=2"));
+  CHECK(count(TelemetryCounter::TlsHandshake) == 1);
+  CHECK(count(TelemetryCounter::ConnReuse) == 1);
+
+  // Caller gives up the socket (e.g. after an error): next request handshakes again.
+  Response dropped = get(base + "/ping", false);
+  CHECK(dropped.reused && dropped.code == 200);
+  Response fresh = get(base + "/ping");
+  CHECK(fresh.code == 200 && !fresh.reused);
+  CHECK(connOf(fresh.body) != connOf(first.body));
+  CHECK(count(TelemetryCounter::TlsHandshake) == 2);
+
+  // "Connection: close" from the server ends reuse.
+  Response closing = get(base + "/close");
+  CHECK(closing.code == 200 && closing.reused);
+  Response afterClose = get(base + "/ping");
+  CHECK(afterClose.code == 200 && !afterClose.reused);
+
+  // Server closes an idle kept-alive socket without saying so: the slot must notice, not fail the request.
+  Response drop = get(base + "/drop");
+  CHECK(drop.code == 200 && drop.reused);
+  delay(200);
+  Response afterDrop = get(base + "/ping");
+  CHECK(afterDrop.code == 200 && !afterDrop.reused);
+  CHECK(count(TelemetryCounter::TlsHandshake) == 4);
+
+  // Server's keep-alive timeout expires while the socket sits idle within the device budget:
+  // the close has arrived by the next request, which reconnects instead of failing.
+  delay(1500);
+  Response afterIdle = get(base + "/ping");
+  CHECK(afterIdle.code == 200 && !afterIdle.reused);
+  CHECK(afterIdle.body.endsWith("req=1"));
+  CHECK(count(TelemetryCounter::TlsHandshake) == 5);
+
+  // Past the device's idle budget the socket is not trusted even though the server still holds it.
+  app().transport.keepAliveIdleMs = 300;
+  delay(500);
+  Response pastBudget = get(base + "/ping");
+  CHECK(pastBudget.code == 200 && !pastBudget.reused);
+  CHECK(connOf(pastBudget.body) != connOf(afterIdle.body));
+  Response withinBudget = get(base + "/ping");
+  CHECK(withinBudget.code == 200 && withinBudget.reused);
+  app().transport.keepAliveIdleMs = kKeepAliveIdleMs;
+
+  // Wrong CA: the handshake must fail and no request goes out.
+  closeAllHttpClients();
+  backend.caCert = readFile(argv[3]);
+  Response untrusted = get(base + "/ping");
+  CHECK(!untrusted.opened);
+
+  // No CA configured: setInsecure() path.
+  backend.caCert = "";
+  Response insecure = get(base + "/ping");
+  CHECK(insecure.code == 200 && !insecure.reused);
+  Response insecureAgain = get(base + "/ping");
+  CHECK(insecureAgain.code == 200 && insecureAgain.reused);
+
+  closeAllHttpClients();
+  if (failures) {
+    fprintf(stderr, "test_http_transport: %d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("test_http_transport: ok\n");
+  return 0;
+}
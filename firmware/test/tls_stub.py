@@ -0,0 +1,58 @@
+"""Local HTTPS stub for the HttpTransport host test.
+
+Usage: python3 tls_stub.py CERT KEY [IDLE_SEC]
+Prints the bound port on stdout, then serves until killed. Each response body is
+"conn=<n> req=<k>": n numbers the TLS connections, k the requests seen on that one,
+so the test can tell a reused socket from a fresh handshake.
+  /ping   keep-alive response
+  /close  response with "Connection: close"
+  /drop   keep-alive headers, but the server closes the socket right after
+A socket idle for IDLE_SEC (default 1) is closed, like uvicorn's --timeout-keep-alive.
+"""
+import itertools
+import ssl
+import sys
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+_connections = itertools.count(1)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def setup(self):
+        super().setup()
+        self.conn_id = next(_connections)
+        self.requests = 0
+
+    def log_message(self, *args):
+        pass
+
+    def do_GET(self):
+        self.requests += 1
+        body = f"conn={self.conn_id} req={self.requests}".encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "text/plain")
+        self.send_header("Content-Length", str(len(body)))
+        if self.path == "/close":
+            self.send_header("Connection", "close")
+        self.end_headers()
+        self.wfile.write(body)
+        if self.path in ("/close", "/drop"):
+            self.close_connection = True
+
+
+def main():
+    cert, key = sys.argv[1], sys.argv[2]
+    # StreamRequestHandler applies this to the connection; a read timeout ends the keep-alive loop.
+    Handler.timeout = float(sys.argv[3]) if len(sys.argv) > 3 else 1.0
+    server = ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    context.load_cert_chain(cert, key)
+    server.socket = context.wrap_socket(server.socket, server_side=True)
+    print(server.server_address[1], flush=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
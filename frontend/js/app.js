@@ -27,6 +27,9 @@ const previewPrevBtn = document.getElementById("preview-prev");
 const previewNextBtn = document.getElementById("preview-next");
 const previewPageEl = document.getElementById("preview-page");
 const lastUploadEl = document.getElementById("last-upload");
+const frameMetaEl = document.getElementById("frame-meta");
+const timelineEndEl = document.getElementById("timeline-end");
+const timelineStreamEl = document.getElementById("timeline-stream");
 const refreshBtn = document.getElementById("refresh-btn");
 const deviceCountEl = document.getElementById("device-count");
 const selectedDeviceSubtitle = document.getElementById("selected-device-subtitle");
@@ -39,16 +42,35 @@ const analysisPromptEl = document.getElementById("analysis-prompt");
 const analysisNumCtxEl = document.getElementById("analysis-num-ctx");
 const analysisNumPredictEl = document.getElementById("analysis-num-predict");
 const analysisTimeEl = document.getElementById("analysis-time");
+const telemetryPlaceholderEl = document.getElementById("telemetry-placeholder");
+const telemetryStagesEl = document.getElementById("telemetry-stages");
+const telemetryCountersEl = document.getElementById("telemetry-counters");
+const telemetrySceneEl = document.getElementById("telemetry-scene");
+const telemetryHeapEl = document.getElementById("telemetry-heap");
+const telemetryHeapValueEl = document.getElementById("telemetry-heap-value");
 
 const $ = (id) => document.getElementById(id);
 
 const PREVIEW_PAGE_SIZE = 4;
+const TIMELINE_PAGE_SIZE = 20;
 let currentPreviewUrls = [];
+// url -> frame { url, thumb, medium, ts, analysis, ... }; thumbnails load first, full frames only on demand
+let currentPreviewItems = new Map();
 let currentPreviewPage = 0;
+// Timeline state: frames are paged newest-first from /frames with a keyset cursor
+let timelineFrames = [];
+let timelineCursor = null;
+let timelineEnd = null;
+let timelineStream = "";
+let timelineDeviceId = null;
+let timelineHeadTs = null;
+let timelineRequestSeq = 0;
 let currentMainPreviewUrl = null;
 let currentDeviceId = null;
 let hasInitialSelection = false;
 const deviceCards = new Map();
+// deviceId -> son bilinen tam cihaz satiri; canli olaylar bunun uzerine yamanir
+const deviceState = new Map();
 let listLoadedOnce = false;
 
 if (previewCells.length) {
@@ -73,8 +95,12 @@ if (previewPrevBtn) {
 }
 
 if (previewNextBtn) {
-  previewNextBtn.addEventListener("click", () => {
-    const totalPages = Math.max(1, Math.ceil(currentPreviewUrls.length / PREVIEW_PAGE_SIZE));
+  previewNextBtn.addEventListener("click", async () => {
+    let totalPages = Math.max(1, Math.ceil(currentPreviewUrls.length / PREVIEW_PAGE_SIZE));
+    if (currentPreviewPage >= totalPages - 1 && timelineCursor) {
+      await loadTimeline(currentDeviceId, true);
+      totalPages = Math.max(1, Math.ceil(currentPreviewUrls.length / PREVIEW_PAGE_SIZE));
+    }
     if (currentPreviewPage < totalPages - 1) {
       currentPreviewPage += 1;
       renderPreviewGrid();
@@ -82,6 +108,21 @@ if (previewNextBtn) {
   });
 }
 
+if (timelineEndEl) {
+  timelineEndEl.addEventListener("change", () => {
+    const ms = timelineEndEl.value ? new Date(timelineEndEl.value).getTime() : NaN;
+    timelineEnd = Number.isFinite(ms) ? Math.floor(ms / 1000) : null;
+    if (currentDeviceId) loadTimeline(currentDeviceId);
+  });
+}
+
+if (timelineStreamEl) {
+  timelineStreamEl.addEventListener("change", () => {
+    timelineStream = timelineStreamEl.value;
+    if (currentDeviceId) loadTimeline(currentDeviceId);
+  });
+}
+
 if (refreshBtn) {
   refreshBtn.addEventListener("click", () => {
     refreshDevices();
@@ -174,12 +215,171 @@ function updateAnalysis(meta) {
   analysisTimeEl.title = analysisTime || "";
 }
 
+const TELEMETRY_STAGE_LABELS = {
+  grab: "Frame grab",
+  upConnect: "Upload connect",
+  upSend: "Upload send",
+  upResponse: "Upload response",
+  cfgFetch: "Config fetch",
+  cfgParse: "Config parse",
+  cfgApply: "Config apply",
+  tlsHandshake: "TLS handshake",
+  grabArchive: "Archive grab",
+  trigger: "Trigger -> HTTP 200",
+};
+
+function formatMicros(us) {
+  const num = numberOrNull(us);
+  if (num === null) return "-";
+  if (num >= 1000000) return `${(num / 1000000).toFixed(2)} s`;
+  if (num >= 1000) return `${(num / 1000).toFixed(1)} ms`;
+  return `${num} us`;
+}
+
+function renderTelemetry(data) {
+  if (!telemetryStagesEl || !telemetryPlaceholderEl) return;
+  const samples = Array.isArray(data?.samples) ? data.samples : [];
+  const stages = data?.stages || {};
+  const stageNames = Object.keys(stages);
+  const hasData = samples.length > 0;
+
+  telemetryPlaceholderEl.style.display = hasData ? "none" : "block";
+  telemetryStagesEl.style.display = stageNames.length ? "table" : "none";
+
+  const tbody = telemetryStagesEl.querySelector("tbody");
+  if (tbody) {
+    tbody.innerHTML = "";
+    stageNames.forEach((name) => {
+      const stage = stages[name];
+      const buckets = Array.isArray(stage.buckets) ? stage.buckets : [];
+      const peak = Math.max(1, ...buckets);
+      const row = document.createElement("tr");
+      [TELEMETRY_STAGE_LABELS[name] || name, stage.n, formatMicros(stage.p50Us), formatMicros(stage.p95Us), formatMicros(stage.maxUs)]
+        .forEach((value) => {
+          const cell = document.createElement("td");
+          cell.textContent = value ?? "-";
+          row.appendChild(cell);
+        });
+      const histCell = document.createElement("td");
+      const hist = document.createElement("div");
+      hist.className = "telemetry-hist";
+      buckets.forEach((count, idx) => {
+        const bar = document.createElement("span");
+        bar.style.height = `${Math.round((count / peak) * 100)}%`;
+        bar.title = `< ${formatMicros(idx ? 2 ** idx : 1)}: ${count}`;
+        hist.appendChild(bar);
+      });
+      histCell.appendChild(hist);
+      row.appendChild(histCell);
+      tbody.appendChild(row);
+    });
+  }
+
+  if (telemetryCountersEl) {
+    telemetryCountersEl.innerHTML = "";
+    Object.entries(data?.counters || {}).forEach(([name, value]) => {
+      const item = document.createElement("span");
+      item.textContent = `${name}: `;
+      const code = document.createElement("code");
+      code.textContent = String(value);
+      item.appendChild(code);
+      telemetryCountersEl.appendChild(item);
+    });
+  }
+
+  if (telemetrySceneEl) {
+    const scene = data?.scene;
+    telemetrySceneEl.innerHTML = "";
+    if (scene) {
+      const parts = [`mode: ${scene.mode || "-"}`, `transitions: ${scene.transitions ?? 0}`];
+      Object.entries(scene.ms || {}).forEach(([mode, ms]) => {
+        if (ms) parts.push(`${mode}: ${formatMicros(ms * 1000)}`);
+      });
+      parts.forEach((text) => {
+        const item = document.createElement("span");
+        item.textContent = text;
+        telemetrySceneEl.appendChild(item);
+      });
+    }
+  }
+
+  if (telemetryHeapEl) {
+    const heap = samples.map((s) => numberOrNull(s.heap?.free)).filter((v) => v !== null);
+    if (heap.length) {
+      const lo = Math.min(...heap);
+      const hi = Math.max(...heap);
+      const span = Math.max(1, hi - lo);
+      const step = heap.length > 1 ? 300 / (heap.length - 1) : 0;
+      const points = heap.map((v, i) => `${(i * step).toFixed(1)},${(46 - ((v - lo) / span) * 44).toFixed(1)}`).join(" ");
+      telemetryHeapEl.innerHTML = `<polyline points="${points}"></polyline>`;
+      if (telemetryHeapValueEl) telemetryHeapValueEl.textContent = `${Math.round(heap[heap.length - 1] / 1024)} KB`;
+    } else {
+      telemetryHeapEl.innerHTML = "";
+      if (telemetryHeapValueEl) telemetryHeapValueEl.textContent = "-";
+    }
+  }
+}
+
+async function loadTelemetry(id) {
+  if (!id) {
+    renderTelemetry(null);
+    return;
+  }
+  try {
+    const data = await getJSON(`/admin/api/device/${id}/telemetry`);
+    if (id === currentDeviceId) renderTelemetry(data);
+  } catch (e) {
+    console.error("Telemetry load error", e);
+    renderTelemetry(null);
+  }
+}
+
+function previewVariant(url, variant) {
+  const item = currentPreviewItems.get(url);
+  return (item && item[variant]) || url;
+}
+
+function formatBytes(bytes) {
+  const num = numberOrNull(bytes);
+  if (num === null) return null;
+  if (num >= 1024 * 1024) return `${(num / (1024 * 1024)).toFixed(1)} MB`;
+  if (num >= 1024) return `${Math.round(num / 1024)} KB`;
+  return `${num} B`;
+}
+
+function showFrameMeta(item) {
+  if (frameMetaEl) {
+    const parts = [];
+    if (item) {
+      parts.push(formatDateTime(item.ts) || "-");
+      if (item.framesize) parts.push(item.quality ? `${item.framesize} q${item.quality}` : item.framesize);
+      const size = formatBytes(item.size);
+      if (size) parts.push(size);
+      if (Array.isArray(item.roi)) parts.push(`ROI ${item.roi.join(",")}`);
+      if (item.stream === "archive") parts.push("arsiv");
+      if (item.trigger) parts.push(item.triggerMs != null ? `tetik +${item.triggerMs} ms` : "tetik");
+    }
+    frameMetaEl.textContent = parts.length ? `Kare: ${parts.join(" | ")}` : "";
+  }
+  // Secilen karenin kendi analizi varsa cihazin son analizinin yerine gosterilir
+  if (item && item.analysis && analysisTextEl) {
+    const text = String(item.analysis).trim();
+    analysisTextEl.textContent = text;
+    analysisTextEl.classList.remove("muted");
+    analysisTextEl.title = text;
+    const when = formatDateTime(item.analysisTime) || "-";
+    analysisTimeEl.textContent = when;
+    analysisTimeEl.title = when !== "-" ? when : "";
+  }
+}
+
 function setMainPreview(url, skipHighlight = false) {
   currentMainPreviewUrl = url || null;
+  showFrameMeta(url ? currentPreviewItems.get(url) : null);
   if (!previewMainImg || !previewMainPlaceholder) return;
   if (url) {
-    const bust = url.includes("?") ? "&" : "?";
-    previewMainImg.src = `${url}${bust}v=${Date.now()}`;
+    const src = previewVariant(url, "medium");
+    if (previewMainImg.getAttribute("src") !== src) previewMainImg.src = src;
     previewMainImg.style.display = "block";
     previewMainPlaceholder.style.display = "none";
   } else {
@@ -223,8 +423,9 @@ function renderPreviewGrid() {
     const cell = img.parentElement;
     const url = slice[idx];
     if (url) {
-      const bust = url.includes("?") ? "&" : "?";
-      img.src = `${url}${bust}v=${Date.now()}`;
+      const src = previewVariant(url, "thumb");
+      if (img.getAttribute("src") !== src) img.src = src;
+      img.loading = "lazy";
       img.dataset.url = url;
       img.style.display = "block";
       if (cell) cell.style.display = "block";
@@ -242,7 +443,10 @@ function renderPreviewGrid() {
   previewPlaceholder.textContent = hasImages ? "" : "Hen�z JPEG alinmadi.";
 
   if (previewPrevBtn) previewPrevBtn.disabled = !hasImages || currentPreviewPage === 0;
-  if (previewNextBtn) previewNextBtn.disabled = !hasImages || currentPreviewPage >= Math.max(0, pageCount - 1);
+  if (previewNextBtn) {
+    const atEnd = currentPreviewPage >= Math.max(0, pageCount - 1);
+    previewNextBtn.disabled = !hasImages || (atEnd && !timelineCursor);
+  }
   if (previewPageEl) previewPageEl.textContent = hasImages ? `${currentPreviewPage + 1} / ${pageCount}` : "0 / 0";
 
   if (hasImages) {
@@ -256,18 +460,63 @@ function renderPreviewGrid() {
   highlightThumbnails();
 }
 
+function setTimelineFrames(frames) {
+  timelineFrames = frames;
+  currentPreviewUrls = frames.map((f) => f.url);
+  currentPreviewItems = new Map(frames.map((f) => [f.url, f]));
+}
+
+async function loadTimeline(id, append = false) {
+  if (!id) return;
+  const params = new URLSearchParams({ limit: String(TIMELINE_PAGE_SIZE) });
+  if (timelineEnd) params.set("end", String(timelineEnd));
+  if (timelineStream) params.set("stream", timelineStream);
+  if (append && timelineCursor) params.set("before", timelineCursor);
+  // Yalnizca en son istenen sayfa uygulanir; cihaz degisince eski yanitlar atilir
+  const seq = ++timelineRequestSeq;
+  try {
+    const data = await getJSON(`/admin/api/device/${encodeURIComponent(id)}/frames?${params}`);
+    if (seq !== timelineRequestSeq || id !== currentDeviceId) return;
+    const frames = Array.isArray(data?.frames) ? data.frames : [];
+    setTimelineFrames(append ? timelineFrames.concat(frames) : frames);
+    timelineCursor = data?.next || null;
+    if (!append) currentPreviewPage = 0;
+    renderPreviewGrid();
+  } catch (e) {
+    console.error("Timeline load error", e);
+  }
+}
+
 function updatePreview(meta) {
   if (!previewContainer) return;
-  const urls = Array.isArray(meta?.lastImgUrls) && meta.lastImgUrls.length
-    ? meta.lastImgUrls
-    : (meta && meta.lastImgUrl ? [meta.lastImgUrl] : []);
-
-  currentPreviewUrls = urls;
-  currentPreviewPage = 0;
 
   updateAnalysis(meta);
 
-  renderPreviewGrid();
+  if (!meta) {
+    setTimelineFrames([]);
+    timelineCursor = null;
+    timelineDeviceId = null;
+    timelineHeadTs = null;
+    currentPreviewPage = 0;
+    renderPreviewGrid();
+  } else {
+    const headTs = numberOrNull(meta.lastImgTime);
+    const deviceChanged = timelineDeviceId !== meta.deviceId;
+    // Gecmise bakilirken (end filtresi) yeni kareler gorunumu kaydirmasin
+    if (deviceChanged || (!timelineEnd && headTs !== timelineHeadTs)) {
+      if (deviceChanged) {
+        setTimelineFrames([]);
+        timelineCursor = null;
+        currentPreviewPage = 0;
+        renderPreviewGrid();
+      }
+      timelineDeviceId = meta.deviceId;
+      timelineHeadTs = headTs;
+      loadTimeline(meta.deviceId);
+    } else {
+      setMainPreview(currentMainPreviewUrl, true);
+    }
+  }
 
   if (lastUploadEl) {
     const ts = meta ? numberOrNull(meta.lastImgTime) : null;
@@ -297,6 +546,7 @@ function createDeviceCard(device) {
       <h3 data-field="deviceId"></h3>
       <div class="device-card-badges">
         <span class="chip chip-status" data-field="status"></span>
+        <span class="chip chip-pending" data-field="config" title="Cihaz yeni ayarlari henuz almadi">Config bekliyor</span>
         <span class="ai-chip" data-field="ai"></span>
       </div>
     </div>
@@ -373,6 +623,9 @@ function updateDeviceCard(card, device) {
       refs.ai.title = isOnline ? "A.I. katmani bagli" : "A.I. katmani erisilemiyor";
     }
   }
+  if (refs.config) {
+    const pending = numberOrNull(device.configSeenRev) < numberOrNull(device.configRev);
+    refs.config.classList.toggle("visible", pending);
   }
   if (refs.ip) refs.ip.textContent = `IP: ${device.ip || "-"}`;
   if (refs.rssi) refs.rssi.textContent = `RSSI: ${device.rssi ?? "-"}`;
@@ -401,6 +654,7 @@ function updateDeviceCard(card, device) {
 }
 
 function upsertDeviceCard(device) {
+  deviceState.set(device.deviceId, device);
   let card = deviceCards.get(device.deviceId);
   if (!card) {
     card = createDeviceCard(device);
@@ -430,6 +684,7 @@ function renderDeviceList(items) {
     if (!seen.has(id)) {
       listEl.removeChild(child);
       deviceCards.delete(id);
+      deviceState.delete(id);
     }
   }
 
@@ -451,6 +706,7 @@ async function refreshDevices() {
 
     if (!items.length) {
       deviceCards.clear();
+      deviceState.clear();
       listEl.innerHTML = "<div class=\"empty-state\">Simdilik cihaz yok.</div>";
       hasInitialSelection = false;
       currentDeviceId = null;
@@ -467,6 +723,7 @@ async function refreshDevices() {
       if (current) {
         updatePreview(current);
         updateSelectedSubtitle(current);
+        loadTelemetry(currentDeviceId);
       } else {
         currentDeviceId = null;
         hasInitialSelection = false;
@@ -489,6 +746,85 @@ async function refreshDevices() {
   }
 }
 
+function applyDeviceDelta(delta) {
+  const id = delta?.deviceId;
+  if (!id) return;
+  const existing = deviceState.get(id);
+  if (!existing) {
+    // Yeni kayit olan cihaz: kismi alanlarla kart kurulamaz, listeyi bir kez cek
+    if (listLoadedOnce) refreshDevices();
+    return;
+  }
+  const device = { ...existing, ...delta };
+  upsertDeviceCard(device);
+  if (id === currentDeviceId) {
+    updatePreview(device);
+    updateSelectedSubtitle(device);
+  }
+}
+
+function applyAnalysis(event) {
+  const existing = deviceState.get(event.deviceId);
+  if (!existing) return;
+  const frame = timelineFrames.find((f) => f.id === event.frameId);
+  if (frame && event.deviceId === timelineDeviceId) {
+    frame.analysis = event.analysis;
+    frame.analysisTime = event.analysisTime;
+  }
+  // An older frame finishing late must not replace the device's last analysis.
+  if (event.latest === false) return;
+  applyDeviceDelta({
+    deviceId: event.deviceId,
+    lastAnalysis: event.analysis,
+    lastAnalysisTime: event.analysisTime,
+  });
+}
+
+function connectEvents() {
+  if (!window.EventSource) {
+    refreshDevices();
+    return;
+  }
+  const source = new EventSource("/admin/api/events");
+  let opened = false;
+  const handle = (fn) => (ev) => {
+    try {
+      fn(JSON.parse(ev.data));
+    } catch (e) {
+      console.error("Event handling error", e);
+    }
+  };
+
+  // Tam liste baglanti acildiktan sonra cekilir; aradaki olaylar kacmaz.
+  // Tarayicinin kendi yeniden baglanmalarinda sunucu Last-Event-ID'den devam eder.
+  source.addEventListener("open", () => {
+    if (!opened) {
+      opened = true;
+      refreshDevices();
+    }
+  });
+  source.addEventListener("resync", () => refreshDevices());
+  source.addEventListener("device", handle(applyDeviceDelta));
+  source.addEventListener("analysis", handle(applyAnalysis));
+  source.addEventListener("telemetry", handle((ev) => {
+    if (ev.deviceId === currentDeviceId) loadTelemetry(currentDeviceId);
+  }));
+  source.addEventListener("error", () => {
+    if (source.readyState !== EventSource.CLOSED) return;
+    // Sunucu akisi reddetti (proxy, yeniden baslatma): listeyi bir kez cek, sonra tekrar dene
+    refreshDevices();
+    setTimeout(connectEvents, 10000);
+  });
+}
+
+// Olay gelmeyen cihazlar da zamanla offline'a dussun; yalnizca DOM, ag istegi yok
+setInterval(() => {
+  deviceCards.forEach((card, id) => {
+    const device = deviceState.get(id);
+    if (device) updateDeviceCard(card, device);
+  });
+}, 15000);
+
 
 
 
@@ -542,6 +878,23 @@ async function selectDevice(id) {
     $("dcw").checked = !!d.dcw;
     $("colorbar").checked = !!d.colorbar;
     $("lowLightBoost").checked = !!d.lowLightBoost;
+    $("sceneProfiles").value = JSON.stringify(d.sceneProfiles || [], null, 2);
+    $("schedule").value = JSON.stringify(d.schedule || [], null, 2);
+    $("tz").value = d.tz || "";
+    $("roiX").value = d.roi?.x ?? 0;
+    $("roiY").value = d.roi?.y ?? 0;
+    $("roiW").value = d.roi?.w ?? 1000;
+    $("roiH").value = d.roi?.h ?? 1000;
+    $("roiZoom").checked = !!d.roi?.zoom;
+    $("archiveFramesize").value = d.archiveFramesize || "OFF";
+    $("archiveQuality").value = d.archiveQuality ?? 10;
+    $("archiveIntervalSec").value = d.archiveIntervalSec ?? 300;
+    $("triggerGpio").value = String(d.triggerGpio ?? -1);
+    $("triggerActiveHigh").checked = d.triggerActiveHigh !== false;
+    $("triggerCooldownMs").value = d.triggerCooldownMs ?? 2000;
+    $("triggerLightSleep").checked = !!d.triggerLightSleep;
+    $("fwCurrent").value = d.fwRejected ? `${d.fw || "-"} (geri alindi: ${d.fwRejected})` : d.fw || "-";
+    await loadFirmwareImages(d.fwTarget);
 
     $("aiHost").value = d.aiHost || "";
     $("aiModel").value = d.aiModel || "";
@@ -551,12 +904,58 @@ async function selectDevice(id) {
 
     updatePreview(d);
     updateSelectedSubtitle(d);
+    loadTelemetry(d.deviceId);
     statusEl.textContent = "";
   } catch (e) {
     statusEl.innerHTML = `<span class=\"err\">Secim hatasi: ${e.message}</span>`;
   }
 }
 
+async function loadFirmwareImages(selected) {
+  const select = $("fwTarget");
+  try {
+    const data = await getJSON("/admin/api/firmware");
+    select.innerHTML = "";
+    select.appendChild(new Option("(no update)", ""));
+    for (const img of data.images || []) {
+      // Imzasiz imaj cihaza verilmez; listede gorunur ama secilemez
+      const opt = new Option(`${img.version} (${formatBytes(img.size)})${img.signed ? "" : " - unsigned"}`, img.version);
+      opt.disabled = !img.signed;
+      select.appendChild(opt);
+    }
+  } catch (e) {
+    // Liste gelmezse mevcut secim korunur
+  }
+  select.value = selected || "";
+}
+
+$("fwUploadBtn").addEventListener("click", async () => {
+  const version = $("fwUploadVersion").value.trim();
+  const file = $("fwUploadFile").files[0];
+  const sigFile = $("fwUploadSig").files[0];
+  if (!version || !file || !sigFile) {
+    statusEl.innerHTML = "<span class=\"err\">Surum, .bin ve .sig dosyasi gerekli.</span>";
+    return;
+  }
+  try {
+    const sig = new Uint8Array(await sigFile.arrayBuffer());
+    const res = await fetch(`/admin/api/firmware/${encodeURIComponent(version)}`, {
+      method: "PUT",
+      headers: {
+        "Content-Type": "application/octet-stream",
+        "Authorization": `Bearer ${$("fwAdminToken").value.trim()}`,
+        "X-Fw-Signature": btoa(String.fromCharCode(...sig)),
+      },
+      body: file,
+    });
+    if (!res.ok) throw new Error(`HTTP ${res.status}`);
+    statusEl.innerHTML = `<span class=\"ok\">Imaj yuklendi: ${version}</span>`;
+    await loadFirmwareImages($("fwTarget").value);
+  } catch (e) {
+    statusEl.innerHTML = `<span class=\"err\">Imaj yukleme hatasi: ${e.message}</span>`;
+  }
+});
+
 function parseIntSafe(value) {
   const v = Number.parseInt(String(value), 10);
   return Number.isNaN(v) ? null : v;
@@ -577,6 +976,24 @@ form.addEventListener("submit", async (ev) => {
     return parsed;
   };
 
+  let sceneProfiles;
+  try {
+    sceneProfiles = JSON.parse($("sceneProfiles").value || "[]");
+    if (!Array.isArray(sceneProfiles)) throw new Error("liste bekleniyor");
+  } catch (e) {
+    statusEl.innerHTML = `<span class=\"err\">Scene profilleri gecersiz: ${e.message}</span>`;
+    return;
+  }
+
+  let schedule;
+  try {
+    schedule = JSON.parse($("schedule").value || "[]");
+    if (!Array.isArray(schedule)) throw new Error("liste bekleniyor");
+  } catch (e) {
+    statusEl.innerHTML = `<span class=\"err\">Cekim takvimi gecersiz: ${e.message}</span>`;
+    return;
+  }
+
   const body = {
     framesize: $("framesize").value,
     jpegQuality: parseIntSafe($("jpegQuality").value),
@@ -604,6 +1021,24 @@ form.addEventListener("submit", async (ev) => {
     colorbar: $("colorbar").checked,
     specialEffect: parseIntSafe($("specialEffect").value),
     lowLightBoost: $("lowLightBoost").checked,
+    sceneProfiles,
+    schedule,
+    tz: $("tz").value.trim(),
+    roi: {
+      x: parseIntSafe($("roiX").value) ?? 0,
+      y: parseIntSafe($("roiY").value) ?? 0,
+      w: parseIntSafe($("roiW").value) ?? 1000,
+      h: parseIntSafe($("roiH").value) ?? 1000,
+      zoom: $("roiZoom").checked,
+    },
+    archiveFramesize: $("archiveFramesize").value,
+    archiveQuality: parseIntSafe($("archiveQuality").value),
+    archiveIntervalSec: parseIntSafe($("archiveIntervalSec").value),
+    triggerGpio: parseIntSafe($("triggerGpio").value) ?? -1,
+    triggerActiveHigh: $("triggerActiveHigh").checked,
+    triggerCooldownMs: parseIntSafe($("triggerCooldownMs").value),
+    triggerLightSleep: $("triggerLightSleep").checked,
+    fwTarget: $("fwTarget").value,
     aiHost: $("aiHost").value.trim(),
     aiModel: $("aiModel").value.trim(),
     aiPrompt: $("aiPrompt").value,
@@ -627,13 +1062,13 @@ form.addEventListener("submit", async (ev) => {
   try {
     const resp = await postJSON(`/admin/api/device/${id}/config`, body);
     statusEl.innerHTML = `<span class=\"ok\">Kaydedildi.</span>`;
-    await refreshDevices();
+    applyDeviceDelta(await getJSON(`/admin/api/device/${id}`));
   } catch (e) {
     statusEl.innerHTML = `<span class=\"err\">Kaydetme hatasi: ${e.message}</span>`;
   }
 });
 
-refreshDevices();
+connectEvents();
 
 
 
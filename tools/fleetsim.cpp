@@ -0,0 +1,877 @@
+// tools/fleetsim.cpp
+// Fleet simulator: thousands of virtual ESP32-CAMs in one process. Each speaks the same
+// register / config / upload protocol as the firmware's BackendClient, and the tool reports
+// throughput and latency percentiles per endpoint. Single thread, epoll, one keep-alive
+// connection per device (like the firmware's HTTP slot). Plain HTTP only; no TLS.
+//
+// Build (Linux):
+//   g++ -O2 -std=c++17 -o fleetsim tools/fleetsim.cpp
+// Example:
+//   ./fleetsim --url http://127.0.0.1:8000 --devices 500 --jpeg-dir uploads/samples --duration 120
+//
+// Frames are replayed in order from the .jpg files under --jpeg-dir, each device starting at a
+// different file. The backend counts a frame repeated back to back as a "duplicate", so give it
+// several distinct captures for a realistic load. Interval, phase and jitter come from the
+// backend's config response by default (the same grid as the firmware's nextAlignedMillis);
+// --interval-sec, --jitter-ms and --no-phase override them.
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kRequestTimeoutUs = 15000000;  // firmware: http->setTimeout(15000)
+constexpr size_t kMaxEvents = 1024;
+
+uint64_t nowUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+uint64_t epochMs() {
+  timeval tv;
+  gettimeofday(&tv, nullptr);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000ULL + tv.tv_usec / 1000;
+}
+
+// --- Equivalent of the hand-rolled JSON readers in BackendClient.cpp ---
+
+std::string jsonGetString(const std::string& body, const char* key) {
+  std::string needle = std::string("\"") + key + "\"";
+  size_t i = body.find(needle);
+  if (i == std::string::npos) return "";
+  i = body.find(':', i + needle.size());
+  if (i == std::string::npos) return "";
+  size_t q1 = body.find('"', i + 1);
+  if (q1 == std::string::npos) return "";
+  size_t q2 = body.find('"', q1 + 1);
+  if (q2 == std::string::npos) return "";
+  return body.substr(q1 + 1, q2 - q1 - 1);
+}
+
+long long jsonGetInt(const std::string& body, const char* key, long long defv) {
+  std::string needle = std::string("\"") + key + "\"";
+  size_t i = body.find(needle);
+  if (i == std::string::npos) return defv;
+  i = body.find(':', i + needle.size());
+  if (i == std::string::npos) return defv;
+  size_t j = i + 1;
+  while (j < body.size() && (body[j] == ' ' || body[j] == '\t')) j++;
+  size_t s = j;
+  if (j < body.size() && body[j] == '-') j++;
+  while (j < body.size() && body[j] >= '0' && body[j] <= '9') j++;
+  if (j == s || (j == s + 1 && body[s] == '-')) return defv;
+  return std::strtoll(body.c_str() + s, nullptr, 10);
+}
+
+bool jsonGetBool(const std::string& body, const char* key, bool defv) {
+  std::string needle = std::string("\"") + key + "\"";
+  size_t i = body.find(needle);
+  if (i == std::string::npos) return defv;
+  i = body.find(':', i + needle.size());
+  if (i == std::string::npos) return defv;
+  size_t j = i + 1;
+  while (j < body.size() && (body[j] == ' ' || body[j] == '\t')) j++;
+  if (body.compare(j, 4, "true") == 0) return true;
+  if (body.compare(j, 5, "false") == 0) return false;
+  return defv;
+}
+
+// --- Options ---
+
+struct Options {
+  std::string host = "127.0.0.1";
+  std::string port = "8000";
+  std::string hostHeader = "127.0.0.1:8000";
+  int devices = 100;
+  std::string jpegDir;
+  double durationSec = 60;
+  double rampSec = 10;
+  double reportSec = 5;
+  std::string backendToken = "1234567890";  // config.py BACKEND_TOKEN default
+  std::string uploadToken;                  // empty: uploadToken from the config response
+  std::string idPrefix = "SIM";
+  std::string framesize = "VGA";
+  int jpegQuality = 12;
+  int intervalSec = 0;   // 0: from config
+  int pollSec = 0;       // 0: from config
+  int jitterMs = -1;     // <0: from config (scheduleJitterMs)
+  bool usePhase = true;  // false: whole fleet on the same grid instant (boot storm)
+  unsigned seed = 1;
+};
+
+void usage(const char* argv0) {
+  std::fprintf(stderr,
+               "usage: %s --url http://HOST:PORT --jpeg-dir DIR [options]\n"
+               "  --devices N          virtual devices (default 100)\n"
+               "  --duration SEC       run time after the ramp starts (default 60)\n"
+               "  --ramp-sec SEC       spread registrations over SEC (default 10)\n"
+               "  --report-sec SEC     progress report period, 0 = off (default 5)\n"
+               "  --backend-token TOK  Bearer for /api/register and /api/config\n"
+               "  --upload-token TOK   Bearer for /upload (default: uploadToken from config)\n"
+               "  --id-prefix P        device ids are P0000, P0001, ... (default SIM)\n"
+               "  --framesize KEY      X-Frame-Size header (default VGA)\n"
+               "  --quality Q          X-JPEG-Quality header (default 12)\n"
+               "  --interval-sec N     upload interval instead of uploadIntervalSec\n"
+               "  --poll-sec N         config poll interval instead of pollIntervalSec\n"
+               "  --jitter-ms N        slot jitter instead of scheduleJitterMs\n"
+               "  --no-phase           ignore uploadPhaseMs/pollPhaseMs (whole fleet in step)\n"
+               "  --seed N             RNG seed (default 1)\n",
+               argv0);
+}
+
+bool parseUrl(const std::string& url, Options& opt) {
+  const std::string scheme = "http://";
+  if (url.compare(0, scheme.size(), scheme) != 0) return false;
+  std::string rest = url.substr(scheme.size());
+  size_t slash = rest.find('/');
+  if (slash != std::string::npos) rest = rest.substr(0, slash);
+  if (rest.empty()) return false;
+  opt.hostHeader = rest;
+  size_t colon = rest.rfind(':');
+  if (colon != std::string::npos && rest.find(']') == std::string::npos) {
+    opt.host = rest.substr(0, colon);
+    opt.port = rest.substr(colon + 1);
+  } else {
+    opt.host = rest;
+    opt.port = "80";
+  }
+  return true;
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+  bool haveUrl = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto value = [&](std::string& out) {
+      if (i + 1 >= argc) return false;
+      out = argv[++i];
+      return true;
+    };
+    std::string v;
+    if (arg == "--no-phase") {
+      opt.usePhase = false;
+      continue;
+    }
+    if (!value(v)) return false;
+    if (arg == "--url") {
+      if (!parseUrl(v, opt)) return false;
+      haveUrl = true;
+    } else if (arg == "--devices") opt.devices = std::max(1, std::atoi(v.c_str()));
+    else if (arg == "--jpeg-dir") opt.jpegDir = v;
+    else if (arg == "--duration") opt.durationSec = std::atof(v.c_str());
+    else if (arg == "--ramp-sec") opt.rampSec = std::max(0.0, std::atof(v.c_str()));
+    else if (arg == "--report-sec") opt.reportSec = std::max(0.0, std::atof(v.c_str()));
+    else if (arg == "--backend-token") opt.backendToken = v;
+    else if (arg == "--upload-token") opt.uploadToken = v;
+    else if (arg == "--id-prefix") opt.idPrefix = v;
+    else if (arg == "--framesize") opt.framesize = v;
+    else if (arg == "--quality") opt.jpegQuality = std::atoi(v.c_str());
+    else if (arg == "--interval-sec") opt.intervalSec = std::max(0, std::atoi(v.c_str()));
+    else if (arg == "--poll-sec") opt.pollSec = std::max(0, std::atoi(v.c_str()));
+    else if (arg == "--jitter-ms") opt.jitterMs = std::atoi(v.c_str());
+    else if (arg == "--seed") opt.seed = static_cast<unsigned>(std::strtoul(v.c_str(), nullptr, 10));
+    else return false;
+  }
+  return haveUrl && !opt.jpegDir.empty();
+}
+
+std::vector<std::string> loadFrames(const std::string& dir) {
+  std::vector<std::string> names;
+  if (DIR* d = opendir(dir.c_str())) {
+    while (dirent* e = readdir(d)) {
+      std::string name = e->d_name;
+      if (name.size() > 4) {
+        std::string ext = name.substr(name.size() - 4);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == ".jpg") names.push_back(name);
+      }
+    }
+    closedir(d);
+  }
+  std::sort(names.begin(), names.end());
+  std::vector<std::string> frames;
+  for (const auto& name : names) {
+    std::ifstream in(dir + "/" + name, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string data = ss.str();
+    // JPEG SOI; broken files would measure the simulator, not the backend
+    if (data.size() > 2 && static_cast<uint8_t>(data[0]) == 0xFF && static_cast<uint8_t>(data[1]) == 0xD8) {
+      frames.push_back(std::move(data));
+    }
+  }
+  return frames;
+}
+
+// --- Statistics ---
+
+enum Endpoint : uint8_t { kRegister, kConfig, kUpload, kEndpointCount };
+const char* const kEndpointNames[kEndpointCount] = {"register", "config", "upload"};
+
+struct Window {
+  uint64_t count = 0;
+  uint64_t ok = 0;
+  uint64_t busy = 0;   // 429 / 503 (admission control)
+  uint64_t http4xx = 0;
+  uint64_t http5xx = 0;
+  uint64_t errors = 0;  // connect, timeout, malformed response
+  uint64_t bytesOut = 0;
+  std::vector<uint32_t> latencyUs;
+
+  void add(const Window& o) {
+    count += o.count;
+    ok += o.ok;
+    busy += o.busy;
+    http4xx += o.http4xx;
+    http5xx += o.http5xx;
+    errors += o.errors;
+    bytesOut += o.bytesOut;
+    latencyUs.insert(latencyUs.end(), o.latencyUs.begin(), o.latencyUs.end());
+  }
+};
+
+struct Stats {
+  Window window[kEndpointCount];
+  Window total[kEndpointCount];
+  uint64_t uploadOk = 0;
+  uint64_t uploadDuplicate = 0;
+  uint64_t connects = 0;
+  uint64_t reused = 0;
+};
+
+double percentileMs(std::vector<uint32_t>& v, double q) {
+  if (v.empty()) return 0;
+  size_t k = std::min(v.size() - 1, static_cast<size_t>(q * v.size()));
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k] / 1000.0;
+}
+
+void printWindow(const char* name, Window& w, double seconds) {
+  if (!w.count) return;
+  double p50 = percentileMs(w.latencyUs, 0.50);
+  double p90 = percentileMs(w.latencyUs, 0.90);
+  double p99 = percentileMs(w.latencyUs, 0.99);
+  double max = w.latencyUs.empty() ? 0 : *std::max_element(w.latencyUs.begin(), w.latencyUs.end()) / 1000.0;
+  std::printf("  %-8s n=%-7" PRIu64 " %7.1f req/s %7.2f MB/s  ok=%" PRIu64 " busy=%" PRIu64 " 4xx=%" PRIu64
+              " 5xx=%" PRIu64 " err=%" PRIu64 "  p50=%.1f p90=%.1f p99=%.1f max=%.1f ms\n",
+              name, w.count, w.count / seconds, w.bytesOut / seconds / 1e6, w.ok, w.busy, w.http4xx, w.http5xx,
+              w.errors, p50, p90, p99, max);
+}
+
+// --- Virtual device ---
+
+enum class Phase : uint8_t { Idle, Connecting, Sending, Receiving };
+
+struct Device {
+  std::string id;
+  int fd = -1;
+  Phase phase = Phase::Idle;
+  bool registered = false;
+  bool reusedConn = false;
+  bool retried = false;
+
+  // From the backend's config response (same fields as the firmware)
+  uint32_t intervalMs = 10000;
+  uint32_t pollMs = 5000;
+  uint32_t uploadPhaseMs = 0;
+  uint32_t pollPhaseMs = 0;
+  uint32_t jitterMs = 0;
+  uint32_t revision = 0;
+  bool autoUpload = true;
+  std::string uploadPath = "/upload";
+  std::string uploadToken;
+
+  uint64_t registerAtUs = 0;
+  uint64_t nextPollUs = 0;
+  uint64_t nextUploadUs = 0;
+  uint64_t wakeUs = 0;
+
+  Endpoint current = kRegister;
+  uint64_t startUs = 0;
+  std::string head;
+  const std::string* body = nullptr;
+  size_t sent = 0;
+  std::string in;
+  size_t frameIndex = 0;
+};
+
+class Simulator {
+ public:
+  Simulator(Options opt, std::vector<std::string> frames)
+      : opt_(std::move(opt)), frames_(std::move(frames)), rng_(opt_.seed) {}
+
+  bool run();
+
+ private:
+  Options opt_;
+  std::vector<std::string> frames_;
+  std::mt19937 rng_;
+  std::vector<Device> devices_;
+  Stats stats_;
+  int epfd_ = -1;
+  sockaddr_storage addr_{};
+  socklen_t addrLen_ = 0;
+  int64_t serverOffsetMs_ = 0;  // server epoch - local epoch
+  bool serverOffsetKnown_ = false;
+  bool stopping_ = false;
+  using Timer = std::pair<uint64_t, uint32_t>;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+
+  bool resolve();
+  void wakeAt(uint32_t idx, uint64_t due);
+  void service(uint32_t idx, uint64_t now);
+  void startRequest(uint32_t idx, Endpoint ep, uint64_t now);
+  bool openConnection(uint32_t idx);
+  void closeConnection(Device& d);
+  void watch(Device& d, uint32_t events, uint32_t idx);
+  void onWritable(uint32_t idx);
+  void onReadable(uint32_t idx);
+  void flush(uint32_t idx);
+  void finish(uint32_t idx, int status, const std::string& headers, const std::string& body);
+  void fail(uint32_t idx, bool retryable);
+  uint64_t nextAligned(uint64_t now, uint32_t periodMs, uint32_t phaseMs, uint32_t jitterMs);
+  void report(double seconds, bool final);
+};
+
+bool Simulator::resolve() {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res = nullptr;
+  int rc = getaddrinfo(opt_.host.c_str(), opt_.port.c_str(), &hints, &res);
+  if (rc != 0 || !res) {
+    std::fprintf(stderr, "resolve %s:%s: %s\n", opt_.host.c_str(), opt_.port.c_str(), gai_strerror(rc));
+    return false;
+  }
+  std::memcpy(&addr_, res->ai_addr, res->ai_addrlen);
+  addrLen_ = res->ai_addrlen;
+  freeaddrinfo(res);
+  return true;
+}
+
+// Firmware nextAlignedMillis: the next slot on the k * period + phase grid of the server clock.
+uint64_t Simulator::nextAligned(uint64_t now, uint32_t periodMs, uint32_t phaseMs, uint32_t jitterMs) {
+  uint64_t jitter = jitterMs ? std::uniform_int_distribution<uint32_t>(0, jitterMs)(rng_) : 0;
+  if (!periodMs) return now;
+  int64_t serverNowMs = static_cast<int64_t>(epochMs()) + serverOffsetMs_;
+  uint64_t phase = opt_.usePhase ? phaseMs % periodMs : 0;
+  uint64_t base = static_cast<uint64_t>(serverNowMs) >= phase ? serverNowMs - phase : 0;
+  uint64_t slot = (base / periodMs + 1) * periodMs + phase;
+  return now + (slot - serverNowMs) * 1000ULL + jitter * 1000ULL;
+}
+
+void Simulator::wakeAt(uint32_t idx, uint64_t due) {
+  Device& d = devices_[idx];
+  uint64_t now = nowUs();
+  if (d.wakeUs > now && d.wakeUs <= due) return;
+  d.wakeUs = due;
+  timers_.push({due, idx});
+}
+
+void Simulator::service(uint32_t idx, uint64_t now) {
+  Device& d = devices_[idx];
+  if (d.phase != Phase::Idle) {
+    if (now - d.startUs >= kRequestTimeoutUs) {
+      fail(idx, false);
+    } else {
+      wakeAt(idx, d.startUs + kRequestTimeoutUs);
+    }
+    return;
+  }
+  if (stopping_) return;
+
+  // Firmware order: register, then config poll, then upload; one request at a time.
+  if (!d.registered) {
+    if (now >= d.registerAtUs) {
+      startRequest(idx, kRegister, now);
+    } else {
+      wakeAt(idx, d.registerAtUs);
+    }
+    return;
+  }
+  if (now >= d.nextPollUs) {
+    startRequest(idx, kConfig, now);
+    return;
+  }
+  if (d.autoUpload && now >= d.nextUploadUs) {
+    startRequest(idx, kUpload, now);
+    return;
+  }
+  uint64_t next = d.nextPollUs;
+  if (d.autoUpload) next = std::min(next, d.nextUploadUs);
+  wakeAt(idx, next);
+}
+
+void Simulator::startRequest(uint32_t idx, Endpoint ep, uint64_t now) {
+  Device& d = devices_[idx];
+  d.current = ep;
+  d.startUs = now;
+  d.retried = false;
+  d.body = nullptr;
+  d.in.clear();
+
+  std::string& h = d.head;
+  static std::string registerBody;
+  if (ep == kRegister) {
+    registerBody = std::string("{") +
+                   "\"deviceId\":\"" + d.id + "\"," +
+                   "\"uniqueId\":\"" + d.id + "\"," +
+                   "\"fw\":\"sim\"," +
+                   "\"ip\":\"127.0.0.1\"," +
+                   "\"rssi\":-60," +
+                   "\"model\":\"ESP32-CAM-OV2640\"," +
+                   "\"chipModel\":\"fleetsim\"," +
+                   "\"chipRev\":0," +
+                   "\"cores\":2," +
+                   "\"psram\":true," +
+                   "\"flashSize\":4194304," +
+                   "\"sdk\":\"sim\"" +
+                   "}";
+    h = "POST /api/register HTTP/1.1\r\nHost: " + opt_.hostHeader +
+        "\r\nContent-Type: application/json\r\nAuthorization: Bearer " + opt_.backendToken +
+        "\r\nContent-Length: " + std::to_string(registerBody.size()) + "\r\n\r\n" + registerBody;
+  } else if (ep == kConfig) {
+    h = "GET /api/config?deviceId=" + d.id + "&rev=" + std::to_string(d.revision) + "&fw=sim HTTP/1.1\r\nHost: " + opt_.hostHeader +
+        "\r\nAuthorization: Bearer " + opt_.backendToken + "\r\n\r\n";
+  } else {
+    const std::string& frame = frames_[d.frameIndex++ % frames_.size()];
+    const std::string& token = opt_.uploadToken.empty() ? d.uploadToken : opt_.uploadToken;
+    char fname[96];
+    std::snprintf(fname, sizeof(fname), "%s_%" PRIu64 ".jpg", d.id.c_str(), now / 1000);
+    h = "POST " + d.uploadPath + " HTTP/1.1\r\nHost: " + opt_.hostHeader +
+        "\r\nContent-Type: image/jpeg\r\nX-Device-ID: " + d.id +
+        "\r\nX-Frame-Size: " + opt_.framesize +
+        "\r\nX-JPEG-Quality: " + std::to_string(opt_.jpegQuality) +
+        "\r\nX-Stream: analysis\r\nX-File-Name: " + fname +
+        "\r\nX-Device-Time: " + std::to_string(epochMs() / 1000) +
+        (token.empty() ? std::string() : "\r\nAuthorization: Bearer " + token) +
+        "\r\nContent-Length: " + std::to_string(frame.size()) + "\r\n\r\n";
+    d.body = &frame;
+  }
+  d.sent = 0;
+  stats_.window[ep].bytesOut += h.size() + (d.body ? d.body->size() : 0);
+
+  if (d.fd >= 0) {
+    d.reusedConn = true;
+    stats_.reused++;
+    d.phase = Phase::Sending;
+    flush(idx);
+  } else if (!openConnection(idx)) {
+    fail(idx, false);
+    return;
+  }
+  wakeAt(idx, now + kRequestTimeoutUs);
+}
+
+bool Simulator::openConnection(uint32_t idx) {
+  Device& d = devices_[idx];
+  int fd = socket(addr_.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) return false;
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  int rc = connect(fd, reinterpret_cast<sockaddr*>(&addr_), addrLen_);
+  if (rc < 0 && errno != EINPROGRESS) {
+    close(fd);
+    return false;
+  }
+  d.fd = fd;
+  d.reusedConn = false;
+  d.phase = Phase::Connecting;
+  stats_.connects++;
+  epoll_event ev{};
+  ev.events = EPOLLOUT;
+  ev.data.u32 = idx;
+  epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+  return true;
+}
+
+void Simulator::closeConnection(Device& d) {
+  if (d.fd < 0) return;
+  epoll_ctl(epfd_, EPOLL_CTL_DEL, d.fd, nullptr);
+  close(d.fd);
+  d.fd = -1;
+}
+
+void Simulator::watch(Device& d, uint32_t events, uint32_t idx) {
+  epoll_event ev{};
+  ev.events = events;
+  ev.data.u32 = idx;
+  epoll_ctl(epfd_, EPOLL_CTL_MOD, d.fd, &ev);
+}
+
+void Simulator::onWritable(uint32_t idx) {
+  Device& d = devices_[idx];
+  if (d.phase == Phase::Connecting) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(d.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err) {
+      fail(idx, false);
+      return;
+    }
+    d.phase = Phase::Sending;
+  }
+  if (d.phase == Phase::Sending) flush(idx);
+}
+
+void Simulator::flush(uint32_t idx) {
+  Device& d = devices_[idx];
+  size_t headLen = d.head.size();
+  size_t total = headLen + (d.body ? d.body->size() : 0);
+  while (d.sent < total) {
+    iovec iov[2];
+    int n = 0;
+    if (d.sent < headLen) {
+      iov[n++] = {const_cast<char*>(d.head.data()) + d.sent, headLen - d.sent};
+      if (d.body) iov[n++] = {const_cast<char*>(d.body->data()), d.body->size()};
+    } else {
+      size_t off = d.sent - headLen;
+      iov[n++] = {const_cast<char*>(d.body->data()) + off, d.body->size() - off};
+    }
+    ssize_t w = writev(d.fd, iov, n);
+    if (w < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        watch(d, EPOLLOUT, idx);
+        return;
+      }
+      fail(idx, true);
+      return;
+    }
+    d.sent += static_cast<size_t>(w);
+  }
+  d.phase = Phase::Receiving;
+  watch(d, EPOLLIN | EPOLLRDHUP, idx);
+}
+
+void Simulator::onReadable(uint32_t idx) {
+  Device& d = devices_[idx];
+  char buf[16384];
+  bool eof = false;
+  for (;;) {
+    ssize_t r = read(d.fd, buf, sizeof(buf));
+    if (r > 0) {
+      if (d.phase == Phase::Receiving) d.in.append(buf, static_cast<size_t>(r));
+      continue;
+    }
+    if (r == 0) eof = true;
+    else if (errno != EAGAIN && errno != EWOULDBLOCK) eof = true;
+    break;
+  }
+
+  if (d.phase != Phase::Receiving) {
+    // The server closed the idle keep-alive connection; the next request opens a new one
+    if (eof) closeConnection(d);
+    return;
+  }
+
+  size_t headerEnd = d.in.find("\r\n\r\n");
+  if (headerEnd == std::string::npos) {
+    if (eof) fail(idx, d.in.empty());
+    return;
+  }
+  std::string headers = d.in.substr(0, headerEnd + 2);
+  std::string lower = headers;
+  std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+  int status = 0;
+  if (std::sscanf(headers.c_str(), "HTTP/1.%*d %d", &status) != 1) {
+    fail(idx, false);
+    return;
+  }
+  size_t bodyStart = headerEnd + 4;
+  bool keepAlive = lower.find("connection: close") == std::string::npos;
+  size_t cl = lower.find("content-length:");
+  std::string body;
+  if (cl != std::string::npos) {
+    size_t length = std::strtoull(lower.c_str() + cl + 15, nullptr, 10);
+    if (d.in.size() - bodyStart < length) {
+      if (eof) fail(idx, false);
+      return;
+    }
+    body = d.in.substr(bodyStart, length);
+  } else if (lower.find("transfer-encoding: chunked") != std::string::npos) {
+    // Small JSON responses: wait for the last chunk, then join the body from the pieces
+    size_t end = d.in.find("\r\n0\r\n\r\n", bodyStart > 2 ? bodyStart - 2 : 0);
+    if (end == std::string::npos) {
+      if (eof) fail(idx, false);
+      return;
+    }
+    size_t pos = bodyStart;
+    while (pos < d.in.size()) {
+      size_t len = std::strtoul(d.in.c_str() + pos, nullptr, 16);
+      size_t data = d.in.find("\r\n", pos);
+      if (!len || data == std::string::npos) break;
+      body.append(d.in, data + 2, len);
+      pos = data + 2 + len + 2;
+    }
+  } else {
+    if (!eof) return;
+    body = d.in.substr(bodyStart);
+    keepAlive = false;
+  }
+  if (!keepAlive || eof) closeConnection(d);
+  finish(idx, status, lower, body);
+}
+
+void Simulator::finish(uint32_t idx, int status, const std::string& headers, const std::string& body) {
+  Device& d = devices_[idx];
+  uint64_t now = nowUs();
+  Window& w = stats_.window[d.current];
+  w.count++;
+  w.latencyUs.push_back(static_cast<uint32_t>(std::min<uint64_t>(now - d.startUs, UINT32_MAX)));
+  d.phase = Phase::Idle;
+  if (d.fd >= 0) watch(d, EPOLLIN | EPOLLRDHUP, idx);
+
+  bool ok = status >= 200 && status < 300;
+  if (ok) w.ok++;
+  else if (status == 429 || status == 503) w.busy++;
+  else if (status >= 500) w.http5xx++;
+  else w.http4xx++;
+
+  if (d.current == kRegister) {
+    // The firmware ignores the register result; on failure the device still retries after a while
+    d.registered = ok;
+    if (ok) {
+      d.nextPollUs = now;
+    } else {
+      d.registerAtUs = now + 5000000;
+    }
+  } else if (d.current == kConfig) {
+    if (ok) {
+      int64_t serverTimeMs = jsonGetInt(body, "serverTimeMs", 0);
+      if (serverTimeMs > 0 && !serverOffsetKnown_) {
+        serverOffsetMs_ = serverTimeMs - static_cast<int64_t>(epochMs());
+        serverOffsetKnown_ = true;
+      }
+      d.revision = static_cast<uint32_t>(std::max(0LL, jsonGetInt(body, "rev", d.revision)));
+      uint32_t oldInterval = d.intervalMs;
+      uint32_t oldPhase = d.uploadPhaseMs;
+      long long interval = opt_.intervalSec ? opt_.intervalSec : jsonGetInt(body, "uploadIntervalSec", d.intervalMs / 1000);
+      long long poll = opt_.pollSec ? opt_.pollSec : jsonGetInt(body, "pollIntervalSec", d.pollMs / 1000);
+      d.intervalMs = static_cast<uint32_t>(std::max(1LL, std::min(3600LL, interval)) * 1000);
+      d.pollMs = static_cast<uint32_t>(std::max(1LL, std::min(3600LL, poll)) * 1000);
+      d.uploadPhaseMs = static_cast<uint32_t>(std::max(0LL, jsonGetInt(body, "uploadPhaseMs", d.uploadPhaseMs)));
+      d.pollPhaseMs = static_cast<uint32_t>(std::max(0LL, jsonGetInt(body, "pollPhaseMs", d.pollPhaseMs)));
+      d.jitterMs = static_cast<uint32_t>(opt_.jitterMs >= 0 ? opt_.jitterMs
+                                                             : std::max(0LL, jsonGetInt(body, "scheduleJitterMs", 0)));
+      bool wasAuto = d.autoUpload;
+      d.autoUpload = jsonGetBool(body, "autoUpload", d.autoUpload);
+      std::string token = jsonGetString(body, "uploadToken");
+      if (!token.empty()) d.uploadToken = token;
+      std::string url = jsonGetString(body, "uploadUrl");
+      // Only the path is used; the connection always goes to the --url host
+      size_t scheme = url.find("://");
+      size_t path = url.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+      if (path != std::string::npos) d.uploadPath = url.substr(path);
+      if (d.nextUploadUs == 0 || oldInterval != d.intervalMs || oldPhase != d.uploadPhaseMs || (d.autoUpload && !wasAuto)) {
+        d.nextUploadUs = nextAligned(now, d.intervalMs, d.uploadPhaseMs, d.jitterMs);
+      }
+    }
+    d.nextPollUs = nextAligned(now, d.pollMs, d.pollPhaseMs, d.jitterMs);
+  } else {
+    if (ok) {
+      std::string result = jsonGetString(body, "status");
+      if (result == "duplicate") stats_.uploadDuplicate++;
+      else stats_.uploadOk++;
+    }
+    uint64_t next = nextAligned(now, d.intervalMs, d.uploadPhaseMs, d.jitterMs);
+    if (status == 429 || status == 503) {
+      // As in the firmware: Retry-After is a lower bound
+      size_t ra = headers.find("retry-after:");
+      uint64_t retryUs = ra == std::string::npos ? 0 : std::strtoull(headers.c_str() + ra + 12, nullptr, 10) * 1000000ULL;
+      next = std::max(next, now + retryUs);
+    }
+    d.nextUploadUs = next;
+  }
+  service(idx, now);
+}
+
+void Simulator::fail(uint32_t idx, bool retryable) {
+  Device& d = devices_[idx];
+  bool wasReused = d.reusedConn;
+  closeConnection(d);
+  uint64_t now = nowUs();
+  // Firmware: if the server closed the keep-alive socket while idle, retry once on a new connection
+  if (retryable && wasReused && !d.retried && d.in.empty()) {
+    d.retried = true;
+    d.sent = 0;
+    if (openConnection(idx)) return;
+  }
+  Window& w = stats_.window[d.current];
+  w.count++;
+  w.errors++;
+  d.phase = Phase::Idle;
+  if (d.current == kRegister) {
+    d.registerAtUs = now + 5000000;
+  } else if (d.current == kConfig) {
+    d.nextPollUs = nextAligned(now, d.pollMs, d.pollPhaseMs, d.jitterMs);
+  } else {
+    d.nextUploadUs = nextAligned(now, d.intervalMs, d.uploadPhaseMs, d.jitterMs);
+  }
+  service(idx, now);
+}
+
+void Simulator::report(double seconds, bool final) {
+  if (final) {
+    std::printf("== total %.1fs, %zu devices, %" PRIu64 " connects, %" PRIu64 " reused, uploads ok=%" PRIu64
+                " duplicate=%" PRIu64 "\n",
+                seconds, devices_.size(), stats_.connects, stats_.reused, stats_.uploadOk, stats_.uploadDuplicate);
+    for (int e = 0; e < kEndpointCount; ++e) {
+      stats_.total[e].add(stats_.window[e]);
+      stats_.window[e] = Window{};
+      printWindow(kEndpointNames[e], stats_.total[e], seconds);
+    }
+  } else {
+    size_t busy = 0;
+    for (const auto& d : devices_) busy += d.phase != Phase::Idle;
+    std::printf("-- last %.1fs, %zu requests in flight\n", seconds, busy);
+    for (int e = 0; e < kEndpointCount; ++e) {
+      printWindow(kEndpointNames[e], stats_.window[e], seconds);
+      stats_.total[e].add(stats_.window[e]);
+      stats_.window[e] = Window{};
+    }
+  }
+  std::fflush(stdout);
+}
+
+bool Simulator::run() {
+  if (!resolve()) return false;
+  epfd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd_ < 0) {
+    std::perror("epoll_create1");
+    return false;
+  }
+
+  uint64_t start = nowUs();
+  devices_.resize(static_cast<size_t>(opt_.devices));
+  std::uniform_int_distribution<size_t> frameStart(0, frames_.size() - 1);
+  for (size_t i = 0; i < devices_.size(); ++i) {
+    Device& d = devices_[i];
+    char id[64];
+    std::snprintf(id, sizeof(id), "%s%04zu", opt_.idPrefix.c_str(), i);
+    d.id = id;
+    d.frameIndex = frameStart(rng_);
+    d.registerAtUs = start + static_cast<uint64_t>(opt_.rampSec * 1e6 * i / devices_.size());
+    wakeAt(static_cast<uint32_t>(i), d.registerAtUs);
+  }
+
+  uint64_t end = start + static_cast<uint64_t>((opt_.rampSec + opt_.durationSec) * 1e6);
+  uint64_t reportEvery = static_cast<uint64_t>(opt_.reportSec * 1e6);
+  uint64_t lastReport = start;
+  epoll_event events[kMaxEvents];
+
+  for (;;) {
+    uint64_t now = nowUs();
+    if (!stopping_ && now >= end) stopping_ = true;
+    if (stopping_) {
+      // At the end, in-flight requests are awaited (for at most the request timeout)
+      bool idle = std::all_of(devices_.begin(), devices_.end(), [](const Device& d) { return d.phase == Phase::Idle; });
+      if (idle || now >= end + kRequestTimeoutUs) break;
+    }
+    if (reportEvery && now - lastReport >= reportEvery) {
+      report((now - lastReport) / 1e6, false);
+      lastReport = now;
+    }
+
+    while (!timers_.empty() && timers_.top().first <= now) {
+      Timer t = timers_.top();
+      timers_.pop();
+      Device& d = devices_[t.second];
+      if (d.wakeUs != t.first) continue;  // superseded by an earlier wakeup
+      d.wakeUs = 0;
+      service(t.second, now);
+    }
+
+    uint64_t wake = stopping_ ? now + 100000 : end;
+    if (!timers_.empty()) wake = std::min(wake, timers_.top().first);
+    if (reportEvery) wake = std::min(wake, lastReport + reportEvery);
+    int timeoutMs = wake > now ? static_cast<int>(std::min<uint64_t>((wake - now + 999) / 1000, 1000)) : 0;
+
+    int n = epoll_wait(epfd_, events, kMaxEvents, timeoutMs);
+    if (n < 0 && errno != EINTR) {
+      std::perror("epoll_wait");
+      return false;
+    }
+    for (int i = 0; i < n; ++i) {
+      uint32_t idx = events[i].data.u32;
+      Device& d = devices_[idx];
+      if (d.fd < 0) continue;
+      uint32_t ev = events[i].events;
+      if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        if (d.phase == Phase::Connecting || d.phase == Phase::Sending) {
+          if (ev & (EPOLLHUP | EPOLLERR)) {
+            fail(idx, d.phase == Phase::Sending);
+            continue;
+          }
+        } else {
+          onReadable(idx);
+          continue;
+        }
+      }
+      if (ev & EPOLLOUT) onWritable(idx);
+    }
+  }
+
+  report((nowUs() - start) / 1e6, true);
+  for (auto& d : devices_) closeConnection(d);
+  close(epfd_);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    usage(argv[0]);
+    return 2;
+  }
+  std::vector<std::string> frames = loadFrames(opt.jpegDir);
+  if (frames.empty()) {
+    std::fprintf(stderr, "no .jpg frames under %s\n", opt.jpegDir.c_str());
+    return 2;
+  }
+
+  // One socket per device; the default limit of 1024 files is too low for thousands of devices
+  rlimit lim{};
+  if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+  }
+  if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < static_cast<rlim_t>(opt.devices) + 16) {
+    std::fprintf(stderr, "warning: open file limit %llu < devices; raise ulimit -n\n",
+                 static_cast<unsigned long long>(lim.rlim_cur));
+  }
+
+  std::printf("fleetsim: %d devices -> %s:%s, %zu frames, ramp %.0fs, duration %.0fs\n", opt.devices,
+              opt.host.c_str(), opt.port.c_str(), frames.size(), opt.rampSec, opt.durationSec);
+  Simulator sim(std::move(opt), std::move(frames));
+  return sim.run() ? 0 : 1;
+}